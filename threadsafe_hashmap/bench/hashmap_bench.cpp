@@ -0,0 +1,292 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../include/threadsafe_hashmap.h"
+#include "workload.h"
+
+namespace bench {
+
+struct Options {
+  uint64_t num_keys = 1 << 16; ///< key space of a case, the prefilled tables hold all of it
+  uint64_t num_operations = 400000; ///< operations of a case, split between the threads
+  std::vector<uint32_t> thread_counts; ///< 1, 2, 4 ... hardware_concurrency by default
+  bool json = false;
+  std::string filter; ///< runs only the cases which name contains it
+};
+
+const Mix kMixes[] = {
+    {"read100", 100, 0},
+    {"read90", 90, 5},
+    {"read50", 50, 25},
+    {"read10", 10, 45},
+};
+
+const Distribution kDistributions[] = {Distribution::kUniform, Distribution::kZipfian, Distribution::kSequential};
+
+/// @brief the operations of every kLatencySampleStep are timed one by one, the clock reads would skew the rest
+constexpr uint64_t kLatencySampleStep = 8;
+
+struct Case {
+  std::string map;
+  const char *key;
+  const char *value;
+  Distribution distribution;
+  Mix mix;
+  bool is_prefilled;
+  uint32_t num_threads;
+
+  std::string Name() const {
+    return map + "/" + key + "/" + value + "/" + NameOf(distribution) + "/" + mix.name + "/"
+        + (is_prefilled? "prefilled" : "growing") + "/" + std::to_string(num_threads);
+  }
+};
+
+struct Result {
+  uint64_t num_operations = 0;
+  double operations_per_second = 0;
+  uint64_t final_size = 0;
+  uint64_t p50_ns = 0;
+  uint64_t p90_ns = 0;
+  uint64_t p99_ns = 0;
+  uint64_t p999_ns = 0;
+  uint64_t max_ns = 0;
+};
+
+void PrintHeader(const Options &options) {
+  if (!options.json)
+    std::cout << "map,key,value,distribution,mix,table,threads,operations,ops_per_sec,final_size,"
+              << "p50_ns,p90_ns,p99_ns,p999_ns,max_ns" << std::endl;
+}
+
+void Print(const Options &options, const Case &test_case, const Result &result) {
+  const char *kTable = test_case.is_prefilled? "prefilled" : "growing";
+  if (options.json) {
+    std::cout << "{\"map\": \"" << test_case.map << "\", \"key\": \"" << test_case.key
+              << "\", \"value\": \"" << test_case.value << "\", \"distribution\": \""
+              << NameOf(test_case.distribution) << "\", \"mix\": \"" << test_case.mix.name
+              << "\", \"table\": \"" << kTable << "\", \"threads\": " << test_case.num_threads
+              << ", \"operations\": " << result.num_operations
+              << ", \"ops_per_sec\": " << static_cast<uint64_t>(result.operations_per_second)
+              << ", \"final_size\": " << result.final_size << ", \"p50_ns\": " << result.p50_ns
+              << ", \"p90_ns\": " << result.p90_ns << ", \"p99_ns\": " << result.p99_ns
+              << ", \"p999_ns\": " << result.p999_ns << ", \"max_ns\": " << result.max_ns << "}" << std::endl;
+    return;
+  }
+  std::cout << test_case.map << "," << test_case.key << "," << test_case.value << ","
+            << NameOf(test_case.distribution) << "," << test_case.mix.name << "," << kTable << ","
+            << test_case.num_threads << "," << result.num_operations << ","
+            << static_cast<uint64_t>(result.operations_per_second) << "," << result.final_size << ","
+            << result.p50_ns << "," << result.p90_ns << "," << result.p99_ns << "," << result.p999_ns << ","
+            << result.max_ns << std::endl;
+}
+
+/// @return value of the sorted samples at the quantile
+uint64_t Percentile(const std::vector<uint64_t> &sorted, double quantile) {
+  if (sorted.empty())
+    return 0;
+  return sorted[static_cast<uint64_t>(quantile * (sorted.size() - 1))];
+}
+
+/// @brief runs one case on a new map: the threads start together and do num_operations / num_threads each
+template <typename Map, typename KeyType, typename ValueType>
+Result RunCase(const Options &options, const Case &test_case, const std::vector<KeyType> &keys,
+               const ZipfianGenerator &zipfian) {
+  Map map(16);
+  if (test_case.is_prefilled) {
+    ValueType value{};
+    for (uint64_t i = 0; i < keys.size(); i++) {
+      TypeTraits<ValueType>::Stamp(value, i);
+      map.Insert(keys[i], value);
+    }
+  }
+
+  const uint32_t kNumThreads = test_case.num_threads;
+  const uint64_t kOperationsPerThread = options.num_operations / kNumThreads;
+  std::vector<std::vector<uint64_t>> samples(kNumThreads);
+  std::atomic<uint32_t> num_ready(0);
+  std::atomic<bool> is_started(false);
+  std::atomic<uint64_t> num_found(0); // keeps the lookups from being optimized out
+
+  auto worker = [&](uint32_t thread_id) {
+    KeyPicker picker(test_case.distribution, keys.size(), zipfian, thread_id, kNumThreads);
+    const Mix kMix = test_case.mix;
+    ValueType value{};
+    std::vector<uint64_t> &latencies = samples[thread_id];
+    latencies.reserve(kOperationsPerThread / kLatencySampleStep + 1);
+    uint64_t found = 0;
+    auto operation = [&](uint64_t i) {
+      const KeyType &key = keys[picker.Next()];
+      const uint32_t kPercent = picker.NextPercent();
+      if (kPercent < kMix.read_percent) {
+        found += map.Lookup(key).first? 1 : 0;
+      } else if (kPercent < kMix.read_percent + kMix.insert_percent) {
+        TypeTraits<ValueType>::Stamp(value, i);
+        map.Insert(key, value);
+      } else {
+        found += map.Remove(key)? 1 : 0;
+      }
+    };
+
+    num_ready++;
+    while (!is_started.load())
+      std::this_thread::yield();
+    for (uint64_t i = 0; i < kOperationsPerThread; i++) {
+      if (i % kLatencySampleStep != 0) {
+        operation(i);
+        continue;
+      }
+      const auto kStart = std::chrono::steady_clock::now();
+      operation(i);
+      latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - kStart).count());
+    }
+    num_found += found;
+  };
+
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0; i < kNumThreads; i++)
+    threads.emplace_back(worker, i);
+  while (num_ready.load() < kNumThreads)
+    std::this_thread::yield();
+  const auto kStart = std::chrono::steady_clock::now();
+  is_started = true;
+  for (auto &thread : threads)
+    thread.join();
+  const auto kStop = std::chrono::steady_clock::now();
+
+  std::vector<uint64_t> latencies;
+  for (auto &thread_samples : samples)
+    latencies.insert(latencies.end(), thread_samples.begin(), thread_samples.end());
+  std::sort(latencies.begin(), latencies.end());
+
+  Result result;
+  result.num_operations = kOperationsPerThread * kNumThreads;
+  result.operations_per_second = result.num_operations / std::chrono::duration<double>(kStop - kStart).count();
+  result.final_size = map.Size();
+  result.p50_ns = Percentile(latencies, 0.5);
+  result.p90_ns = Percentile(latencies, 0.9);
+  result.p99_ns = Percentile(latencies, 0.99);
+  result.p999_ns = Percentile(latencies, 0.999);
+  result.max_ns = latencies.empty()? 0 : latencies.back();
+  return result;
+}
+
+/// @brief sweeps the distributions, mixes, tables and thread counts for one map type
+template <typename Map, typename KeyType, typename ValueType>
+void RunMap(const Options &options, const std::string &map_name, const std::vector<KeyType> &keys,
+            const ZipfianGenerator &zipfian) {
+  for (Distribution distribution : kDistributions) {
+    for (const Mix &mix : kMixes) {
+      for (bool is_prefilled : {true, false}) {
+        if (!is_prefilled && 0 == mix.insert_percent)
+          continue; // nothing would grow the table
+        for (uint32_t num_threads : options.thread_counts) {
+          const Case kCase{map_name, TypeTraits<KeyType>::Name(), TypeTraits<ValueType>::Name(), distribution, mix,
+                           is_prefilled, num_threads};
+          if (!options.filter.empty() && std::string::npos == kCase.Name().find(options.filter))
+            continue;
+          Print(options, kCase, RunCase<Map, KeyType, ValueType>(options, kCase, keys, zipfian));
+        }
+      }
+    }
+  }
+}
+
+/// @brief the maps of the sweep for one pair of the key and value types
+template <typename KeyType, typename ValueType>
+void RunTypes(const Options &options) {
+  std::vector<KeyType> keys;
+  keys.reserve(options.num_keys);
+  for (uint64_t i = 0; i < options.num_keys; i++)
+    keys.push_back(TypeTraits<KeyType>::Make(i));
+  const ZipfianGenerator kZipfian(options.num_keys);
+
+  typedef std::hash<KeyType> Hasher;
+  typedef std::equal_to<KeyType> KeyEqual;
+  using my_concurrency::internals::FlatBucket;
+  using my_concurrency::internals::OptimisticReadBucket;
+  typedef my_concurrency::ThreadsafeHashmap<KeyType, ValueType> ChainedMap;
+  typedef my_concurrency::ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, FlatBucket> FlatMap;
+  typedef my_concurrency::ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, OptimisticReadBucket> OptimisticMap;
+  RunMap<ChainedMap, KeyType, ValueType>(options, "chained", keys, kZipfian);
+  RunMap<FlatMap, KeyType, ValueType>(options, "flat", keys, kZipfian);
+  RunMap<OptimisticMap, KeyType, ValueType>(options, "optimistic", keys, kZipfian);
+  RunMap<LockedUnorderedMap<KeyType, ValueType>, KeyType, ValueType>(options, "unordered_map_shared_mutex", keys,
+                                                                     kZipfian);
+}
+
+void PrintUsage() {
+  std::cerr << "usage: hashmap_bench [--keys=N] [--ops=N] [--threads=N,N,...] [--json] [--filter=TEXT]\n"
+            << "  --keys     key space of a case, default 65536\n"
+            << "  --ops      operations of a case split between the threads, default 400000\n"
+            << "  --threads  thread counts, default 1, 2, 4 ... hardware concurrency\n"
+            << "  --json     one JSON object per line instead of CSV\n"
+            << "  --filter   runs the cases which name map/key/value/distribution/mix/table/threads contains TEXT\n";
+}
+
+/// @return false if the arguments are not valid
+bool ParseOptions(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; i++) {
+    const std::string kArgument = argv[i];
+    const std::string::size_type kEqual = kArgument.find('=');
+    const std::string kName = kArgument.substr(0, kEqual);
+    const std::string kValue = kEqual == std::string::npos? "" : kArgument.substr(kEqual + 1);
+    try {
+      if (kName == "--keys") {
+        options.num_keys = std::stoull(kValue);
+      } else if (kName == "--ops") {
+        options.num_operations = std::stoull(kValue);
+      } else if (kName == "--threads") {
+        for (std::string::size_type begin = 0; begin <= kValue.size();) {
+          std::string::size_type end = kValue.find(',', begin);
+          end = end == std::string::npos? kValue.size() : end;
+          options.thread_counts.push_back(static_cast<uint32_t>(std::stoul(kValue.substr(begin, end - begin))));
+          begin = end + 1;
+        }
+      } else if (kName == "--json") {
+        options.json = true;
+      } else if (kName == "--filter") {
+        options.filter = kValue;
+      } else {
+        return false;
+      }
+    } catch (const std::exception &) {
+      return false;
+    }
+  }
+  if (options.thread_counts.empty()) {
+    const uint32_t kMaxThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (uint32_t num_threads = 1; num_threads < kMaxThreads; num_threads *= 2)
+      options.thread_counts.push_back(num_threads);
+    options.thread_counts.push_back(kMaxThreads);
+  }
+  for (uint32_t num_threads : options.thread_counts) {
+    if (0 == num_threads || options.num_operations < num_threads)
+      return false;
+  }
+  return options.num_keys > 1 && options.num_keys < (1ull << 31); // the Zipfian permutation needs fewer keys
+}
+
+} // namespace bench
+
+/// @brief Throughput and latency of the maps over a sweep of thread counts, operation mixes, key distributions,
+///        key and value types and of prefilled and growing tables. Prints one CSV row (or JSON object) per case,
+///        so the runs can be compared by a script. std::unordered_map behind std::shared_mutex is the baseline
+int main(int argc, char **argv) {
+  bench::Options options;
+  if (!bench::ParseOptions(argc, argv, options)) {
+    bench::PrintUsage();
+    return 1;
+  }
+  bench::PrintHeader(options);
+  bench::RunTypes<uint64_t, uint64_t>(options);
+  bench::RunTypes<std::string, uint64_t>(options);
+  bench::RunTypes<uint64_t, bench::KilobyteValue>(options);
+  return 0;
+}
@@ -0,0 +1,197 @@
+#ifndef THREADSAFE_HASHMAP_BENCH_WORKLOAD_H
+#define THREADSAFE_HASHMAP_BENCH_WORKLOAD_H
+
+#include <array>
+#include <cstring> // memcpy
+#include <inttypes.h>
+#include <math.h> // pow
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility> // pair
+#include <vector>
+
+namespace bench {
+
+/// @brief splitmix64 step: the next random number of the sequence
+inline uint64_t Scramble(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ull;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+/// @brief random numbers of one thread, cheaper than the std engines in the measured loop
+class Random {
+ public:
+  explicit Random(uint64_t seed) : state_(seed) { }
+  uint64_t Next() { return Scramble(state_++); }
+  /// @return uniform value of [0, 1)
+  double NextDouble() { return (Next() >> 11) * (1.0 / (1ull << 53)); }
+ private:
+  uint64_t state_;
+};
+
+enum class Distribution {
+  kUniform,
+  kZipfian, ///< YCSB skew (theta 0.99): a few hot keys, spread over the table
+  kSequential ///< every thread walks its own part of the key space in order
+};
+
+inline const char *NameOf(Distribution distribution) {
+  switch (distribution) {
+    case Distribution::kUniform: return "uniform";
+    case Distribution::kZipfian: return "zipfian";
+    case Distribution::kSequential: return "sequential";
+  }
+  return "";
+}
+
+/// @brief shares of the operations, the removals take the rest
+struct Mix {
+  const char *name;
+  uint32_t read_percent;
+  uint32_t insert_percent;
+};
+
+/// @brief Zipfian ranks of [0, num_items) by Gray et al. "Quickly generating billion-record synthetic databases",
+///        as in YCSB. The constants are computed once and shared by the threads
+class ZipfianGenerator {
+ public:
+  explicit ZipfianGenerator(uint64_t num_items, double theta = 0.99)
+      : num_items_(num_items), theta_(theta), alpha_(1.0 / (1.0 - theta)), zeta_n_(Zeta(num_items, theta)) {
+    eta_ = (1.0 - pow(2.0 / num_items, 1.0 - theta)) / (1.0 - Zeta(2, theta) / zeta_n_);
+  }
+
+  /// @return rank, zero is the most frequent one
+  uint64_t Next(Random &random) const {
+    const double kUniform = random.NextDouble();
+    const double kScaled = kUniform * zeta_n_;
+    if (kScaled < 1.0)
+      return 0;
+    if (kScaled < 1.0 + pow(0.5, theta_))
+      return 1;
+    const uint64_t kRank = static_cast<uint64_t>(num_items_ * pow(eta_ * kUniform - eta_ + 1.0, alpha_));
+    return kRank < num_items_? kRank : num_items_ - 1;
+  }
+
+ private:
+  static double Zeta(uint64_t n, double theta) {
+    double sum = 0;
+    for (uint64_t i = 1; i <= n; i++)
+      sum += 1.0 / pow(double(i), theta);
+    return sum;
+  }
+
+  uint64_t num_items_;
+  double theta_;
+  double alpha_;
+  double zeta_n_;
+  double eta_ = 0;
+};
+
+/// @brief indexes of the keys one thread operates on
+class KeyPicker {
+ public:
+  /// @param thread_id gives the seed and the start of the sequential walk
+  KeyPicker(Distribution distribution, uint64_t num_keys, const ZipfianGenerator &zipfian, uint32_t thread_id,
+            uint32_t num_threads)
+      : distribution_(distribution), num_keys_(num_keys), zipfian_(zipfian), random_(thread_id * 1000003ull + 1),
+        next_(num_keys * thread_id / num_threads) { }
+
+  /// @return index of [0, num_keys). The Zipfian ranks are permuted, so the hot keys are not neighbours
+  uint64_t Next() {
+    switch (distribution_) {
+      case Distribution::kUniform: return random_.Next() % num_keys_;
+      case Distribution::kZipfian: return zipfian_.Next(random_) * kScatter % num_keys_;
+      case Distribution::kSequential: break;
+    }
+    const uint64_t kIndex = next_;
+    next_ = next_ + 1 == num_keys_? 0 : next_ + 1;
+    return kIndex;
+  }
+
+  /// @return value of [0, 100) which picks the operation
+  uint32_t NextPercent() { return static_cast<uint32_t>(random_.Next() % 100); }
+
+ private:
+  /// prime, so the multiplication permutes the ranks of any smaller key space without overflow below 2^31 keys
+  constexpr static uint64_t kScatter = 2654435761ull;
+
+  Distribution distribution_;
+  uint64_t num_keys_;
+  const ZipfianGenerator &zipfian_;
+  Random random_;
+  uint64_t next_;
+};
+
+/// @brief large value: the copies of Insert and Lookup dominate the cost of an operation
+struct KilobyteValue {
+  std::array<char, 1024> bytes{};
+};
+
+/// @brief names and generators of the key and value types of the sweep
+template <typename T>
+struct TypeTraits;
+
+template <>
+struct TypeTraits<uint64_t> {
+  static const char *Name() { return "u64"; }
+  /// dense identifiers, as the sequential ones of a database
+  static uint64_t Make(uint64_t index) { return index; }
+  static void Stamp(uint64_t &value, uint64_t tag) { value = tag; }
+};
+
+/// @brief 14 characters, kept inline by the small string optimization
+template <>
+struct TypeTraits<std::string> {
+  static const char *Name() { return "string14"; }
+  static std::string Make(uint64_t index) {
+    std::string digits = std::to_string(index % 10000000000ull);
+    return "user" + std::string(10 - digits.size(), '0') + digits;
+  }
+};
+
+template <>
+struct TypeTraits<KilobyteValue> {
+  static const char *Name() { return "1KB"; }
+  static void Stamp(KilobyteValue &value, uint64_t tag) { std::memcpy(value.bytes.data(), &tag, sizeof(tag)); }
+};
+
+/// @brief Baseline: std::unordered_map behind one std::shared_mutex with the interface of ThreadsafeHashmap.
+///        Lookup copies the value out as ThreadsafeHashmap does
+template <typename KeyType, typename ValueType>
+class LockedUnorderedMap {
+ public:
+  explicit LockedUnorderedMap(uint64_t num_buckets) : map_(num_buckets) { }
+
+  void Insert(const KeyType &key, const ValueType &value) {
+    std::lock_guard<std::shared_mutex> lock(mutex_);
+    map_[key] = value;
+  }
+
+  std::pair<bool, ValueType> Lookup(const KeyType &key) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = map_.find(key);
+    return it == map_.end()? std::make_pair(false, ValueType()) : std::make_pair(true, it->second);
+  }
+
+  bool Remove(const KeyType &key) {
+    std::lock_guard<std::shared_mutex> lock(mutex_);
+    return map_.erase(key) > 0;
+  }
+
+  uint64_t Size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return map_.size();
+  }
+
+ private:
+  mutable std::shared_mutex mutex_;
+  std::unordered_map<KeyType, ValueType> map_;
+};
+
+} // namespace bench
+
+#endif //THREADSAFE_HASHMAP_BENCH_WORKLOAD_H
@@ -0,0 +1,305 @@
+#ifndef THREADSAFE_HASHMAP_CONCURRENT_CACHE_H
+#define THREADSAFE_HASHMAP_CONCURRENT_CACHE_H
+
+#include <algorithm> // max, min
+#include <atomic>
+#include <functional> // hash, equal_to
+#include <inttypes.h>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <type_traits> // is_same
+#include <utility> // pair
+#include <vector>
+
+#include "threadsafe_hashmap.h"
+#include "../src/sharded_counter.h"
+
+namespace my_concurrency {
+
+/// @brief weight of every element is one, so the capacity of the cache is a number of elements
+struct UnitWeigher {
+  template <typename KeyType, typename ValueType>
+  uint64_t operator()(const KeyType &, const ValueType &) const {
+    return 1;
+  }
+};
+
+/// @brief Bounded cache on top of ThreadsafeHashmap with CLOCK eviction. The keys are split between num_shards
+///        shards, each with its own CLOCK ring and the capacity / num_shards part of the capacity: the remainder
+///        goes to the first shards one unit each, and there are no more shards than units of the capacity.
+///        A hit only visits the map and sets the reference bit of the element. The map reads its tables under an
+///        epoch rather than the table state lock, so a hit takes no lock but the one of the bucket.
+///        Insert and Remove lock the shard of the key, the eviction runs under the same lock
+/// @tparam Weigher weigher(key, value) gives the weight of an element, e.g. its bytes. Zero is counted as one
+/// @tparam BucketType storage of the map, see ThreadsafeHashmap
+template <typename KeyType, typename ValueType, typename Weigher = UnitWeigher, typename Hasher = std::hash<KeyType>,
+          typename KeyEqual = std::equal_to<KeyType>, template <typename...> class BucketType = internals::Bucket>
+class ConcurrentCache {
+ public:
+  /// @param capacity upper bound of the total weight of the elements
+  /// @param num_shards number of independent CLOCK rings, their locks are taken on misses only. Capped by capacity
+  explicit ConcurrentCache(uint64_t capacity, const Weigher &weigher = Weigher(),
+                           uint32_t num_shards = kDefaultShards, const Hasher &hasher = Hasher(),
+                           const KeyEqual &key_equal = KeyEqual());
+  ConcurrentCache(const ConcurrentCache &) = delete;
+  ConcurrentCache &operator=(const ConcurrentCache &) = delete;
+
+  /// @return a pair with first element shows if the key was found and second element is the cached value.
+  ///         A hit marks the element as recently used
+  std::pair<bool, ValueType> Lookup(const KeyType &key);
+
+  /// @brief adds or replaces the element, then evicts the elements of the shard until its weight fits
+  /// @return false if the element alone is heavier than the capacity of a shard, it is not cached then
+  bool Insert(const KeyType &key, const ValueType &value);
+
+  /// @return true if the element was cached
+  bool Remove(const KeyType &key);
+
+  /// @brief approximate number of the cached elements, see ThreadsafeHashmap::Size
+  uint64_t Size() const;
+  /// @brief total weight of the cached elements
+  uint64_t Weight() const;
+  uint64_t Capacity() const;
+
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t rejections = 0; ///< elements heavier than the capacity of a shard
+  };
+  /// @brief counters since the creation of the cache, each of them is approximate under concurrent updates
+  Stats GetStats() const;
+
+  static constexpr uint32_t kDefaultShards = 16;
+
+ private:
+  /// @brief value stored in the map: the slot of the element in the ring of its shard and the reference bit
+  struct Entry {
+    Entry() = default;
+    Entry(const ValueType &value, uint64_t slot, bool referenced) : value(value), slot(slot), referenced(referenced) { }
+    Entry(const Entry &rhs) : value(rhs.value), slot(rhs.slot), referenced(rhs.referenced.load()) { }
+    Entry &operator=(const Entry &rhs);
+
+    ValueType value;
+    uint64_t slot = 0;
+    mutable std::atomic<bool> referenced{false}; ///< set by the hits, cleared by the clock hand
+  };
+
+  struct Slot {
+    KeyType key;
+    uint64_t weight = 0;
+    bool is_live = false;
+  };
+
+  /// @brief CLOCK ring of a shard. The slots keep their indices, the freed ones are reused
+  struct alignas(64) Shard {
+    std::mutex mutex;
+    std::vector<Slot> ring;
+    std::vector<uint64_t> free_slots;
+    uint64_t hand = 0;
+    uint64_t capacity = 0; ///< set once by the constructor
+    std::atomic<uint64_t> weight{0}; ///< written under the mutex
+  };
+
+  typedef ThreadsafeHashmap<KeyType, Entry, Hasher, KeyEqual, BucketType> Map;
+
+  /// @return num_shards capped by the capacity, at least one
+  static uint32_t ShardsFor(uint64_t capacity, uint32_t num_shards);
+
+  Shard &ShardOf(const KeyType &key);
+
+  /// @brief moves the hand of the shard until its weight fits: a referenced element gets its bit cleared and
+  ///        stays, the others are evicted. Requires the lock of the shard
+  /// @param kept slot of the element being inserted, the hand passes it by
+  void Evict(Shard &shard, uint64_t kept);
+
+  Map map_;
+  Weigher weigher_;
+  Hasher hasher_;
+  const uint64_t capacity_;
+  const uint32_t num_shards_;
+  std::unique_ptr<Shard[]> shards_;
+  internals::ShardedCounter hits_;
+  internals::ShardedCounter misses_;
+  internals::ShardedCounter evictions_;
+  internals::ShardedCounter rejections_;
+};
+
+template <typename KeyType, typename ValueType, typename Weigher, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType>
+typename ConcurrentCache<KeyType, ValueType, Weigher, Hasher, KeyEqual, BucketType>::Entry &
+ConcurrentCache<KeyType, ValueType, Weigher, Hasher, KeyEqual, BucketType>::Entry::operator=(const Entry &rhs) {
+  value = rhs.value;
+  slot = rhs.slot;
+  referenced = rhs.referenced.load();
+  return *this;
+}
+
+template <typename KeyType, typename ValueType, typename Weigher, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType>
+ConcurrentCache<KeyType, ValueType, Weigher, Hasher, KeyEqual, BucketType>::ConcurrentCache(
+    uint64_t capacity, const Weigher &weigher, uint32_t num_shards, const Hasher &hasher, const KeyEqual &key_equal)
+    : map_(64, hasher, key_equal),
+      weigher_(weigher),
+      hasher_(hasher),
+      capacity_(capacity),
+      num_shards_(ShardsFor(capacity, num_shards)),
+      shards_(new Shard[num_shards_]) {
+  for (uint32_t i = 0; i < num_shards_; i++)
+    shards_[i].capacity = capacity / num_shards_ + (i < capacity % num_shards_? 1 : 0);
+  // the number of elements is known up front, so the map never resizes
+  if (std::is_same<Weigher, UnitWeigher>::value)
+    map_.Reserve(capacity);
+}
+
+template <typename KeyType, typename ValueType, typename Weigher, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType>
+uint32_t ConcurrentCache<KeyType, ValueType, Weigher, Hasher, KeyEqual, BucketType>::ShardsFor(
+    uint64_t capacity, uint32_t num_shards) {
+  // a shard without capacity would reject all of its keys
+  return static_cast<uint32_t>(std::max<uint64_t>(1, std::min<uint64_t>(capacity, num_shards)));
+}
+
+template <typename KeyType, typename ValueType, typename Weigher, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType>
+typename ConcurrentCache<KeyType, ValueType, Weigher, Hasher, KeyEqual, BucketType>::Shard &
+ConcurrentCache<KeyType, ValueType, Weigher, Hasher, KeyEqual, BucketType>::ShardOf(const KeyType &key) {
+  // the map takes the low bits of the hash for its buckets, the mixed hash spreads the shards independently
+  return shards_[PowerOfTwoIndexing::Mix(hasher_(key)) % num_shards_];
+}
+
+template <typename KeyType, typename ValueType, typename Weigher, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType>
+std::pair<bool, ValueType> ConcurrentCache<KeyType, ValueType, Weigher, Hasher, KeyEqual, BucketType>::Lookup(
+    const KeyType &key) {
+  std::pair<bool, ValueType> result(false, ValueType());
+  map_.Visit(key, [&result](const Entry &entry) {
+    result.first = true;
+    result.second = entry.value;
+    // the hot elements are referenced already, so their cache lines are not written again
+    if (!entry.referenced.load(std::memory_order_relaxed))
+      entry.referenced.store(true, std::memory_order_relaxed);
+  });
+  (result.first? hits_ : misses_).Add(1);
+  return result;
+}
+
+template <typename KeyType, typename ValueType, typename Weigher, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType>
+bool ConcurrentCache<KeyType, ValueType, Weigher, Hasher, KeyEqual, BucketType>::Insert(
+    const KeyType &key, const ValueType &value) {
+  const uint64_t kWeight = std::max<uint64_t>(1, weigher_(key, value));
+  Shard &shard = ShardOf(key);
+  if (kWeight > shard.capacity) {
+    rejections_.Add(1);
+    Remove(key); // the old value must not outlive the new one
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  const uint64_t kNoSlot = std::numeric_limits<uint64_t>::max();
+  uint64_t slot = kNoSlot;
+  map_.Visit(key, [&slot](const Entry &entry) { slot = entry.slot; });
+  if (slot != kNoSlot) {
+    // an update counts as a use
+    map_.Insert(key, Entry(value, slot, true));
+    shard.weight.store(shard.weight.load(std::memory_order_relaxed) - shard.ring[slot].weight + kWeight,
+                       std::memory_order_relaxed);
+    shard.ring[slot].weight = kWeight;
+  } else {
+    if (shard.free_slots.empty()) {
+      slot = shard.ring.size();
+      shard.ring.emplace_back();
+    } else {
+      slot = shard.free_slots.back();
+      shard.free_slots.pop_back();
+    }
+    shard.ring[slot].key = key;
+    shard.ring[slot].weight = kWeight;
+    shard.ring[slot].is_live = true;
+    map_.Insert(key, Entry(value, slot, false));
+    shard.weight.store(shard.weight.load(std::memory_order_relaxed) + kWeight, std::memory_order_relaxed);
+  }
+  Evict(shard, slot);
+  return true;
+}
+
+template <typename KeyType, typename ValueType, typename Weigher, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType>
+void ConcurrentCache<KeyType, ValueType, Weigher, Hasher, KeyEqual, BucketType>::Evict(Shard &shard, uint64_t kept) {
+  // the kept element fits alone, so the hand stops within two rounds: the first one clears the bits
+  while (shard.weight.load(std::memory_order_relaxed) > shard.capacity) {
+    if (shard.hand >= shard.ring.size())
+      shard.hand = 0;
+    Slot &slot = shard.ring[shard.hand];
+    if (slot.is_live && shard.hand != kept) {
+      bool referenced = false;
+      map_.Visit(slot.key, [&referenced](const Entry &entry) {
+        referenced = entry.referenced.exchange(false, std::memory_order_relaxed);
+      });
+      if (!referenced) {
+        map_.Remove(slot.key);
+        slot.is_live = false;
+        shard.weight.store(shard.weight.load(std::memory_order_relaxed) - slot.weight, std::memory_order_relaxed);
+        shard.free_slots.push_back(shard.hand);
+        evictions_.Add(1);
+      }
+    }
+    shard.hand++;
+  }
+}
+
+template <typename KeyType, typename ValueType, typename Weigher, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType>
+bool ConcurrentCache<KeyType, ValueType, Weigher, Hasher, KeyEqual, BucketType>::Remove(const KeyType &key) {
+  Shard &shard = ShardOf(key);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  const uint64_t kNoSlot = std::numeric_limits<uint64_t>::max();
+  uint64_t slot = kNoSlot;
+  map_.Visit(key, [&slot](const Entry &entry) { slot = entry.slot; });
+  if (slot == kNoSlot)
+    return false;
+  map_.Remove(key);
+  shard.ring[slot].is_live = false;
+  shard.weight.store(shard.weight.load(std::memory_order_relaxed) - shard.ring[slot].weight,
+                     std::memory_order_relaxed);
+  shard.free_slots.push_back(slot);
+  return true;
+}
+
+template <typename KeyType, typename ValueType, typename Weigher, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType>
+uint64_t ConcurrentCache<KeyType, ValueType, Weigher, Hasher, KeyEqual, BucketType>::Size() const {
+  return map_.Size();
+}
+
+template <typename KeyType, typename ValueType, typename Weigher, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType>
+uint64_t ConcurrentCache<KeyType, ValueType, Weigher, Hasher, KeyEqual, BucketType>::Weight() const {
+  uint64_t weight = 0;
+  for (uint32_t i = 0; i < num_shards_; i++)
+    weight += shards_[i].weight.load(std::memory_order_relaxed);
+  return weight;
+}
+
+template <typename KeyType, typename ValueType, typename Weigher, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType>
+uint64_t ConcurrentCache<KeyType, ValueType, Weigher, Hasher, KeyEqual, BucketType>::Capacity() const {
+  return capacity_;
+}
+
+template <typename KeyType, typename ValueType, typename Weigher, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType>
+typename ConcurrentCache<KeyType, ValueType, Weigher, Hasher, KeyEqual, BucketType>::Stats
+ConcurrentCache<KeyType, ValueType, Weigher, Hasher, KeyEqual, BucketType>::GetStats() const {
+  Stats stats;
+  stats.hits = hits_.Load();
+  stats.misses = misses_.Load();
+  stats.evictions = evictions_.Load();
+  stats.rejections = rejections_.Load();
+  return stats;
+}
+
+} // namespace my_concurrency
+
+#endif //THREADSAFE_HASHMAP_CONCURRENT_CACHE_H
@@ -0,0 +1,155 @@
+#ifndef THREADSAFE_HASHMAP_COUNTER_MAP_H
+#define THREADSAFE_HASHMAP_COUNTER_MAP_H
+
+#include <algorithm> // push_heap, pop_heap, sort_heap
+#include <atomic>
+#include <functional> // hash, equal_to
+#include <inttypes.h>
+#include <utility> // pair
+#include <vector>
+
+#include "threadsafe_hashmap.h"
+
+namespace my_concurrency {
+
+/// @brief ThreadsafeHashmap of uint64_t counters kept as atomics in the elements. Add of an existing key is
+///        a fetch_add under the shared lock of its bucket (through Visit), so the increments of one bucket run
+///        concurrently and none is lost; only the first Add of a key takes the bucket exclusively (through Upsert)
+/// @tparam BucketType must pass the stored value to Visit under the lock of the bucket (kLockedVisit):
+///         internals::Bucket, internals::CompactBucket or internals::FlatBucket. The counters are not trivially
+///         copyable, so internals::OptimisticReadBucket is the Bucket here. The lock-free readers of
+///         internals::LockFreeReadBucket race with the writers which replace the elements, it does not compile
+/// @tparam see ThreadsafeHashmap for the rest
+template <typename KeyType, typename Hasher = std::hash<KeyType>, typename KeyEqual = std::equal_to<KeyType>,
+          template <typename...> class BucketType = internals::Bucket,
+          typename NodeAllocator = internals::HeapNodeAllocator, typename IndexPolicy = ModuloIndexing>
+class CounterMap {
+ public:
+  explicit CounterMap(uint64_t num_buckets = 64, const Hasher &hasher = Hasher(),
+                      const KeyEqual &key_equal = KeyEqual(), const NodeAllocator &allocator = NodeAllocator());
+
+  /// @brief adds delta to the counter of the key, a missing counter starts from zero. Wraps around as uint64_t
+  /// @return value of the counter right after this addition
+  uint64_t Add(const KeyType &key, uint64_t delta = 1);
+
+  /// @return a pair with first element shows if the key was found and second element is its counter or zero
+  std::pair<bool, uint64_t> Lookup(const KeyType &key) const;
+
+  /// @return true if the counter was in the map
+  bool Remove(const KeyType &key);
+
+  /// @brief Exports the k heaviest counters and resets all of the counters to zero in one weakly consistent
+  ///        traversal (see ThreadsafeHashmap::ForEach). A counter is exchanged with zero, so an addition which
+  ///        races with the drain is either returned now or stays for the next drain. The keys stay in the map,
+  ///        the next period counts without allocations. A heap of k elements keeps the cost at O(n log k)
+  /// @return up to k pairs of a key and its drained value, the heaviest first. The zero counters are skipped
+  std::vector<std::pair<KeyType, uint64_t>> DrainTopK(uint64_t k);
+
+  /// @brief approximate number of the keys, see ThreadsafeHashmap::Size
+  uint64_t Size() const;
+  uint64_t BucketCount() const;
+
+ private:
+  /// @brief the counter is mutable: Visit gives a const element under the shared lock, fetch_add is safe there
+  struct Counter {
+    Counter() = default;
+    explicit Counter(uint64_t initial) : value(initial) { }
+    /// the elements are copied only by the resizing, which locks the bucket exclusively
+    Counter(const Counter &rhs) : value(rhs.value.load(std::memory_order_relaxed)) { }
+    Counter &operator=(const Counter &rhs) {
+      value.store(rhs.value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+      return *this;
+    }
+
+    mutable std::atomic<uint64_t> value{0};
+  };
+
+  typedef ThreadsafeHashmap<KeyType, Counter, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy> Map;
+  static_assert(BucketType<KeyType, Counter, NodeAllocator, KeyEqual>::kLockedVisit,
+                "the counters are incremented in Visit, so it must lock the bucket");
+
+  Map map_;
+};
+
+template <typename KeyType, typename Hasher, typename KeyEqual, template <typename...> class BucketType,
+          typename NodeAllocator, typename IndexPolicy>
+CounterMap<KeyType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::CounterMap(
+    uint64_t num_buckets, const Hasher &hasher, const KeyEqual &key_equal, const NodeAllocator &allocator)
+    : map_(num_buckets, hasher, key_equal, allocator) { }
+
+template <typename KeyType, typename Hasher, typename KeyEqual, template <typename...> class BucketType,
+          typename NodeAllocator, typename IndexPolicy>
+uint64_t CounterMap<KeyType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::Add(const KeyType &key,
+                                                                                           uint64_t delta) {
+  uint64_t result = 0;
+  auto add = [&result, delta](const Counter &counter) {
+    result = counter.value.fetch_add(delta, std::memory_order_relaxed) + delta;
+  };
+  if (map_.Visit(key, add))
+    return result;
+  // another thread may create the counter meanwhile, then the update adds to it
+  map_.Upsert(key, add, [&result, delta]() {
+    result = delta;
+    return Counter(delta);
+  });
+  return result;
+}
+
+template <typename KeyType, typename Hasher, typename KeyEqual, template <typename...> class BucketType,
+          typename NodeAllocator, typename IndexPolicy>
+std::pair<bool, uint64_t>
+CounterMap<KeyType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::Lookup(const KeyType &key) const {
+  std::pair<bool, uint64_t> result(false, 0);
+  result.first = map_.Visit(key, [&result](const Counter &counter) {
+    result.second = counter.value.load(std::memory_order_relaxed);
+  });
+  return result;
+}
+
+template <typename KeyType, typename Hasher, typename KeyEqual, template <typename...> class BucketType,
+          typename NodeAllocator, typename IndexPolicy>
+bool CounterMap<KeyType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::Remove(const KeyType &key) {
+  return map_.Remove(key);
+}
+
+template <typename KeyType, typename Hasher, typename KeyEqual, template <typename...> class BucketType,
+          typename NodeAllocator, typename IndexPolicy>
+std::vector<std::pair<KeyType, uint64_t>>
+CounterMap<KeyType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::DrainTopK(uint64_t k) {
+  typedef std::pair<KeyType, uint64_t> Entry;
+  auto heavier = [](const Entry &lhs, const Entry &rhs) { return lhs.second > rhs.second; };
+  // min-heap by the value: its top is the lightest of the k heaviest seen so far
+  std::vector<Entry> heap;
+  heap.reserve(k);
+  map_.ForEach([&heap, &heavier, k](const KeyType &key, const Counter &counter) {
+    const uint64_t kValue = counter.value.exchange(0, std::memory_order_relaxed);
+    if (kValue == 0 || k == 0)
+      return;
+    if (heap.size() < k) {
+      heap.emplace_back(key, kValue);
+      std::push_heap(heap.begin(), heap.end(), heavier);
+    } else if (kValue > heap.front().second) {
+      std::pop_heap(heap.begin(), heap.end(), heavier);
+      heap.back() = Entry(key, kValue);
+      std::push_heap(heap.begin(), heap.end(), heavier);
+    }
+  });
+  std::sort_heap(heap.begin(), heap.end(), heavier);
+  return heap;
+}
+
+template <typename KeyType, typename Hasher, typename KeyEqual, template <typename...> class BucketType,
+          typename NodeAllocator, typename IndexPolicy>
+uint64_t CounterMap<KeyType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::Size() const {
+  return map_.Size();
+}
+
+template <typename KeyType, typename Hasher, typename KeyEqual, template <typename...> class BucketType,
+          typename NodeAllocator, typename IndexPolicy>
+uint64_t CounterMap<KeyType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::BucketCount() const {
+  return map_.BucketCount();
+}
+
+} // namespace my_concurrency
+
+#endif //THREADSAFE_HASHMAP_COUNTER_MAP_H
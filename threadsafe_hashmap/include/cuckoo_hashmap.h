@@ -0,0 +1,491 @@
+#ifndef THREADSAFE_HASHMAP_CUCKOO_HASHMAP_H
+#define THREADSAFE_HASHMAP_CUCKOO_HASHMAP_H
+
+#include <algorithm> // max
+#include <atomic>
+#include <cstring> // memcpy
+#include <functional> // hash, equal_to
+#include <inttypes.h>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <type_traits>
+#include <utility> // pair
+#include <vector>
+
+#include "../src/epoch_reclamation.h"
+#include "../src/hash_policies.h"
+#include "../src/helpers.h"
+#include "../src/sharded_counter.h"
+#include "../src/spin_lock.h"
+
+namespace my_concurrency {
+
+namespace internals {
+
+constexpr uint64_t kCuckooCacheLineSize = 64;
+
+/// @return the most slots of a cuckoo bucket that fit one cache line together with its 4-byte version and
+///         1-byte tags, at least one
+constexpr uint32_t CuckooSlotsPerCacheLine(uint64_t slot_size, uint64_t slot_alignment) {
+  auto bucket_bytes = [slot_size, slot_alignment](uint64_t num_slots) {
+    return (sizeof(uint32_t) + num_slots + slot_alignment - 1) / slot_alignment * slot_alignment +
+           num_slots * slot_size;
+  };
+  uint32_t num_slots = 1;
+  while (bucket_bytes(num_slots + 1) <= kCuckooCacheLineSize)
+    num_slots++;
+  return num_slots;
+}
+
+} // namespace internals
+
+/// @brief Hashmap on bucketized cuckoo hashing: an element lives in one of its two candidate buckets of
+///        kSlotsPerBucket slots, so a lookup reads at most two buckets. A bucket takes as many slots as fit one
+///        cache line with its version and tags (3 for 16-byte elements, 6 for 8-byte ones), so for small elements
+///        a lookup reads at most two cache lines, whatever the load factor. Lookups take no lock: they copy both
+///        buckets and validate the copies against the bucket versions, like SeqLockBucket does. Writers lock the
+///        two buckets. When both are full, the writer takes the whole table and frees a slot by moving elements
+///        along a cuckoo path found by BFS, or doubles the table if there is no short path. A moved element is
+///        copied before it is erased, so lookups never miss it. Replaced tables are retired through EpochDomain.
+///        Fits read-mostly workloads: it has no incremental resizing, a doubling stops the writers until it ends
+/// @tparam KeyType, ValueType must be trivially copyable, the readers copy them while a writer may change them
+template <typename KeyType, typename ValueType, typename Hasher = std::hash<KeyType>,
+          typename KeyEqual = std::equal_to<KeyType>>
+class CuckooHashmap : private internals::PolicyHolder<Hasher, 0>, private internals::PolicyHolder<KeyEqual, 1> {
+  static_assert(std::is_trivially_copyable<KeyType>::value && std::is_trivially_copyable<ValueType>::value,
+                "optimistic readers copy the slots while a writer may change them");
+
+  struct Slot {
+    KeyType key;
+    ValueType value;
+  };
+
+ public:
+  /// @param num_buckets initial number of buckets, rounded up to a power of two
+  explicit CuckooHashmap(uint64_t num_buckets = 16, const Hasher &hasher = Hasher(),
+                         const KeyEqual &key_equal = KeyEqual());
+  ~CuckooHashmap();
+  CuckooHashmap(const CuckooHashmap &) = delete;
+  CuckooHashmap &operator=(const CuckooHashmap &) = delete;
+
+  /// @brief Adds new element or overwrites the value of the existing one
+  void Insert(const KeyType &key, const ValueType &value);
+
+  /// @return a pair with first element shows if the key was found and second element is associated value or
+  ///         default one. Optimistic, falls back to the bucket locks after kMaxOptimisticAttempts failed validations
+  std::pair<bool, ValueType> Lookup(const KeyType &key) const;
+
+  /// @return kOperationSuccess if the element was removed, kOperationFailed if there was no such key
+  bool Remove(const KeyType &key);
+
+  /// @brief removes all of the elements, the number of buckets stays
+  void Clear();
+
+  /// @brief approximate size, see ShardedCounter
+  uint64_t Size() const;
+  bool Empty() const;
+  uint64_t BucketCount() const;
+
+  constexpr static bool kOperationSuccess = true;
+  constexpr static bool kOperationFailed = false;
+  constexpr static uint32_t kSlotsPerBucket = internals::CuckooSlotsPerCacheLine(sizeof(Slot), alignof(Slot));
+  constexpr static uint32_t kMaxSearchedBuckets = 512; ///< bound of the cuckoo path search before the table grows
+  constexpr static uint32_t kMaxOptimisticAttempts = 16;
+
+ private:
+  typedef typename std::aligned_storage<sizeof(Slot), alignof(Slot)>::type SlotStorage;
+
+  /// @brief version is odd while a writer holds the bucket, a free slot has the zero tag
+  struct alignas(internals::kCuckooCacheLineSize) Bucket {
+    Bucket();
+    void Lock();
+    void Unlock();
+    /// @return index of a free slot or kSlotsPerBucket if the bucket is full
+    uint32_t FreeSlot() const;
+    Slot &At(uint32_t slot) { return *reinterpret_cast<Slot *>(&slots[slot]); }
+    const Slot &At(uint32_t slot) const { return *reinterpret_cast<const Slot *>(&slots[slot]); }
+
+    std::atomic<uint32_t> version;
+    std::atomic<uint8_t> tags[kSlotsPerBucket];
+    SlotStorage slots[kSlotsPerBucket];
+  };
+  static_assert(sizeof(Slot) + sizeof(uint32_t) + 1 > internals::kCuckooCacheLineSize ||
+                sizeof(Bucket) == internals::kCuckooCacheLineSize, "a bucket of small elements is one cache line");
+
+  struct Table {
+    explicit Table(uint64_t num_buckets) : mask(num_buckets - 1), buckets(num_buckets) { }
+    const uint64_t mask;
+    std::vector<Bucket> buckets;
+  };
+
+  /// @brief candidate buckets of a hash in a table
+  struct Position {
+    Position(uint64_t hash, uint64_t mask);
+    uint8_t tag;
+    uint64_t first;
+    uint64_t second;
+  };
+
+  /// @brief locks both candidate buckets in the order of their indices
+  class PositionLock {
+   public:
+    PositionLock(Table &table, const Position &position);
+    ~PositionLock();
+    PositionLock(const PositionLock &) = delete;
+    PositionLock &operator=(const PositionLock &) = delete;
+   private:
+    Bucket &lower_;
+    Bucket &upper_;
+  };
+
+  /// @brief step of the cuckoo path search: the element in slot of the parent bucket may move to bucket
+  struct PathNode {
+    uint64_t bucket;
+    int32_t parent;
+    uint32_t slot;
+  };
+
+  typedef internals::PolicyHolder<Hasher, 0> HasherHolder;
+  typedef internals::PolicyHolder<KeyEqual, 1> KeyEqualHolder;
+
+  uint64_t Hash(const KeyType &key) const { return PowerOfTwoIndexing::Mix(HasherHolder::Policy()(key)); }
+  bool KeysEqual(const KeyType &lhs, const KeyType &rhs) const { return KeyEqualHolder::Policy()(lhs, rhs); }
+  static uint64_t AlternativeIndex(uint64_t index, uint8_t tag, uint64_t mask);
+  static void Backoff(uint32_t attempt);
+
+  /// @brief copies the value of the key out of the candidate buckets without taking their locks
+  bool ReadValue(Table &table, const Position &position, const KeyType &key, ValueType &value) const;
+  /// @brief copies the slot with such key into copy, no matter if a writer changes the bucket meanwhile
+  bool CopySlot(const Bucket &bucket, uint8_t tag, const KeyType &key, SlotStorage &copy) const;
+  /// @return the slot with such key or nullptr. Requires the locks of the candidate buckets
+  Slot *FindLocked(Table &table, const Position &position, const KeyType &key);
+
+  /// @brief places the absent key into a free candidate slot
+  /// @return false if both candidate buckets are full. Requires the locks of the candidate buckets
+  bool PlaceLocked(Table &table, const Position &position, const KeyType &key, const ValueType &value);
+  /// @brief frees a slot in one of the candidate buckets by moving the elements along a cuckoo path
+  /// @return false if there is no path of kMaxSearchedBuckets. Requires the exclusive table lock
+  bool MakeRoom(Table &table, const Position &position);
+  /// @brief moves the elements from the free slot of leaf back to the root of its path
+  bool ShiftPath(Table &table, const std::vector<PathNode> &path, int32_t leaf, uint32_t free_slot);
+  /// @brief replaces the table with a table twice bigger, or bigger still if some element does not fit.
+  ///        Requires the exclusive table lock
+  void Grow(Table &table);
+
+  mutable internals::SharedSpinLock table_mutex_; ///< writers share it, displacements and growth take it exclusively
+  std::atomic<Table *> table_;
+  internals::ShardedCounter size_;
+};
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual>
+CuckooHashmap<KeyType, ValueType, Hasher, KeyEqual>::Bucket::Bucket() : version(0) {
+  for (auto &tag : tags)
+    tag.store(0, std::memory_order_relaxed);
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual>
+void CuckooHashmap<KeyType, ValueType, Hasher, KeyEqual>::Bucket::Lock() {
+  for (uint32_t attempt = 0; ; attempt++) {
+    uint32_t expected = version.load(std::memory_order_relaxed);
+    if (!(expected & 1) &&
+        version.compare_exchange_weak(expected, expected + 1, std::memory_order_acquire, std::memory_order_relaxed))
+      break;
+    Backoff(attempt);
+  }
+  // the odd version must be visible before any change of the slots
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual>
+void CuckooHashmap<KeyType, ValueType, Hasher, KeyEqual>::Bucket::Unlock() {
+  version.fetch_add(1, std::memory_order_release);
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual>
+uint32_t CuckooHashmap<KeyType, ValueType, Hasher, KeyEqual>::Bucket::FreeSlot() const {
+  uint32_t slot = 0;
+  while (slot < kSlotsPerBucket && tags[slot].load(std::memory_order_relaxed) != 0)
+    slot++;
+  return slot;
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual>
+CuckooHashmap<KeyType, ValueType, Hasher, KeyEqual>::Position::Position(uint64_t hash, uint64_t mask)
+    : tag(static_cast<uint8_t>(std::max<uint64_t>(1, hash >> 56))),
+      first(hash & mask),
+      second(AlternativeIndex(first, tag, mask)) { }
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual>
+CuckooHashmap<KeyType, ValueType, Hasher, KeyEqual>::PositionLock::PositionLock(Table &table,
+                                                                               const Position &position)
+    : lower_(table.buckets[std::min(position.first, position.second)]),
+      upper_(table.buckets[std::max(position.first, position.second)]) {
+  lower_.Lock();
+  if (&upper_ != &lower_)
+    upper_.Lock();
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual>
+CuckooHashmap<KeyType, ValueType, Hasher, KeyEqual>::PositionLock::~PositionLock() {
+  if (&upper_ != &lower_)
+    upper_.Unlock();
+  lower_.Unlock();
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual>
+CuckooHashmap<KeyType, ValueType, Hasher, KeyEqual>::CuckooHashmap(uint64_t num_buckets, const Hasher &hasher,
+                                                                   const KeyEqual &key_equal)
+    : HasherHolder(hasher), KeyEqualHolder(key_equal),
+      table_(new Table(PowerOfTwoIndexing::BucketCount(std::max<uint64_t>(2, num_buckets)))) { }
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual>
+CuckooHashmap<KeyType, ValueType, Hasher, KeyEqual>::~CuckooHashmap() {
+  delete table_.load(std::memory_order_relaxed);
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual>
+void CuckooHashmap<KeyType, ValueType, Hasher, KeyEqual>::Insert(const KeyType &key, const ValueType &value) {
+  const uint64_t kHash = Hash(key);
+  while (true) {
+    {
+      std::shared_lock<internals::SharedSpinLock> table_lock(table_mutex_);
+      Table &table = *table_.load(std::memory_order_relaxed);
+      const Position kPosition(kHash, table.mask);
+      PositionLock lock(table, kPosition);
+      if (Slot *slot = FindLocked(table, kPosition, key)) {
+        slot->value = value;
+        return;
+      }
+      if (PlaceLocked(table, kPosition, key, value)) {
+        size_.Add(1);
+        return;
+      }
+    }
+
+    // both buckets are full: nobody else may move the elements while the path is searched and shifted
+    std::lock_guard<internals::SharedSpinLock> table_lock(table_mutex_);
+    Table &table = *table_.load(std::memory_order_relaxed);
+    const Position kPosition(kHash, table.mask);
+    if (table.buckets[kPosition.first].FreeSlot() < kSlotsPerBucket ||
+        table.buckets[kPosition.second].FreeSlot() < kSlotsPerBucket)
+      continue;
+    if (!MakeRoom(table, kPosition))
+      Grow(table);
+  }
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual>
+std::pair<bool, ValueType> CuckooHashmap<KeyType, ValueType, Hasher, KeyEqual>::Lookup(const KeyType &key) const {
+  std::pair<bool, ValueType> result(false, ValueType());
+  internals::EpochGuard guard; // a replaced table lives until the lookups which have loaded it leave
+  Table &table = *table_.load(std::memory_order_acquire);
+  result.first = ReadValue(table, Position(Hash(key), table.mask), key, result.second);
+  return result;
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual>
+bool CuckooHashmap<KeyType, ValueType, Hasher, KeyEqual>::Remove(const KeyType &key) {
+  const uint64_t kHash = Hash(key);
+  std::shared_lock<internals::SharedSpinLock> table_lock(table_mutex_);
+  Table &table = *table_.load(std::memory_order_relaxed);
+  const Position kPosition(kHash, table.mask);
+  PositionLock lock(table, kPosition);
+  for (uint64_t index : {kPosition.first, kPosition.second}) {
+    Bucket &bucket = table.buckets[index];
+    for (uint32_t slot = 0; slot < kSlotsPerBucket; slot++) {
+      if (bucket.tags[slot].load(std::memory_order_relaxed) == kPosition.tag && KeysEqual(bucket.At(slot).key, key)) {
+        bucket.tags[slot].store(0, std::memory_order_relaxed);
+        size_.Add(-1);
+        return kOperationSuccess;
+      }
+    }
+  }
+  return kOperationFailed;
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual>
+void CuckooHashmap<KeyType, ValueType, Hasher, KeyEqual>::Clear() {
+  std::lock_guard<internals::SharedSpinLock> table_lock(table_mutex_);
+  Table *table = table_.load(std::memory_order_relaxed);
+  table_.store(new Table(table->buckets.size()), std::memory_order_release);
+  internals::EpochDomain::Instance().Retire(table);
+  size_.Store(0);
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual>
+uint64_t CuckooHashmap<KeyType, ValueType, Hasher, KeyEqual>::Size() const {
+  return size_.Load();
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual>
+bool CuckooHashmap<KeyType, ValueType, Hasher, KeyEqual>::Empty() const {
+  return 0 == size_.Load();
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual>
+uint64_t CuckooHashmap<KeyType, ValueType, Hasher, KeyEqual>::BucketCount() const {
+  internals::EpochGuard guard;
+  return table_.load(std::memory_order_acquire)->buckets.size();
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual>
+uint64_t CuckooHashmap<KeyType, ValueType, Hasher, KeyEqual>::AlternativeIndex(uint64_t index, uint8_t tag,
+                                                                               uint64_t mask) {
+  // xor keeps the relation symmetric: the alternative of the alternative is the index itself
+  return (index ^ (tag * 0x5bd1e995ull)) & mask;
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual>
+void CuckooHashmap<KeyType, ValueType, Hasher, KeyEqual>::Backoff(uint32_t attempt) {
+  if (attempt >= 16)
+    std::this_thread::yield();
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual>
+bool CuckooHashmap<KeyType, ValueType, Hasher, KeyEqual>::ReadValue(Table &table, const Position &position,
+                                                                    const KeyType &key, ValueType &value) const {
+  const Bucket &first = table.buckets[position.first];
+  const Bucket &second = table.buckets[position.second];
+  SlotStorage copy_storage;
+  for (uint32_t attempt = 0; attempt < kMaxOptimisticAttempts; attempt++) {
+    const uint32_t kFirstVersion = first.version.load(std::memory_order_acquire);
+    const uint32_t kSecondVersion = second.version.load(std::memory_order_acquire);
+    if ((kFirstVersion | kSecondVersion) & 1)
+      continue;
+
+    const bool kIsFound = CopySlot(first, position.tag, key, copy_storage) ||
+                          CopySlot(second, position.tag, key, copy_storage);
+
+    // both buckets are validated together: an element moving between them is seen in one of the two copies
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (first.version.load(std::memory_order_relaxed) != kFirstVersion ||
+        second.version.load(std::memory_order_relaxed) != kSecondVersion)
+      continue;
+    if (kIsFound)
+      value = reinterpret_cast<const Slot *>(&copy_storage)->value;
+    return kIsFound;
+  }
+
+  // a stream of writers: wait for the turn instead of retrying forever
+  PositionLock lock(table, position);
+  const Slot *slot = const_cast<CuckooHashmap *>(this)->FindLocked(table, position, key);
+  if (slot != nullptr)
+    value = slot->value;
+  return slot != nullptr;
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual>
+bool CuckooHashmap<KeyType, ValueType, Hasher, KeyEqual>::CopySlot(const Bucket &bucket, uint8_t tag,
+                                                                   const KeyType &key, SlotStorage &copy) const {
+  for (uint32_t slot = 0; slot < kSlotsPerBucket; slot++) {
+    if (bucket.tags[slot].load(std::memory_order_relaxed) != tag)
+      continue;
+    std::memcpy(&copy, &bucket.slots[slot], sizeof(Slot));
+    if (KeysEqual(reinterpret_cast<const Slot *>(&copy)->key, key))
+      return true;
+  }
+  return false;
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual>
+typename CuckooHashmap<KeyType, ValueType, Hasher, KeyEqual>::Slot *
+CuckooHashmap<KeyType, ValueType, Hasher, KeyEqual>::FindLocked(Table &table, const Position &position,
+                                                                const KeyType &key) {
+  for (uint64_t index : {position.first, position.second}) {
+    Bucket &bucket = table.buckets[index];
+    for (uint32_t slot = 0; slot < kSlotsPerBucket; slot++)
+      if (bucket.tags[slot].load(std::memory_order_relaxed) == position.tag && KeysEqual(bucket.At(slot).key, key))
+        return &bucket.At(slot);
+  }
+  return nullptr;
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual>
+bool CuckooHashmap<KeyType, ValueType, Hasher, KeyEqual>::PlaceLocked(Table &table, const Position &position,
+                                                                      const KeyType &key, const ValueType &value) {
+  for (uint64_t index : {position.first, position.second}) {
+    Bucket &bucket = table.buckets[index];
+    const uint32_t kSlot = bucket.FreeSlot();
+    if (kSlot == kSlotsPerBucket)
+      continue;
+    new (&bucket.slots[kSlot]) Slot{key, value};
+    bucket.tags[kSlot].store(position.tag, std::memory_order_relaxed);
+    return true;
+  }
+  return false;
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual>
+bool CuckooHashmap<KeyType, ValueType, Hasher, KeyEqual>::MakeRoom(Table &table, const Position &position) {
+  // breadth first: the shortest path moves the fewest elements
+  std::vector<PathNode> path{{position.first, -1, 0}, {position.second, -1, 0}};
+  path.reserve(kMaxSearchedBuckets);
+  for (uint32_t node = 0; node < path.size(); node++) {
+    const Bucket &bucket = table.buckets[path[node].bucket];
+    const uint32_t kFreeSlot = bucket.FreeSlot();
+    if (kFreeSlot < kSlotsPerBucket)
+      return ShiftPath(table, path, node, kFreeSlot);
+    for (uint32_t slot = 0; slot < kSlotsPerBucket && path.size() < kMaxSearchedBuckets; slot++) {
+      const uint8_t kTag = bucket.tags[slot].load(std::memory_order_relaxed);
+      path.push_back({AlternativeIndex(path[node].bucket, kTag, table.mask), static_cast<int32_t>(node), slot});
+    }
+  }
+  return false;
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual>
+bool CuckooHashmap<KeyType, ValueType, Hasher, KeyEqual>::ShiftPath(Table &table, const std::vector<PathNode> &path,
+                                                                    int32_t leaf, uint32_t free_slot) {
+  for (int32_t node = leaf; path[node].parent >= 0; node = path[node].parent) {
+    const PathNode &to = path[node];
+    const PathNode &from = path[to.parent];
+    Bucket &source = table.buckets[from.bucket];
+    Bucket &target = table.buckets[to.bucket];
+    const uint8_t kTag = source.tags[to.slot].load(std::memory_order_relaxed);
+    // a path through the same bucket twice may have replaced the element, the moves done so far are still valid
+    if (AlternativeIndex(from.bucket, kTag, table.mask) != to.bucket)
+      return false;
+
+    // copy before erase: a concurrent lookup validates both buckets and finds the element in one of them
+    target.Lock();
+    std::memcpy(&target.slots[free_slot], &source.slots[to.slot], sizeof(Slot));
+    target.tags[free_slot].store(kTag, std::memory_order_relaxed);
+    target.Unlock();
+    source.Lock();
+    source.tags[to.slot].store(0, std::memory_order_relaxed);
+    source.Unlock();
+    free_slot = to.slot;
+  }
+  return true;
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual>
+void CuckooHashmap<KeyType, ValueType, Hasher, KeyEqual>::Grow(Table &table) {
+  for (uint64_t num_buckets = 2 * table.buckets.size(); ; num_buckets *= 2) {
+    std::unique_ptr<Table> grown(new Table(num_buckets));
+    bool is_placed = true;
+    for (uint64_t index = 0; index < table.buckets.size() && is_placed; index++) {
+      const Bucket &bucket = table.buckets[index];
+      for (uint32_t slot = 0; slot < kSlotsPerBucket && is_placed; slot++) {
+        if (bucket.tags[slot].load(std::memory_order_relaxed) == 0)
+          continue;
+        const Slot &element = bucket.At(slot);
+        const Position kPosition(Hash(element.key), grown->mask);
+        is_placed = PlaceLocked(*grown, kPosition, element.key, element.value) ||
+                    (MakeRoom(*grown, kPosition) && PlaceLocked(*grown, kPosition, element.key, element.value));
+      }
+    }
+    if (!is_placed)
+      continue;
+    // the lookups still reading the old table see it unchanged, the writers wait for the table lock
+    table_.store(grown.release(), std::memory_order_release);
+    internals::EpochDomain::Instance().Retire(&table);
+    return;
+  }
+}
+
+} // namespace my_concurrency
+
+#endif //THREADSAFE_HASHMAP_CUCKOO_HASHMAP_H
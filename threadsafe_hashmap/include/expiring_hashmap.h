@@ -0,0 +1,231 @@
+#ifndef THREADSAFE_HASHMAP_EXPIRING_HASHMAP_H
+#define THREADSAFE_HASHMAP_EXPIRING_HASHMAP_H
+
+#include <algorithm> // max
+#include <chrono>
+#include <condition_variable>
+#include <functional> // hash, equal_to
+#include <inttypes.h>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <utility> // pair
+
+#include "threadsafe_hashmap.h"
+#include "../src/sharded_counter.h"
+
+namespace my_concurrency {
+
+/// @brief ThreadsafeHashmap with optional per-element deadlines. An expired element is invisible to Lookup and
+///        ForEach at once and is reclaimed later by the sweeps: every kWritesPerSweepStep-th write of a thread to
+///        the map sweeps kBucketsPerSweepStep buckets, like the incremental resizing moves some elements on each
+///        write, and an optional sweeper thread goes through the table at a bounded pace. Deadlines come from the
+///        coarse monotonic clock (internals::CoarseNowMs), so neither the lookups nor the writes make a syscall
+/// @tparam see ThreadsafeHashmap
+template <typename KeyType, typename ValueType, typename Hasher = std::hash<KeyType>,
+          typename KeyEqual = std::equal_to<KeyType>, template <typename...> class BucketType = internals::Bucket,
+          typename NodeAllocator = internals::HeapNodeAllocator, typename IndexPolicy = ModuloIndexing>
+class ExpiringHashmap {
+ public:
+  explicit ExpiringHashmap(uint64_t num_buckets = 64, const Hasher &hasher = Hasher(),
+                           const KeyEqual &key_equal = KeyEqual(), const NodeAllocator &allocator = NodeAllocator());
+  /// @brief stops the sweeper if it runs
+  ~ExpiringHashmap();
+  ExpiringHashmap(const ExpiringHashmap &) = delete;
+  ExpiringHashmap &operator=(const ExpiringHashmap &) = delete;
+
+  /// @brief Adds the element which never expires, or overwrites the existing one together with its deadline
+  void Insert(const KeyType &key, const ValueType &value);
+  /// @brief Adds the element which expires after ttl, or overwrites the existing one together with its deadline
+  void Insert(const KeyType &key, const ValueType &value, std::chrono::milliseconds ttl);
+
+  /// @return a pair with first element shows if the key was found and has not expired yet, and
+  ///         second element is associated value or default one
+  std::pair<bool, ValueType> Lookup(const KeyType &key) const;
+
+  /// @return true if the element was in the map, even if it has expired already
+  bool Remove(const KeyType &key);
+
+  /// @brief calls visitor(const KeyType &, const ValueType &) for every element which has not expired,
+  ///        with the guarantees of ThreadsafeHashmap::ForEach
+  template <typename Visitor>
+  void ForEach(Visitor visitor);
+
+  /// @brief removes the expired elements of the next max_buckets buckets, see ThreadsafeHashmap::RemoveIf
+  /// @return number of removed elements
+  uint64_t Sweep(uint64_t max_buckets);
+
+  /// @brief starts the thread which sweeps buckets_per_step buckets and then sleeps for pause
+  void StartSweeper(uint64_t buckets_per_step = kDefaultSweepBuckets,
+                    std::chrono::milliseconds pause = std::chrono::milliseconds(10));
+  void StopSweeper();
+
+  /// @brief approximate size, it counts the expired elements which are not reclaimed yet
+  uint64_t Size() const;
+  uint64_t BucketCount() const;
+
+  static constexpr uint64_t kNoDeadline = std::numeric_limits<uint64_t>::max();
+  static constexpr uint32_t kWritesPerSweepStep = 8; ///< writes of a thread to the map between its sweep steps
+  static constexpr uint64_t kBucketsPerSweepStep = 4; ///< buckets swept by a write
+  static constexpr uint64_t kDefaultSweepBuckets = 1024; ///< buckets swept by a step of the sweeper thread
+
+ private:
+  /// @brief value stored in the map: the user value and its deadline in CoarseNowMs milliseconds
+  struct Timed {
+    ValueType value;
+    uint64_t deadline_ms = kNoDeadline;
+  };
+
+  typedef ThreadsafeHashmap<KeyType, Timed, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy> Map;
+
+  /// @brief sweeps a few buckets once per kWritesPerSweepStep calls counted by the cell of the thread
+  void SweepStep();
+  /// @brief main loop of the sweeper thread
+  void Sweeping();
+
+  Map map_;
+  internals::ShardedCounter num_writes_; ///< a cell per thread, as the sizes of the map: the writers do not share it
+  std::thread sweeper_thread_;
+  std::mutex sweeper_mutex_; ///< guards the fields below and the start/stop of the sweeper
+  std::condition_variable sweeper_cv_;
+  bool sweeper_stop_ = false;
+  uint64_t sweeper_buckets_ = kDefaultSweepBuckets;
+  std::chrono::milliseconds sweeper_pause_{10};
+};
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+ExpiringHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::ExpiringHashmap(
+    uint64_t num_buckets, const Hasher &hasher, const KeyEqual &key_equal, const NodeAllocator &allocator)
+    : map_(num_buckets, hasher, key_equal, allocator) { }
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+ExpiringHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::~ExpiringHashmap() {
+  StopSweeper();
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+void ExpiringHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::Insert(
+    const KeyType &key, const ValueType &value) {
+  map_.Insert(key, Timed{value, kNoDeadline});
+  SweepStep();
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+void ExpiringHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::Insert(
+    const KeyType &key, const ValueType &value, std::chrono::milliseconds ttl) {
+  const uint64_t kTtl = static_cast<uint64_t>(std::max<int64_t>(0, ttl.count()));
+  const uint64_t kNow = internals::CoarseNowMs();
+  map_.Insert(key, Timed{value, kTtl < kNoDeadline - kNow? kNow + kTtl : kNoDeadline});
+  SweepStep();
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+std::pair<bool, ValueType>
+ExpiringHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::Lookup(
+    const KeyType &key) const {
+  std::pair<bool, ValueType> result(false, ValueType());
+  const uint64_t kNow = internals::CoarseNowMs();
+  map_.Visit(key, [&result, kNow](const Timed &timed) {
+    if (kNow < timed.deadline_ms)
+      result = std::make_pair(true, timed.value);
+  });
+  return result;
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+bool ExpiringHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::Remove(
+    const KeyType &key) {
+  const bool kWasRemoved = map_.Remove(key);
+  SweepStep();
+  return kWasRemoved;
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+template <typename Visitor>
+void ExpiringHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::ForEach(
+    Visitor visitor) {
+  const uint64_t kNow = internals::CoarseNowMs();
+  map_.ForEach([&visitor, kNow](const KeyType &key, const Timed &timed) {
+    if (kNow < timed.deadline_ms)
+      visitor(key, timed.value);
+  });
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+uint64_t ExpiringHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::Sweep(
+    uint64_t max_buckets) {
+  const uint64_t kNow = internals::CoarseNowMs();
+  return map_.RemoveIf([kNow](const KeyType &, const Timed &timed) { return timed.deadline_ms <= kNow; },
+                       max_buckets);
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+void ExpiringHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::SweepStep() {
+  if (num_writes_.Add(1) % kWritesPerSweepStep == 0)
+    Sweep(kBucketsPerSweepStep);
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+void ExpiringHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::StartSweeper(
+    uint64_t buckets_per_step, std::chrono::milliseconds pause) {
+  std::lock_guard<std::mutex> lock(sweeper_mutex_);
+  if (sweeper_thread_.joinable())
+    return;
+  sweeper_buckets_ = std::max<uint64_t>(1, buckets_per_step);
+  sweeper_pause_ = pause;
+  sweeper_stop_ = false;
+  sweeper_thread_ = std::thread(&ExpiringHashmap::Sweeping, this);
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+void ExpiringHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::StopSweeper() {
+  std::thread sweeper;
+  {
+    std::lock_guard<std::mutex> lock(sweeper_mutex_);
+    if (!sweeper_thread_.joinable())
+      return;
+    sweeper_stop_ = true;
+    sweeper = std::move(sweeper_thread_);
+  }
+  sweeper_cv_.notify_one();
+  sweeper.join();
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+void ExpiringHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::Sweeping() {
+  while (true) {
+    Sweep(sweeper_buckets_);
+    std::unique_lock<std::mutex> lock(sweeper_mutex_);
+    if (sweeper_cv_.wait_for(lock, sweeper_pause_, [this]() { return sweeper_stop_; }))
+      return;
+  }
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+uint64_t ExpiringHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::Size() const {
+  return map_.Size();
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+uint64_t
+ExpiringHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::BucketCount() const {
+  return map_.BucketCount();
+}
+
+} // namespace my_concurrency
+
+#endif //THREADSAFE_HASHMAP_EXPIRING_HASHMAP_H
@@ -0,0 +1,108 @@
+#ifndef THREADSAFE_HASHMAP_SNAPSHOT_VIEW_H
+#define THREADSAFE_HASHMAP_SNAPSHOT_VIEW_H
+
+#include <functional> // hash, equal_to
+#include <inttypes.h>
+#include <string>
+#include <utility> // pair
+
+#include "../src/hash_policies.h"
+#include "../src/snapshot.h"
+
+namespace my_concurrency {
+
+/// @brief Read-only map over a snapshot written by ThreadsafeHashmap::SaveSnapshot: the file is mapped into memory
+///        and the lookups go to the stored buckets in place: opening only checks the bucket offsets and the stored
+///        strings, no element is copied. Nothing is modified, so any number of threads may look up concurrently
+/// @tparam Hasher, KeyEqual, IndexPolicy must give the same hashes and buckets as the ones of the saved map
+template <typename KeyType, typename ValueType, typename Hasher = std::hash<KeyType>,
+          typename KeyEqual = std::equal_to<KeyType>, typename IndexPolicy = ModuloIndexing>
+class SnapshotView {
+ public:
+  explicit SnapshotView(const Hasher &hasher = Hasher(), const KeyEqual &key_equal = KeyEqual());
+  SnapshotView(const SnapshotView &) = delete;
+  SnapshotView &operator=(const SnapshotView &) = delete;
+
+  /// @brief maps the snapshot, the previous one is unmapped
+  /// @return false if the file is not a snapshot of these types or its hashes differ from the ones of the hasher
+  bool Open(const std::string &path);
+
+  /// @return a pair with first element shows if the key was found and second element is the decoded value
+  std::pair<bool, ValueType> Lookup(const KeyType &key) const;
+
+  uint64_t Size() const;
+  uint64_t BucketCount() const;
+
+ private:
+  typedef internals::SnapshotCodec<KeyType> KeyCodec;
+  typedef internals::SnapshotCodec<ValueType> ValueCodec;
+
+  Hasher hasher_;
+  KeyEqual key_equal_;
+  internals::MappedFile file_;
+  uint64_t num_buckets_ = 0;
+  uint64_t num_elements_ = 0;
+  const uint64_t *bucket_offsets_ = nullptr;
+  const uint64_t *hashes_ = nullptr;
+  const typename KeyCodec::Stored *keys_ = nullptr;
+  const typename ValueCodec::Stored *values_ = nullptr;
+  const char *blob_ = nullptr;
+};
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual, typename IndexPolicy>
+SnapshotView<KeyType, ValueType, Hasher, KeyEqual, IndexPolicy>::SnapshotView(const Hasher &hasher,
+                                                                              const KeyEqual &key_equal)
+    : hasher_(hasher), key_equal_(key_equal) { }
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual, typename IndexPolicy>
+bool SnapshotView<KeyType, ValueType, Hasher, KeyEqual, IndexPolicy>::Open(const std::string &path) {
+  num_buckets_ = 0;
+  num_elements_ = 0;
+  if (!file_.Open(path))
+    return false;
+  const internals::SnapshotHeader *header = internals::CheckSnapshot<KeyType, ValueType>(file_);
+  if (nullptr == header || !internals::CheckSnapshotSections<KeyType, ValueType>(file_))
+    return false;
+  if (header->hash_seed != IndexPolicy::Mix(hasher_(KeyType())) ||
+      IndexPolicy::BucketCount(header->num_buckets) != header->num_buckets) {
+    WARNING("the snapshot was saved with another hasher or index policy");
+    return false;
+  }
+  const internals::SnapshotLayout kLayout(*header);
+  bucket_offsets_ = reinterpret_cast<const uint64_t *>(file_.Data() + kLayout.bucket_offsets);
+  hashes_ = reinterpret_cast<const uint64_t *>(file_.Data() + kLayout.hashes);
+  keys_ = reinterpret_cast<const typename KeyCodec::Stored *>(file_.Data() + kLayout.keys);
+  values_ = reinterpret_cast<const typename ValueCodec::Stored *>(file_.Data() + kLayout.values);
+  blob_ = file_.Data() + kLayout.blob;
+  num_buckets_ = header->num_buckets;
+  num_elements_ = header->num_elements;
+  return true;
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual, typename IndexPolicy>
+std::pair<bool, ValueType> SnapshotView<KeyType, ValueType, Hasher, KeyEqual, IndexPolicy>::Lookup(
+    const KeyType &key) const {
+  if (0 == num_buckets_)
+    return std::make_pair(false, ValueType());
+  const uint64_t kHash = IndexPolicy::Mix(hasher_(key));
+  const uint64_t kBucket = IndexPolicy::Index(kHash, num_buckets_);
+  for (uint64_t i = bucket_offsets_[kBucket]; i < bucket_offsets_[kBucket + 1]; i++) {
+    if (hashes_[i] == kHash && key_equal_(KeyCodec::Decode(keys_[i], blob_), key))
+      return std::make_pair(true, ValueCodec::Decode(values_[i], blob_));
+  }
+  return std::make_pair(false, ValueType());
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual, typename IndexPolicy>
+uint64_t SnapshotView<KeyType, ValueType, Hasher, KeyEqual, IndexPolicy>::Size() const {
+  return num_elements_;
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual, typename IndexPolicy>
+uint64_t SnapshotView<KeyType, ValueType, Hasher, KeyEqual, IndexPolicy>::BucketCount() const {
+  return num_buckets_;
+}
+
+} // namespace my_concurrency
+
+#endif //THREADSAFE_HASHMAP_SNAPSHOT_VIEW_H
@@ -1,49 +1,290 @@
 #ifndef THREADSAFE_HASHMAP_THREADSAFEHASHMAP_H
 #define THREADSAFE_HASHMAP_THREADSAFEHASHMAP_H
 
+#include <algorithm> // max
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef> // ptrdiff_t
 #include <functional> // hash
-#include <math.h> // sqrt
+#include <iterator>
+#include <limits>
+#include <math.h> // sqrt, ceil
 #include <memory>
+#include <mutex>
+#include <numeric> // gcd
 #include <shared_mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits> // decay
 #include <utility> //pair
+#include <vector>
 
 #include "../src/bucket.h"
+#include "../src/epoch_reclamation.h"
+#include "../src/flat_bucket.h"
+#include "../src/hash_policies.h"
+#include "../src/lockfree_read_bucket.h"
 #include "../src/helpers.h"
+#include "../src/map_stats.h"
+#include "../src/node_allocator.h"
+#include "../src/seqlock_bucket.h"
+#include "../src/sharded_counter.h"
+#include "../src/snapshot.h"
 
 namespace my_concurrency {
 
 /// @brief ThreadsafeHashmap provides a hashmap behaviour with incremental resizing for multithreading purposes
 /// @tparam KeyType should have default constructor
 /// @tparam ValueType should have default constructor
-template <typename KeyType, typename ValueType>
-class ThreadsafeHashmap {
+/// @tparam Hasher hash function object. It must always return the same value for the same argument
+/// @tparam KeyEqual equality predicate of the keys, consistent with Hasher
+/// @tparam BucketType storage of a single bucket: internals::Bucket (chained list), internals::FlatBucket
+///         (open addressing with SIMD-probed hash tags) or internals::LockFreeReadBucket (chained list with
+///         lock-free readers). Lookup and Visit take no table state lock in any of the modes: they pin an epoch
+///         of internals::EpochDomain and read the tables published in the view, so only the bucket is shared
+///         with the writers
+/// @tparam NodeAllocator source of the bucket nodes: internals::HeapNodeAllocator or internals::SlabNodeAllocator
+/// @tparam IndexPolicy maps the hash to a bucket: ModuloIndexing (any bucket count) or PowerOfTwoIndexing
+///         (bucket count is rounded up to a power of two, the hash is mixed and masked). The index must be the
+///         hash modulo the bucket count: the traversals find the elements of an old bucket in the new table by it
+template <typename KeyType, typename ValueType, typename Hasher = std::hash<KeyType>,
+          typename KeyEqual = std::equal_to<KeyType>, template <typename...> class BucketType = internals::Bucket,
+          typename NodeAllocator = internals::HeapNodeAllocator, typename IndexPolicy = ModuloIndexing>
+class ThreadsafeHashmap : private internals::PolicyHolder<Hasher, 0>, private internals::PolicyHolder<KeyEqual, 1> {
  public:
   /// @param num_buckets initial number of available buckets
-  /// @param hasher custom hash function. It must always return the same value for the same argument
-  ThreadsafeHashmap(uint64_t num_buckets = 64, std::function<uint64_t(KeyType)> hasher = std::hash<KeyType>());
-  /// @brief snapshot copy
+  /// @param hasher instance of the hash function, e.g. a lambda
+  /// @param key_equal instance of the key predicate, the buckets keep copies of it
+  /// @param allocator shared by all of the buckets of the map
+  explicit ThreadsafeHashmap(uint64_t num_buckets = 64, const Hasher &hasher = Hasher(),
+                             const KeyEqual &key_equal = KeyEqual(), const NodeAllocator &allocator = NodeAllocator());
+  /// @brief bulk load: builds the table for the elements of [first, last) at once, without resizing. The keys are
+  ///        hashed and partitioned by bucket in parallel, then every thread fills its own range of buckets,
+  ///        so each bucket is locked once and never contended. The later of duplicate keys wins
+  /// @param num_threads builders of the table, it also becomes the number of maintenance threads
+  template <typename InputIt, typename = internals::EnableIfIterator<InputIt>>
+  ThreadsafeHashmap(InputIt first, InputIt last, uint32_t num_threads = 1, const Hasher &hasher = Hasher(),
+                    const KeyEqual &key_equal = KeyEqual(), const NodeAllocator &allocator = NodeAllocator());
+  /// @brief bulk load of the pairs, see the range constructor
+  explicit ThreadsafeHashmap(const std::vector<std::pair<KeyType, ValueType>> &elements, uint32_t num_threads = 1,
+                             const Hasher &hasher = Hasher(), const KeyEqual &key_equal = KeyEqual(),
+                             const NodeAllocator &allocator = NodeAllocator());
+  /// @brief snapshot copy: the writers of rhs wait until it is done. The copy shares the allocator and the
+  ///        number of maintenance threads, which copy the buckets in parallel
   ThreadsafeHashmap(const ThreadsafeHashmap &rhs);
   /// @brief Copying of rvalue object assumes no other thread uses this map
   ///        therefore constructor thread-unsafe for param
   ThreadsafeHashmap(ThreadsafeHashmap &&rhs);
 
-  ~ThreadsafeHashmap() = default;
+  /// @brief stops the background resizer if it runs
+  ~ThreadsafeHashmap();
 
   /// @brief Add key-value pair to the map. Overwrites value if an element with the same key already exists
   void Insert(const KeyType &key, const ValueType &value);
+  /// @brief moves the pair into the map, see InsertOrAssign
+  void Insert(KeyType &&key, ValueType &&value);
+
+  /// @brief constructs the value from args inside the new element unless the key exists.
+  ///        Nothing is constructed for an existing key
+  /// @tparam K KeyType or a reference to it, an rvalue key is moved into the new element
+  /// @return true if new element was inserted
+  template <typename K, typename... Args>
+  bool TryEmplace(K &&key, Args &&... args);
+
+  /// @brief assigns the forwarded value to the existing element, otherwise inserts the element constructed from
+  ///        the forwarded key and value. The node is only built for a new key
+  /// @return true if new element was inserted
+  template <typename K, typename V>
+  bool InsertOrAssign(K &&key, V &&value);
+
+  /// @brief constructs the value from args inside the new element, or assigns ValueType(args...) to the existing one
+  /// @return true if new element was inserted
+  template <typename K, typename... Args>
+  bool Emplace(K &&key, Args &&... args);
 
   /// @return a pair with first element shows if the key was found and
   ///          second element is associated value or default one
   std::pair<bool, ValueType> Lookup(const KeyType &key) const;
+  /// @brief heterogeneous overloads of Lookup, Remove and Visit, enabled when both Hasher and KeyEqual declare
+  ///        is_transparent (e.g. StringHash and std::equal_to<>): the key is hashed and compared as is,
+  ///        so a std::string_view finds a std::string key without building a temporary one
+  template <typename K, typename = internals::EnableIfTransparent<Hasher, KeyEqual, K>>
+  std::pair<bool, ValueType> Lookup(const K &key) const;
 
   /// @return true if successful removal, false if there is no element with such key
   bool Remove(const KeyType &key);
+  template <typename K, typename = internals::EnableIfTransparent<Hasher, KeyEqual, K>>
+  bool Remove(const K &key);
+
+  /// @brief calls visitor(const ValueType &) for the element under the lock of its bucket, so the value is not
+  ///        copied. The visitor must not call the map
+  /// @return true if the key was found
+  template <typename Visitor>
+  bool Visit(const KeyType &key, Visitor visitor) const;
+  template <typename K, typename Visitor, typename = internals::EnableIfTransparent<Hasher, KeyEqual, K>>
+  bool Visit(const K &key, Visitor visitor) const;
+
+  /// @brief atomic read-modify-write under the lock of the bucket: calls update(ValueType &) for the existing
+  ///        element, otherwise inserts the value returned by create(). The callbacks must not call the map
+  /// @return true if new element was inserted
+  template <typename Updater, typename Creator>
+  bool Upsert(const KeyType &key, Updater update, Creator create);
+
+  /// @brief inserts the value returned by create() unless the key exists. create() runs under the lock of the bucket
+  /// @return true if new element was inserted
+  template <typename Creator>
+  bool ComputeIfAbsent(const KeyType &key, Creator create);
+
+  /// @brief Inserts count pairs under one acquisition of the table state lock: the keys are hashed up front,
+  ///        grouped by bucket and every bucket is updated under one lock. The later of duplicate keys wins
+  void InsertBatch(const KeyType *keys, const ValueType *values, uint64_t count);
+
+  /// @brief Looks count keys up under one acquisition of the table state lock, grouped by bucket
+  /// @param results array of count elements, receives the results in the order of the keys
+  void LookupBatch(const KeyType *keys, uint64_t count, std::pair<bool, ValueType> *results) const;
+
+  /// @brief Bounded sweep: removes the elements for which predicate(const KeyType &, const ValueType &) is true
+  ///        from the next max_buckets buckets of the current table, each under its own lock. The calls continue
+  ///        where the previous one stopped and wrap around, so repeated calls visit all of the buckets
+  /// @return number of removed elements
+  template <typename Predicate>
+  uint64_t RemoveIf(Predicate predicate, uint64_t max_buckets);
+
+  /// @brief Weakly consistent traversal: calls visitor(const KeyType &, const ValueType &) for every element,
+  ///        one bucket at a time under the lock of the bucket. An element which stays in the map for the whole
+  ///        traversal is visited exactly once, the ones inserted or removed meanwhile may be missed.
+  ///        The resizings go on meanwhile. The traversal goes over the buckets of the table it started on: the
+  ///        elements of such a bucket are found in the buckets of the later tables congruent to it modulo the
+  ///        greatest common divisor of the bucket counts, the old buckets among them are drained first while
+  ///        resizing. Growing and shrinking by kIncreaseRate keep the divisor big; after a resizing to an unrelated
+  ///        size (Reserve, ShrinkToFit), or by more than kMaxScanFanout times, the traversal goes over the current
+  ///        table from the start and skips the elements it has passed. The visitor must not call the map
+  template <typename Visitor>
+  void ForEach(Visitor visitor);
+
+  /// @brief ForEach split into num_threads contiguous ranges of buckets: the visitor is called concurrently
+  template <typename Visitor>
+  void ParallelForEach(Visitor visitor, uint32_t num_threads);
 
+  /// @brief Weakly consistent input iterator with the guarantees of ForEach: it copies the elements out of one
+  ///        bucket at a time and holds no lock in between, so an iterator kept alive holds nothing back
+  class ScanIterator;
+  ScanIterator Begin();
+  ScanIterator End();
+
+  /// @brief approximate size: sums the sharded counters without stopping the writers, so concurrent updates may be
+  ///        partially seen. Exact when no thread modifies the map
   uint64_t Size() const;
+  /// @brief exact size: blocks the writers for the time of summing the counters
+  uint64_t SizeExact() const;
+  /// @brief swaps empty tables in under the exclusive lock. The old elements are destroyed after releasing it
   void Clear();
   bool Empty() const;
 
+  /// @return number of buckets of the current table, the new one while resizing
+  uint64_t BucketCount() const;
+
+  /// @brief Enables incremental shrinking: a removal which leaves the load factor below min_load_factor
+  ///        starts moving the elements to a table kIncreaseRate times smaller, but not smaller than the
+  ///        initial one. Zero (default) disables shrinking
+  /// @param min_load_factor is capped by kMaxMinLoadFactor, so a table never shrinks into the next growth
+  void SetMinLoadFactor(double min_load_factor);
+
+  /// @brief Grows the table, so num_elements fit without a resizing. The caller does all of the migration itself,
+  ///        as in ShrinkToFit. Does nothing if the table is big enough. Shrinking (see SetMinLoadFactor) may still
+  ///        take the table back after removals
+  void Reserve(uint64_t num_elements);
+
+  /// @brief Finishes the current resizing, then moves the elements to the smallest table which keeps the load
+  ///        factor at kMaxLoadFactor / kIncreaseRate. The caller does all of the migration itself
+  void ShrinkToFit();
+
+  /// @brief Sets the number of threads which build, copy and destroy the tables (snapshot copy, Clear, resizing,
+  ///        destruction of the map): every thread takes a contiguous range of at least kMinBucketsPerWorker
+  ///        buckets. One (default) keeps all of the work in the calling thread
+  void SetMaintenanceThreads(uint32_t num_threads);
+
+  /// @brief allocator of the nodes, e.g. to check SlabNodeAllocator::Stats()
+  const NodeAllocator &GetAllocator() const;
+  /// @brief policies the map was created with
+  const Hasher &GetHasher() const;
+  const KeyEqual &GetKeyEqual() const;
+
+  /// @brief Moves incremental resizing from the caller threads to a dedicated thread.
+  ///        The thread migrates batch_size elements at a time and sleeps for pause between the batches.
+  ///        Insert and Remove only route the keys to the right table, unless the new table gets overloaded
+  ///        before the old one is drained: then the callers help as in the default mode. A write to a key still
+  ///        in the old table moves that one old bucket first, so the value is updated in place
+  /// @param batch_size amount of elements migrated under one acquisition of the table state lock
+  /// @param pause delay between the batches, zero means the thread only yields
+  void StartBackgroundResizing(uint64_t batch_size = kDefaultResizerBatch,
+                               std::chrono::microseconds pause = std::chrono::microseconds(0));
+  /// @brief joins the resizer thread. An unfinished resizing is continued by the callers
+  void StopBackgroundResizing();
+
+  /// @brief metrics of the last finished resizing
+  struct ResizeStats {
+    uint64_t num_resizes = 0; ///< resizings finished since the map was created
+    uint64_t old_num_buckets = 0;
+    uint64_t new_num_buckets = 0;
+    uint64_t buckets_moved = 0; ///< old buckets drained by the helpers
+    uint64_t elements_moved = 0;
+    uint64_t ranges_claimed = 0;
+    uint64_t num_helpers = 0; ///< distinct threads which drained at least one range of buckets
+    uint64_t duration_us = 0; ///< from the table allocation to the switch of the tables
+    uint64_t start_time_us = 0; ///< wall clock of the table allocation, microseconds since the Unix epoch
+    uint64_t finish_time_us = 0; ///< wall clock of the switch of the tables
+  };
+  ResizeStats LastResizeStats() const;
+
+  typedef internals::LockWaitStats LockWaitStats;
+  /// @brief State of the map for tuning kMaxLoadFactor and catching bad hashers. The lock waits and the migration
+  ///        steps are counted only in the statistics mode (THREADSAFE_HASHMAP_STATS), they stay zero otherwise
+  struct MapStats {
+    bool is_detailed = internals::kCollectStats; ///< the lock waits and moved_per_call are counted
+    uint64_t num_buckets = 0;
+    uint64_t num_elements = 0; ///< summed over the buckets
+    std::vector<uint64_t> chain_lengths; ///< buckets by number of elements, the last slot takes the longer chains too
+    uint64_t max_chain_length = 0;
+    double empty_bucket_fraction = 0;
+    double expected_empty_fraction = 0; ///< of a uniform hash at the same load: exp(-elements / buckets)
+    LockWaitStats bucket_lock_waits; ///< of the buckets of the current table since it was built
+    LockWaitStats state_lock_waits; ///< of the table state lock since the map was created
+    ResizeStats last_resize;
+    /// a resizing is in progress: the buckets above are the ones of its old table then, and the elements it has
+    /// moved are counted in new_table_elements. current_resize shows its progress, num_resizes and finish_time_us
+    /// stay zero there
+    bool is_resizing = false;
+    ResizeStats current_resize;
+    uint64_t new_table_elements = 0;
+    uint64_t retired_tables = 0; ///< replaced tables and views kept for the lookups which may still read them
+    /// ContinuousMoving calls by elements moved: [0] none, [i] from 2^(i-1) to 2^i - 1
+    std::vector<uint64_t> moved_per_call;
+  };
+  /// @brief Reads the buckets of the current table kScanChunk at a time under the shared state lock, every one under
+  ///        its own lock only: the writers and the resizing go on meanwhile. A resizing in progress is reported as is
+  MapStats Stats();
+
+  enum class StatsFormat {
+    kText, ///< a "name: value" line per field
+    kJson ///< one object with the same names
+  };
+  std::string DumpStats(StatsFormat format = StatsFormat::kText);
+
+  /// @brief Writes the image of the map for LoadSnapshot and SnapshotView: the elements grouped by bucket of the
+  ///        current table, with their hashes. Keys and values must be trivially copyable or std::string.
+  ///        The writers wait while the elements are copied out, the file is written after releasing them
+  /// @return false if the file can not be written
+  bool SaveSnapshot(const std::string &path) const;
+  /// @brief Replaces the elements of the map by the ones of the snapshot. The file is mapped into memory and the
+  ///        buckets are filled in parallel by the maintenance threads with the stored hashes. If the hasher of the
+  ///        map gives other hashes than the stored ones, the elements are rehashed as by the bulk constructor.
+  ///        Assumes no other thread uses the map, as the move assignment does
+  /// @return false if the file is not a snapshot of these key and value types, the map is unchanged then
+  bool LoadSnapshot(const std::string &path);
+
   /// makes a snapshot copy
   ThreadsafeHashmap &operator=(const ThreadsafeHashmap &rhs);
   ThreadsafeHashmap &operator=(ThreadsafeHashmap &&rhs);
@@ -52,6 +293,17 @@ class ThreadsafeHashmap {
   constexpr static bool kOperationFailed = false;
   static constexpr double kIncreaseRate = 2.0; ///< new table size ratio
   static constexpr double kMaxLoadFactor = 0.75; ///< triggers resizing
+  /// upper bound of the min load factor: shrinking may at most double the load factor (hysteresis)
+  static constexpr double kMaxMinLoadFactor = kMaxLoadFactor / (2 * kIncreaseRate);
+  static constexpr uint64_t kDefaultResizerBatch = 256; ///< elements migrated by the background resizer at once
+  static constexpr uint64_t kMinTransferStride = 16; ///< smallest range of buckets a helper claims at once
+  static constexpr uint64_t kMinBucketsPerWorker = 1 << 14; ///< smallest range of buckets of a maintenance thread
+  static constexpr uint64_t kMinElementsPerWorker = 1 << 14; ///< smallest range of elements of a bulk load thread
+  static constexpr uint64_t kScanChunk = 64; ///< buckets a traversal visits under one acquisition of the state lock
+  /// most buckets of the current table a traversal visits for one bucket of its first table, see ForEach
+  static constexpr uint64_t kMaxScanFanout = 16;
+  static constexpr uint64_t kStatsMaxChainLength = 64; ///< longer chains share the last slot of the histogram
+  static constexpr uint32_t kStatsHistogramSlots = 33; ///< power-of-two slots of MapStats::moved_per_call
  private:
   /// @brief enum shows current internal state regarding to resizing
   enum class State {
@@ -59,245 +311,1797 @@ class ThreadsafeHashmap {
     kResizing ///< uses both of the tables and moves some amount of elements on each insert/remove operation
   };
 
-  typedef internals::Bucket <KeyType, ValueType> Bucket;
+  typedef BucketType<KeyType, ValueType, NodeAllocator, KeyEqual> Bucket;
+  typedef internals::PolicyHolder<Hasher, 0> HasherHolder;
+  typedef internals::PolicyHolder<KeyEqual, 1> KeyEqualHolder;
+  typedef internals::StatsMutex<std::shared_timed_mutex> StateMutex;
+
+  /// @brief destroys the buckets constructed by NewTable, in parallel for big tables
+  struct TableDeleter {
+    uint64_t num_buckets = 0;
+    uint32_t num_threads = 1;
+    void operator()(Bucket *table) const;
+  };
+  typedef std::unique_ptr<Bucket[], TableDeleter> Table;
+
+  /// @brief creates table which buckets share the allocator of the map. The maintenance threads construct
+  ///        the buckets, so the pages are touched in parallel too
+  Table NewTable(uint64_t num_buckets) const;
 
   double LoadFactor() const;
 
-  uint64_t Hash(const KeyType &key) const;
+  /// @brief adds delta to the size of the primary table
+  /// @return true once per load_check_mask_ + 1 changes of the counter cell of the thread: then the caller samples
+  ///         the load factor, so the sum of the cells is not read on every insertion
+  bool UpdatePrimarySize(int64_t delta);
+
+  /// @brief picks the sampling step of the load factor for the primary table. Every cell may run past the threshold
+  ///        by less than one step, so all of them together overshoot it by 1/8 at most
+  void UpdateLoadCheckStep();
+
+  /// @return true if the old table is empty. Requires shared lock in resizing state
+  bool PrimaryDrained() const;
+
+  /// @return hash of the key after the mixing step of the IndexPolicy. The buckets get this value
+  template <typename K>
+  uint64_t Hash(const K &key) const;
+
+  /// @brief implementations of the public overloads for KeyType and for the transparent key types
+  template <typename K>
+  std::pair<bool, ValueType> LookupImpl(const K &key) const;
+  template <typename K>
+  bool RemoveImpl(const K &key);
+  template <typename K, typename Visitor>
+  bool VisitImpl(const K &key, Visitor &visitor) const;
+  /// @brief calls probe(Bucket &) on the bucket of the hash in the old table, then in the new one, until it returns
+  ///        true. Takes no state lock: the tables of the view are read under an epoch guard, and a miss is retried
+  ///        with the next view if the tables were replaced meanwhile, since the element may have moved on
+  /// @return true if probe returned true
+  template <typename Probe>
+  bool ProbeTables(uint64_t hash, Probe &probe) const;
   /// @brief Computes index of the bucket for the primary table
-  uint64_t PrimaryIndex(const KeyType &key) const;
+  uint64_t PrimaryIndex(uint64_t hash) const;
   /// @brief Computes index of the bucket for the secondary table
-  uint64_t SecondaryIndex(const KeyType &key) const;
+  uint64_t SecondaryIndex(uint64_t hash) const;
+
+  /// @brief hashes the keys, prefetches their buckets and sorts the batch by bucket keeping the order of the keys
+  ///        within a bucket. Requires shared lock
+  /// @param secondary groups by the buckets of the secondary table instead of the primary one
+  /// @return scratch buffer of the thread, valid until the next call
+  std::vector<internals::BatchItem> &GroupByBucket(const KeyType *keys, uint64_t count, bool secondary) const;
+
+  /// @return the smallest bucket count which keeps num_elements at kMaxLoadFactor
+  static uint64_t BucketsFor(uint64_t num_elements);
+
+  /// @brief fills the empty primary table of a map under construction: sizes it for count elements, then hashes,
+  ///        partitions and inserts the elements with the maintenance threads
+  void BulkLoad(const KeyType *keys, const ValueType *values, uint64_t count);
 
-  /// @brief creates secondary table, switches state to 'resizing'. New elements go into secondary table only
-  void ResizingBegin();
+  /// @brief calls operation(first_item, num_items) for every bucket of the grouped batch
+  template <typename Operation>
+  static void ForEachBucket(const std::vector<internals::BatchItem> &items, Operation operation);
 
-  /// @brief swaps primary and secondary table, removes secondary empty table, switches state
+  /// @brief runs operation(bucket, hash) on the bucket which owns the key and counts the new element.
+  ///        While resizing the old bucket of the key is drained first, so the element is modified in one table only
+  /// @param operation returns true if it inserted new element
+  template <typename Operation>
+  bool UpdateBucket(const KeyType &key, Operation operation);
+
+  /// @return true if the table is sparse enough to shrink. Requires shared lock
+  bool ShrinkingWanted() const;
+
+  /// @brief creates secondary table, switches state to 'resizing'. New elements go into secondary table only.
+  ///        The table is allocated before taking the exclusive lock
+  /// @param num_buckets size of the new table, zero means it is chosen by the load factor (grow or shrink)
+  void ResizingBegin(uint64_t num_buckets = 0);
+
+  /// @brief helps the current resizing until the tables are switched
+  void FinishResizing();
+
+  /// @brief swaps primary and secondary table, removes secondary empty table, switches state.
+  ///        The old table is destroyed after releasing the exclusive lock
   void ResizingDone();
 
-  /// @breif called on each insert/remove it moves sqrt(number of buckets in primary table) element to new table
-  void ContinuousMoving();
+  /// @brief Moves at least the given amount of elements to new table, unless every bucket is already claimed.
+  ///        The helper claims ranges of transfer_stride_ buckets from the shared cursor and drains them all,
+  ///        so concurrent helpers never meet on the same old bucket. Requires shared lock in resizing state
+  /// @return true if the helper claimed at least one range, then it has to check if the old table is drained
+  bool ContinuousMoving(uint64_t num_elements);
+
+  /// @brief moves all of the elements of the old bucket to the new table. Requires shared lock in resizing state
+  /// @return number of elements moved
+  uint64_t DrainBucket(Bucket &bucket);
 
+  /// @brief counts the calling thread as a helper of the current resizing once
+  void RegisterHelper();
 
+  /// @return true if the caller of Insert/Remove has to migrate elements itself. Requires shared lock
+  bool CallerHelpsResizing() const;
+
+  /// @brief wakes the background resizer up, if any
+  void NotifyResizer();
+
+  /// @brief main loop of the background resizer thread
+  void BackgroundResizing();
+
+  /// @brief position of a traversal which lets the resizings go on: see ForEach
+  class ScanCursor;
+
+  /// @brief tables the lookups read, replaced as a whole on every change of the tables or of the state
+  struct TableView {
+    Bucket *primary;
+    uint64_t num_primary;
+    Bucket *secondary; ///< nullptr in the normal state
+    uint64_t num_secondary;
+  };
+
+  /// @brief publishes the current tables to the lookups and retires the previous view.
+  ///        Requires exclusive lock, or a map nobody else uses yet
+  void PublishTables();
+
+  /// @brief replaced view or table which the lookups that have loaded it may still read
+  struct RetiredTable {
+    std::unique_ptr<TableView> view;
+    Table table;
+    uint64_t epoch; ///< see internals::EpochDomain::RetireEpoch
+  };
+
+  /// @brief keeps a replaced view or table in the list of the map until no lookup may read it
+  void Retire(std::unique_ptr<TableView> view, Table table);
+  /// @brief retires a replaced table and frees the unreachable ones at once
+  void RetireTable(Table table);
+  /// @brief frees the retired views and tables which no lookup can read anymore. The writers and ResizingBegin call
+  ///        it, so a table kept for a pinned lookup is freed by the next of them after that lookup left
+  void CollectRetired();
+
+
+  NodeAllocator node_allocator_; ///< the buckets keep copies of it, so it goes before the tables
+  std::atomic<uint32_t> maintenance_threads_{1}; ///< see SetMaintenanceThreads, NewTable reads it in the ctor
   uint64_t num_buckets_primary_;
   uint64_t num_buckets_secondary_ = 0;
-  std::unique_ptr<Bucket[]> primary_table_;
-  std::unique_ptr<Bucket[]> secondary_table_ = nullptr;
-  std::atomic_ullong primary_size_;
-  std::atomic_ullong secondary_size_;
-  std::function<uint32_t(KeyType)> hash_ = std::hash<KeyType>();
+  uint64_t min_num_buckets_; ///< initial size, the map never shrinks below it on its own
+  std::atomic<double> min_load_factor_{0.0};
+  Table primary_table_;
+  Table secondary_table_;
+  internals::ShardedCounter primary_size_;
+  internals::ShardedCounter secondary_size_;
+  uint64_t load_check_mask_ = 0; ///< the load factor is sampled when a counter cell crosses a multiple of mask + 1
 
   State state_ = State::kNormal;
   uint64_t batch_elements_to_move_ = 1; ///< amount of element to move at one step of incremental resizing
-  mutable std::shared_timed_mutex stateupdate_mutex_; ///< blocks only on changing state (Resizing begin/end)
+  uint64_t transfer_stride_ = kMinTransferStride; ///< size of the bucket ranges claimed by the helpers
+  std::atomic<uint64_t> transfer_cursor_{0}; ///< first old bucket which is not claimed yet
+
+  uint64_t resize_id_ = 0; ///< unique among all of the maps, tells the helpers of different resizings apart
+  std::chrono::steady_clock::time_point resize_start_;
+  std::chrono::system_clock::time_point resize_start_time_;
+  std::atomic<uint64_t> resize_buckets_moved_{0};
+  std::atomic<uint64_t> resize_elements_moved_{0};
+  std::atomic<uint64_t> resize_ranges_claimed_{0};
+  std::atomic<uint64_t> resize_helpers_{0};
+  ResizeStats last_resize_stats_;
+  std::atomic<TableView *> table_view_{nullptr}; ///< see PublishTables
+  std::atomic<uint64_t> num_retired_{0}; ///< size of retired_, the writers read it without the lock
+  std::mutex retired_mutex_;
+  std::vector<RetiredTable> retired_;
+  mutable StateMutex stateupdate_mutex_; ///< blocks writers only on changing state (Resizing begin/end), not lookups
+  std::atomic<uint64_t> moved_per_call_[kStatsHistogramSlots] = {}; ///< counted in the statistics mode only
+  std::atomic<bool> resize_preparing_{false}; ///< a thread allocates the new table in ResizingBegin
+  std::atomic<uint64_t> sweep_cursor_{0}; ///< next bucket of RemoveIf, taken modulo the bucket count
+
+  std::atomic<bool> background_resizing_{false};
+  std::thread resizer_thread_;
+  std::mutex resizer_mutex_; ///< guards the fields below and the start/stop of the resizer
+  std::condition_variable resizer_cv_;
+  bool resizer_stop_ = false;
+  bool resizer_has_work_ = false;
+  uint64_t resizer_batch_ = kDefaultResizerBatch;
+  std::chrono::microseconds resizer_pause_{0};
 };
 
-template <typename KeyType, typename ValueType>
-ThreadsafeHashmap<KeyType, ValueType>::ThreadsafeHashmap(const ThreadsafeHashmap &rhs) {
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::ThreadsafeHashmap(
+    const ThreadsafeHashmap &rhs)
+    : HasherHolder(rhs), KeyEqualHolder(rhs), node_allocator_(rhs.node_allocator_) {
   *this = rhs;
 }
 
-template <typename KeyType, typename ValueType>
-ThreadsafeHashmap<KeyType, ValueType>::ThreadsafeHashmap(ThreadsafeHashmap &&rhs) {
-  *this = std::forward(rhs);
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::ThreadsafeHashmap(
+    ThreadsafeHashmap &&rhs)
+    : HasherHolder(rhs), KeyEqualHolder(rhs), node_allocator_(rhs.node_allocator_) {
+  *this = std::move(rhs);
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::~ThreadsafeHashmap() {
+  StopBackgroundResizing();
+  delete table_view_.load(std::memory_order_relaxed);
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::ThreadsafeHashmap(
+    uint64_t num_buckets, const Hasher &hasher, const KeyEqual &key_equal, const NodeAllocator &allocator)
+    : HasherHolder(hasher), KeyEqualHolder(key_equal),
+      node_allocator_(allocator),
+      num_buckets_primary_(IndexPolicy::BucketCount(num_buckets)),
+      min_num_buckets_(num_buckets_primary_),
+      primary_table_(NewTable(num_buckets_primary_)) {
+  UpdateLoadCheckStep();
+  PublishTables();
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+template <typename InputIt, typename>
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::ThreadsafeHashmap(
+    InputIt first, InputIt last, uint32_t num_threads, const Hasher &hasher, const KeyEqual &key_equal,
+    const NodeAllocator &allocator)
+    : ThreadsafeHashmap(1, hasher, key_equal, allocator) {
+  SetMaintenanceThreads(num_threads);
+  std::vector<KeyType> keys;
+  std::vector<ValueType> values;
+  typedef typename std::iterator_traits<InputIt>::iterator_category Category;
+  if constexpr (std::is_base_of<std::random_access_iterator_tag, Category>::value) {
+    const uint64_t kCount = static_cast<uint64_t>(std::distance(first, last));
+    keys.resize(kCount);
+    values.resize(kCount);
+    internals::ParallelFor(kCount, maintenance_threads_, kMinElementsPerWorker, [&](uint64_t begin, uint64_t end) {
+      for (uint64_t i = begin; i < end; i++) {
+        keys[i] = (*(first + i)).first;
+        values[i] = (*(first + i)).second;
+      }
+    });
+  } else {
+    for (; first != last; ++first) {
+      keys.push_back((*first).first);
+      values.push_back((*first).second);
+    }
+  }
+  BulkLoad(keys.data(), values.data(), keys.size());
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::ThreadsafeHashmap(
+    const std::vector<std::pair<KeyType, ValueType>> &elements, uint32_t num_threads, const Hasher &hasher,
+    const KeyEqual &key_equal, const NodeAllocator &allocator)
+    : ThreadsafeHashmap(elements.begin(), elements.end(), num_threads, hasher, key_equal, allocator) { }
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+void ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::TableDeleter::
+operator()(Bucket *table) const {
+  internals::ParallelFor(num_buckets, num_threads, kMinBucketsPerWorker, [table](uint64_t begin, uint64_t end) {
+    for (uint64_t i = begin; i < end; i++)
+      table[i].~Bucket();
+  });
+  ::operator delete(table);
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+typename ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::Table
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::NewTable(
+    uint64_t num_buckets) const {
+  const uint32_t kNumThreads = maintenance_threads_.load(std::memory_order_relaxed);
+  auto table = static_cast<Bucket *>(::operator new(num_buckets * sizeof(Bucket)));
+  internals::ParallelFor(num_buckets, kNumThreads, kMinBucketsPerWorker, [this, table](uint64_t begin, uint64_t end) {
+    for (uint64_t i = begin; i < end; i++)
+      new (&table[i]) Bucket(node_allocator_, KeyEqualHolder::Policy());
+  });
+  return Table(table, TableDeleter{num_buckets, kNumThreads});
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+void
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::PublishTables() {
+  const bool kIsResizing = state_ == State::kResizing;
+  auto view = new TableView{primary_table_.get(), num_buckets_primary_,
+                            kIsResizing? secondary_table_.get() : nullptr, kIsResizing? num_buckets_secondary_ : 0};
+  std::unique_ptr<TableView> old_view(table_view_.exchange(view, std::memory_order_acq_rel));
+  if (old_view)
+    Retire(std::move(old_view), Table());
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+void ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::Retire(
+    std::unique_ptr<TableView> view, Table table) {
+  const uint64_t kEpoch = internals::EpochDomain::Instance().RetireEpoch();
+  std::lock_guard<std::mutex> lock(retired_mutex_);
+  retired_.push_back({std::move(view), std::move(table), kEpoch});
+  num_retired_.store(retired_.size(), std::memory_order_relaxed);
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+void ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::RetireTable(
+    Table table) {
+  if (table)
+    Retire(nullptr, std::move(table));
+  CollectRetired(); // usually no lookup is left in the old table, so its memory is given back at once
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+void ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::
+CollectRetired() {
+  if (0 == num_retired_.load(std::memory_order_relaxed))
+    return;
+  std::vector<RetiredTable> unreachable; // declared first, so the tables are destroyed after the lock is released
+  std::unique_lock<std::mutex> lock(retired_mutex_, std::try_to_lock);
+  if (!lock.owns_lock())
+    return; // another thread collects them
+  const uint64_t kMinEpoch = internals::EpochDomain::Instance().Advance();
+  auto reachable_end = std::partition(retired_.begin(), retired_.end(),
+                                      [kMinEpoch](const RetiredTable &retired) { return retired.epoch >= kMinEpoch; });
+  std::move(reachable_end, retired_.end(), std::back_inserter(unreachable));
+  retired_.erase(reachable_end, retired_.end());
+  num_retired_.store(retired_.size(), std::memory_order_relaxed);
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+const NodeAllocator &
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::GetAllocator() const {
+  return node_allocator_;
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+const Hasher &
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::GetHasher() const {
+  return HasherHolder::Policy();
 }
 
-template <typename KeyType, typename ValueType>
-ThreadsafeHashmap<KeyType, ValueType>::ThreadsafeHashmap(uint64_t num_buckets, std::function<uint64_t(KeyType)> hasher)
-    : num_buckets_primary_(num_buckets),
-      primary_table_(new Bucket[num_buckets]),
-      primary_size_(0), secondary_size_(0),
-      hash_(hasher) { }
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+const KeyEqual &
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::GetKeyEqual() const {
+  return KeyEqualHolder::Policy();
+}
 
-template <typename KeyType, typename ValueType>
-ThreadsafeHashmap<KeyType, ValueType> &ThreadsafeHashmap<KeyType, ValueType>::operator=(ThreadsafeHashmap &&rhs) {
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy> &
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::operator=(
+    ThreadsafeHashmap &&rhs) {
+  rhs.StopBackgroundResizing();
+  // the helpers of rhs claim their ranges under the shared lock, so the cursor is not moving here
+  std::lock_guard<StateMutex> lock(rhs.stateupdate_mutex_);
+  // the buckets relink the nodes between the tables, so all of them allocate from the arena of rhs
+  node_allocator_ = rhs.node_allocator_;
+  maintenance_threads_ = rhs.maintenance_threads_.load(std::memory_order_relaxed);
   num_buckets_primary_ = rhs.num_buckets_primary_;
   num_buckets_secondary_ = rhs.num_buckets_secondary_;
+  min_num_buckets_ = rhs.min_num_buckets_;
+  min_load_factor_ = rhs.min_load_factor_.load(std::memory_order_relaxed);
   primary_table_ = std::move(rhs.primary_table_);
   secondary_table_ = std::move(rhs.secondary_table_);
-  primary_size_, rhs.primary_size_.load(std::memory_order_acquire);
-  secondary_size_ = rhs.secondary_size_.load(std::memory_order_acquire);
-  hash_ = std::move(rhs.hash_);
+  primary_size_.Store(rhs.primary_size_.Load());
+  secondary_size_.Store(rhs.secondary_size_.Load());
+  load_check_mask_ = rhs.load_check_mask_;
+  HasherHolder::Policy() = std::move(rhs.HasherHolder::Policy());
+  KeyEqualHolder::Policy() = std::move(rhs.KeyEqualHolder::Policy());
   state_ = rhs.state_;
   batch_elements_to_move_ = rhs.batch_elements_to_move_;
-  stateupdate_mutex_ = std::move(rhs.stateupdate_mutex_);
+  transfer_stride_ = rhs.transfer_stride_;
+  transfer_cursor_ = rhs.transfer_cursor_.load(std::memory_order_relaxed);
+  resize_id_ = rhs.resize_id_;
+  resize_start_ = rhs.resize_start_;
+  resize_start_time_ = rhs.resize_start_time_;
+  resize_buckets_moved_ = rhs.resize_buckets_moved_.load(std::memory_order_relaxed);
+  resize_elements_moved_ = rhs.resize_elements_moved_.load(std::memory_order_relaxed);
+  resize_ranges_claimed_ = rhs.resize_ranges_claimed_.load(std::memory_order_relaxed);
+  resize_helpers_ = rhs.resize_helpers_.load(std::memory_order_relaxed);
+  last_resize_stats_ = rhs.last_resize_stats_;
+  PublishTables();
   return *this;
 }
 
-template <typename KeyType, typename ValueType>
-ThreadsafeHashmap<KeyType, ValueType> &ThreadsafeHashmap<KeyType, ValueType>::operator=(const ThreadsafeHashmap &rhs) {
-  std::lock_guard<std::shared_timed_mutex>(rhs.stateupdate_mutex_);
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy> &
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::operator=(
+    const ThreadsafeHashmap &rhs) {
+  if (this == &rhs)
+    return *this;
+  std::lock_guard<StateMutex> lock(rhs.stateupdate_mutex_);
+  // the buckets relink the nodes between the tables, so all of them allocate from the arena of rhs
+  node_allocator_ = rhs.node_allocator_;
+  maintenance_threads_ = rhs.maintenance_threads_.load(std::memory_order_relaxed);
   num_buckets_primary_ = rhs.num_buckets_primary_;
   num_buckets_secondary_ = rhs.num_buckets_secondary_;
-  primary_table_.reset(new Bucket[num_buckets_primary_]);
-  secondary_table_.reset(new Bucket[num_buckets_secondary_]);
-  primary_size_ = rhs.primary_size_.load(std::memory_order_acquire);
-  secondary_size_ = rhs.secondary_size_.load(std::memory_order_acquire);
-  hash_ = rhs.hash_;
+  min_num_buckets_ = rhs.min_num_buckets_;
+  min_load_factor_ = rhs.min_load_factor_.load(std::memory_order_relaxed);
+  primary_table_ = NewTable(num_buckets_primary_);
+  secondary_table_ = NewTable(num_buckets_secondary_);
+  primary_size_.Store(rhs.primary_size_.Load());
+  secondary_size_.Store(rhs.secondary_size_.Load());
+  load_check_mask_ = rhs.load_check_mask_;
+  HasherHolder::Policy() = rhs.HasherHolder::Policy();
+  KeyEqualHolder::Policy() = rhs.KeyEqualHolder::Policy();
   state_ = rhs.state_;
   batch_elements_to_move_ = rhs.batch_elements_to_move_;
+  transfer_stride_ = rhs.transfer_stride_;
+  transfer_cursor_ = 0; // migrated buckets of the copy are empty, so they are just skipped
 
-  for (uint64_t i = 0; i < rhs.num_buckets_primary_; i++) {
-    primary_table_[i] = rhs.primary_table_[i];
-  }
-  for (uint64_t i = 0; i < rhs.num_buckets_secondary_; i++) {
-    secondary_table_[i] = rhs.secondary_table_[i];
-  }
+  // the buckets are independent, so every thread copies its own range with no coordination
+  auto copy_range = [](Bucket *destination, const Bucket *source) {
+    return [destination, source](uint64_t begin, uint64_t end) {
+      for (uint64_t i = begin; i < end; i++)
+        destination[i] = source[i];
+    };
+  };
+  const uint32_t kNumThreads = maintenance_threads_.load(std::memory_order_relaxed);
+  internals::ParallelFor(num_buckets_primary_, kNumThreads, kMinBucketsPerWorker,
+                         copy_range(primary_table_.get(), rhs.primary_table_.get()));
+  internals::ParallelFor(num_buckets_secondary_, kNumThreads, kMinBucketsPerWorker,
+                         copy_range(secondary_table_.get(), rhs.secondary_table_.get()));
+  PublishTables();
   return *this;
 }
 
-template <typename KeyType, typename ValueType>
-double ThreadsafeHashmap<KeyType, ValueType>::LoadFactor() const {
-  return primary_size_.load(std::memory_order_acquire) / double(num_buckets_primary_);
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+double
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::LoadFactor() const {
+  return primary_size_.Load() / double(num_buckets_primary_ * Bucket::kSlotsPerBucket);
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+bool ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::
+UpdatePrimarySize(int64_t delta) {
+  const uint64_t kNewCell = primary_size_.Add(delta);
+  const uint64_t kOldCell = kNewCell - static_cast<uint64_t>(delta);
+  return (kOldCell & ~load_check_mask_) != (kNewCell & ~load_check_mask_);
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+void ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::
+UpdateLoadCheckStep() {
+  const uint64_t kThreshold = static_cast<uint64_t> (kMaxLoadFactor * num_buckets_primary_ * Bucket::kSlotsPerBucket);
+  uint64_t step = 1;
+  while (2 * step * internals::ShardedCounter::kNumShards * 8 <= kThreshold)
+    step *= 2;
+  load_check_mask_ = step - 1;
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+bool ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::
+PrimaryDrained() const {
+  return 0 == primary_size_.Load();
 }
 
-template <typename KeyType, typename ValueType>
-uint64_t ThreadsafeHashmap<KeyType, ValueType>::Hash(const KeyType &key) const {
-  uint64_t hash = hash_(key);
-  return hash ^ (hash >> 32);
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+template <typename K>
+uint64_t
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::Hash(
+    const K &key) const {
+  return IndexPolicy::Mix(HasherHolder::Policy()(key));
 }
 
-template <typename KeyType, typename ValueType>
-uint64_t ThreadsafeHashmap<KeyType, ValueType>::PrimaryIndex(const KeyType &key) const {
-  return Hash(key) % num_buckets_primary_;
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+uint64_t
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::PrimaryIndex(
+    uint64_t hash) const {
+  return IndexPolicy::Index(hash, num_buckets_primary_);
 }
 
-template <typename KeyType, typename ValueType>
-uint64_t ThreadsafeHashmap<KeyType, ValueType>::SecondaryIndex(const KeyType &key) const {
-  return Hash(key) % num_buckets_secondary_;
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+uint64_t
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::SecondaryIndex(
+    uint64_t hash) const {
+  return IndexPolicy::Index(hash, num_buckets_secondary_);
 }
 
-template <typename KeyType, typename ValueType>
-uint64_t ThreadsafeHashmap<KeyType, ValueType>::Size() const {
-  return primary_size_.load(std::memory_order_acquire) + secondary_size_.load(std::memory_order_acquire);
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+uint64_t ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::Size() const {
+  return primary_size_.Load() + secondary_size_.Load();
 }
 
-template <typename KeyType, typename ValueType>
-bool ThreadsafeHashmap<KeyType, ValueType>::Empty() const {
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+uint64_t
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::SizeExact() const {
+  // every writer updates the counters under the shared lock
+  std::lock_guard<StateMutex> lock(stateupdate_mutex_);
+  return primary_size_.Load() + secondary_size_.Load();
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+bool ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::Empty() const {
   return 0 == Size();
 }
 
-template <typename KeyType, typename ValueType>
-void ThreadsafeHashmap<KeyType, ValueType>::Insert(const KeyType &key, const ValueType &value) {
-  std::shared_lock<std::shared_timed_mutex> lock(stateupdate_mutex_);
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+void
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::Insert(
+    const KeyType &key, const ValueType &value) {
+  InsertOrAssign(key, value);
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+void
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::Insert(
+    KeyType &&key, ValueType &&value) {
+  InsertOrAssign(std::move(key), std::move(value));
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+std::pair<bool, ValueType>
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::Lookup(
+    const KeyType &key) const {
+  return LookupImpl(key);
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+template <typename K, typename>
+std::pair<bool, ValueType>
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::Lookup(
+    const K &key) const {
+  return LookupImpl(key);
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+template <typename K>
+std::pair<bool, ValueType>
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::LookupImpl(
+    const K &key) const {
+  const uint64_t kHash = Hash(key);
+  std::pair<bool, ValueType> result(false, ValueType());
+  auto probe = [&result, kHash, &key](Bucket &bucket) {
+    result = bucket.Lookup(kHash, key);
+    return result.first;
+  };
+  ProbeTables(kHash, probe);
+  return result;
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+bool
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::Remove(
+    const KeyType &key) {
+  return RemoveImpl(key);
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+template <typename K, typename>
+bool
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::Remove(
+    const K &key) {
+  return RemoveImpl(key);
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+template <typename K>
+bool
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::RemoveImpl(
+    const K &key) {
+  CollectRetired();
+  std::shared_lock<StateMutex> lock(stateupdate_mutex_);
+  const uint64_t kHash = Hash(key);
+  bool was_removed = primary_table_[PrimaryIndex(kHash)].Remove(kHash, key);
 
   if (state_ == State::kNormal) {
-    if (primary_table_[PrimaryIndex(key)].Insert(key, value))
-      primary_size_++;
-    if (LoadFactor() > kMaxLoadFactor) {
+    if (was_removed && UpdatePrimarySize(-1) && ShrinkingWanted()) {
       lock.unlock();
       ResizingBegin();
     }
-  } else {
-    if (primary_table_[PrimaryIndex(key)].Remove(key))
-      primary_size_--;
-    if (secondary_table_[SecondaryIndex(key)].Insert(key, value))
-      secondary_size_++;
-    ContinuousMoving();
-    if (0 == primary_size_.load(std::memory_order_acquire)) {
+    return was_removed;
+  }
+
+  // only a thread which took something out of the old table may be the one to see it drained
+  bool may_be_drained = was_removed;
+  if (was_removed)
+    primary_size_.Add(-1);
+  else if ((was_removed = secondary_table_[SecondaryIndex(kHash)].Remove(kHash, key)))
+    secondary_size_.Add(-1);
+  if (CallerHelpsResizing())
+    may_be_drained |= ContinuousMoving(batch_elements_to_move_);
+  if (may_be_drained && PrimaryDrained()) {
+    lock.unlock();
+    ResizingDone();
+  }
+  return was_removed;
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+template <typename Predicate>
+uint64_t ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::RemoveIf(
+    Predicate predicate, uint64_t max_buckets) {
+  CollectRetired();
+  std::shared_lock<StateMutex> lock(stateupdate_mutex_);
+  // while resizing both tables are swept at the same indices, modulo the larger one: a shrink leaves no old bucket
+  // behind, a growth no new one
+  const bool kIsResizing = state_ == State::kResizing;
+  const uint64_t kNumBuckets = kIsResizing? std::max(num_buckets_primary_, num_buckets_secondary_)
+                                          : num_buckets_primary_;
+  const uint64_t kNumSwept = std::min(max_buckets, kNumBuckets);
+  const uint64_t kBegin = sweep_cursor_.fetch_add(kNumSwept, std::memory_order_relaxed);
+  uint64_t num_removed_primary = 0;
+  uint64_t num_removed_secondary = 0;
+  for (uint64_t i = kBegin; i < kBegin + kNumSwept; i++) {
+    const uint64_t kIndex = i % kNumBuckets;
+    if (kIsResizing && kIndex < num_buckets_secondary_)
+      num_removed_secondary += secondary_table_[kIndex].RemoveIf(predicate);
+    if (kIndex < num_buckets_primary_)
+      num_removed_primary += primary_table_[kIndex].RemoveIf(predicate);
+  }
+
+  if (!kIsResizing) {
+    if (num_removed_primary > 0 && UpdatePrimarySize(-static_cast<int64_t>(num_removed_primary))
+        && ShrinkingWanted()) {
       lock.unlock();
-      ResizingDone();
+      ResizingBegin();
     }
+    return num_removed_primary;
+  }
+  primary_size_.Add(-static_cast<int64_t>(num_removed_primary));
+  secondary_size_.Add(-static_cast<int64_t>(num_removed_secondary));
+  if (num_removed_primary > 0 && PrimaryDrained()) {
+    lock.unlock();
+    ResizingDone();
   }
+  return num_removed_primary + num_removed_secondary;
 }
 
-template <typename KeyType, typename ValueType>
-std::pair<bool, ValueType> ThreadsafeHashmap<KeyType, ValueType>::Lookup(const KeyType &key) const {
-  std::shared_lock<std::shared_timed_mutex> lock(stateupdate_mutex_);
-  auto result = primary_table_[PrimaryIndex(key)].Lookup(key);
-  if (state_ == State::kResizing && !result.first) {
-    result = secondary_table_[SecondaryIndex(key)].Lookup(key);
-  }
-  return result;
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+template <typename Visitor>
+bool ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::Visit(
+    const KeyType &key, Visitor visitor) const {
+  return VisitImpl(key, visitor);
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+template <typename K, typename Visitor, typename>
+bool ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::Visit(
+    const K &key, Visitor visitor) const {
+  return VisitImpl(key, visitor);
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+template <typename K, typename Visitor>
+bool ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::VisitImpl(
+    const K &key, Visitor &visitor) const {
+  const uint64_t kHash = Hash(key);
+  auto probe = [kHash, &key, &visitor](Bucket &bucket) { return bucket.Visit(kHash, key, visitor); };
+  return ProbeTables(kHash, probe);
 }
 
-template <typename KeyType, typename ValueType>
-bool ThreadsafeHashmap<KeyType, ValueType>::Remove(const KeyType &key) {
-  std::shared_lock<std::shared_timed_mutex> lock(stateupdate_mutex_);
-  bool was_removed = primary_table_[PrimaryIndex(key)].Remove(key);
-  if (was_removed) {
-    primary_size_--;
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+template <typename Probe>
+bool ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::ProbeTables(
+    uint64_t hash, Probe &probe) const {
+  internals::EpochGuard guard; // a replaced view and its tables live until the lookups which have loaded them leave
+  const TableView *view = table_view_.load(std::memory_order_acquire);
+  while (true) {
+    // elements only move from the old table to the new one, so a miss in the old table can't skip the element
+    if (probe(view->primary[IndexPolicy::Index(hash, view->num_primary)]))
+      return kOperationSuccess;
+    if (view->secondary != nullptr && probe(view->secondary[IndexPolicy::Index(hash, view->num_secondary)]))
+      return kOperationSuccess;
+    // a resizing which began or finished meanwhile may have moved the element into a table this view lacks
+    const TableView *current = table_view_.load(std::memory_order_acquire);
+    if (current == view)
+      return kOperationFailed;
+    view = current;
   }
+}
 
-  if (state_ == State::kNormal)
-    return was_removed;
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+template <typename Operation>
+bool ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::UpdateBucket(
+    const KeyType &key, Operation operation) {
+  CollectRetired();
+  std::shared_lock<StateMutex> lock(stateupdate_mutex_);
+  const uint64_t kHash = Hash(key);
+  bool is_created = false;
 
-  if (!was_removed) { // we should also try to remove from the second table
-    if ((was_removed = secondary_table_[SecondaryIndex(key)].Remove(key)))
-      secondary_size_--;
+  if (state_ == State::kNormal) {
+    is_created = operation(primary_table_[PrimaryIndex(kHash)], kHash);
+    if (is_created && UpdatePrimarySize(1) && LoadFactor() > kMaxLoadFactor) {
+      lock.unlock();
+      ResizingBegin();
+    }
+    return is_created;
   }
-  ContinuousMoving();
-  if (0 == primary_size_.load(std::memory_order_acquire)) {
+
+  // nothing goes into an old bucket, so a key missing there goes straight to the new table. An old value must be
+  // updated in place, so only then the whole old bucket goes to the new table first
+  auto &old_bucket = primary_table_[PrimaryIndex(kHash)];
+  bool may_be_drained = !old_bucket.Empty() && old_bucket.Visit(kHash, key, [](const ValueType &) {}) &&
+                        DrainBucket(old_bucket) > 0;
+  if ((is_created = operation(secondary_table_[SecondaryIndex(kHash)], kHash)))
+    secondary_size_.Add(1);
+  if (CallerHelpsResizing())
+    may_be_drained |= ContinuousMoving(batch_elements_to_move_);
+  if (may_be_drained && PrimaryDrained()) {
     lock.unlock();
     ResizingDone();
   }
-  return was_removed;
+  return is_created;
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+template <typename Updater, typename Creator>
+bool ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::Upsert(
+    const KeyType &key, Updater update, Creator create) {
+  return UpdateBucket(key, [&](Bucket &bucket, uint64_t hash) { return bucket.Upsert(hash, key, update, create); });
 }
 
-template <typename KeyType, typename ValueType>
-void ThreadsafeHashmap<KeyType, ValueType>::Clear() {
-  std::lock_guard<std::shared_timed_mutex> lock(stateupdate_mutex_);
-  for (uint64_t i = 0; i < num_buckets_primary_; i++)
-    primary_table_[i].Clear();
-  primary_size_ = 0;
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+template <typename K, typename... Args>
+bool ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::TryEmplace(
+    K &&key, Args &&... args) {
+  static_assert(std::is_same<typename std::decay<K>::type, KeyType>::value, "the key must be a KeyType");
+  return UpdateBucket(key, [&](Bucket &bucket, uint64_t hash) {
+    return bucket.EmplaceOrUpdate(hash, std::forward<K>(key), internals::KeepValue(), std::forward<Args>(args)...);
+  });
+}
 
-  if (state_ == State::kResizing) {
-    for (uint64_t i = 0; i < num_buckets_secondary_; i++)
-      secondary_table_[i].Clear();
-    secondary_size_ = 0;
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+template <typename K, typename V>
+bool ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::InsertOrAssign(
+    K &&key, V &&value) {
+  static_assert(std::is_same<typename std::decay<K>::type, KeyType>::value, "the key must be a KeyType");
+  return UpdateBucket(key, [&](Bucket &bucket, uint64_t hash) {
+    auto assign = [&value](ValueType &existing) { existing = std::forward<V>(value); };
+    return bucket.EmplaceOrUpdate(hash, std::forward<K>(key), assign, std::forward<V>(value));
+  });
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+template <typename K, typename... Args>
+bool ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::Emplace(
+    K &&key, Args &&... args) {
+  static_assert(std::is_same<typename std::decay<K>::type, KeyType>::value, "the key must be a KeyType");
+  return UpdateBucket(key, [&](Bucket &bucket, uint64_t hash) {
+    auto assign = [&](ValueType &existing) { existing = ValueType(std::forward<Args>(args)...); };
+    return bucket.EmplaceOrUpdate(hash, std::forward<K>(key), assign, std::forward<Args>(args)...);
+  });
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+template <typename Creator>
+bool ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::
+ComputeIfAbsent(const KeyType &key, Creator create) {
+  return Upsert(key, internals::KeepValue(), create);
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+std::vector<internals::BatchItem> &
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::GroupByBucket(
+    const KeyType *keys, uint64_t count, bool secondary) const {
+  const Table &table = secondary? secondary_table_ : primary_table_;
+  thread_local static std::vector<internals::BatchItem> items;
+  items.resize(count);
+  for (uint64_t i = 0; i < count; i++) {
+    const uint64_t kHash = Hash(keys[i]);
+    items[i] = {secondary? SecondaryIndex(kHash) : PrimaryIndex(kHash), kHash, i};
+    PREFETCH(&table[items[i].bucket]);
+  }
+  std::sort(items.begin(), items.end(), [](const internals::BatchItem &lhs, const internals::BatchItem &rhs) {
+    return lhs.bucket < rhs.bucket || (lhs.bucket == rhs.bucket && lhs.position < rhs.position);
+  });
+  return items;
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+template <typename Operation>
+void ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::ForEachBucket(
+    const std::vector<internals::BatchItem> &items, Operation operation) {
+  uint64_t group_begin = 0;
+  for (uint64_t i = 1; i <= items.size(); i++) {
+    if (i == items.size() || items[i].bucket != items[group_begin].bucket) {
+      operation(&items[group_begin], i - group_begin);
+      group_begin = i;
+    }
   }
 }
 
-template <typename KeyType, typename ValueType>
-void ThreadsafeHashmap<KeyType, ValueType>::ResizingBegin() {
-  std::lock_guard<std::shared_timed_mutex> lock(stateupdate_mutex_);
-  if (state_ != State::kNormal || LoadFactor() < kMaxLoadFactor)
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+void ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::InsertBatch(
+    const KeyType *keys, const ValueType *values, uint64_t count) {
+  if (0 == count)
+    return;
+  CollectRetired();
+  std::shared_lock<StateMutex> lock(stateupdate_mutex_);
+  if (state_ == State::kNormal) {
+    auto &items = GroupByBucket(keys, count, false);
+    uint64_t num_inserted = 0;
+    ForEachBucket(items, [&](const internals::BatchItem *group, uint64_t group_size) {
+      num_inserted += primary_table_[group->bucket].InsertBatch(group, group_size, keys, values);
+    });
+    if (num_inserted > 0 && UpdatePrimarySize(num_inserted) && LoadFactor() > kMaxLoadFactor) {
+      lock.unlock();
+      ResizingBegin();
+    }
     return;
+  }
 
-  num_buckets_secondary_ = static_cast<uint64_t> (num_buckets_primary_ * kIncreaseRate);
-  secondary_table_.reset(new Bucket[num_buckets_secondary_]);
-  secondary_size_ = 0;
-  batch_elements_to_move_ = static_cast<uint64_t> (std::sqrt(num_buckets_primary_));
-  state_ = State::kResizing;
+  // every key leaves the old table and goes to the new one
+  auto &items = GroupByBucket(keys, count, true);
+  uint64_t num_removed = 0;
+  for (auto &item : items)
+    if (primary_table_[PrimaryIndex(item.hash)].Remove(item.hash, keys[item.position]))
+      num_removed++;
+  primary_size_.Add(-static_cast<int64_t>(num_removed));
+  uint64_t num_inserted = 0;
+  ForEachBucket(items, [&](const internals::BatchItem *group, uint64_t group_size) {
+    num_inserted += secondary_table_[group->bucket].InsertBatch(group, group_size, keys, values);
+  });
+  secondary_size_.Add(num_inserted);
+  bool may_be_drained = num_removed > 0;
+  if (CallerHelpsResizing())
+    may_be_drained |= ContinuousMoving(batch_elements_to_move_ * count);
+  if (may_be_drained && PrimaryDrained()) {
+    lock.unlock();
+    ResizingDone();
+  }
 }
 
-template <typename KeyType, typename ValueType>
-void ThreadsafeHashmap<KeyType, ValueType>::ResizingDone() {
-  std::lock_guard<std::shared_timed_mutex> lock(stateupdate_mutex_);
-  if (state_ != State::kResizing || primary_size_.load(std::memory_order_acquire))
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+void ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::LookupBatch(
+    const KeyType *keys, uint64_t count, std::pair<bool, ValueType> *results) const {
+  if (0 == count)
     return;
+  std::shared_lock<StateMutex> lock(stateupdate_mutex_);
+  auto &items = GroupByBucket(keys, count, false);
+  ForEachBucket(items, [&](const internals::BatchItem *group, uint64_t group_size) {
+    primary_table_[group->bucket].LookupBatch(group, group_size, keys, results);
+  });
+  if (state_ == State::kResizing) {
+    for (auto &item : items)
+      if (!results[item.position].first)
+        results[item.position] = secondary_table_[SecondaryIndex(item.hash)].Lookup(item.hash, keys[item.position]);
+  }
+}
 
-  primary_table_.reset(secondary_table_.release()); // deletes old table and set secondary table ptr to nullptr
-  primary_size_ = secondary_size_.load(std::memory_order_acquire);
-  secondary_size_ = 0;
-  num_buckets_primary_ = num_buckets_secondary_;
-  num_buckets_secondary_ = 0;
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+void ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::Clear() {
+  // declared first, so the old elements are retired after the lock is released
+  Table old_primary;
+  Table old_secondary;
+  bool was_resizing = false;
+  for (bool is_swapped = false; !is_swapped; ) {
+    uint64_t num_primary = 0;
+    uint64_t num_secondary = 0;
+    {
+      std::shared_lock<StateMutex> lock(stateupdate_mutex_);
+      num_primary = num_buckets_primary_;
+      num_secondary = state_ == State::kResizing? num_buckets_secondary_ : 0;
+    }
+    Table primary = NewTable(num_primary);
+    Table secondary = num_secondary > 0? NewTable(num_secondary) : Table();
+
+    std::lock_guard<StateMutex> lock(stateupdate_mutex_);
+    was_resizing = state_ == State::kResizing;
+    if (num_primary != num_buckets_primary_ || num_secondary != (was_resizing? num_buckets_secondary_ : 0))
+      continue; // a resizing began or finished meanwhile
+    old_primary = std::move(primary_table_);
+    primary_table_ = std::move(primary);
+    primary_size_.Store(0);
+    if (was_resizing) {
+      old_secondary = std::move(secondary_table_);
+      secondary_table_ = std::move(secondary);
+      secondary_size_.Store(0);
+    }
+    PublishTables();
+    is_swapped = true;
+  }
+  RetireTable(std::move(old_primary));
+  RetireTable(std::move(old_secondary));
+  // the old table is drained now, but no helper may be left to notice it
+  if (was_resizing)
+    ResizingDone();
+}
 
-  state_ = State::kNormal;
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+void ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::
+SetMaintenanceThreads(uint32_t num_threads) {
+  std::lock_guard<StateMutex> lock(stateupdate_mutex_);
+  maintenance_threads_ = std::max(1u, num_threads);
+  primary_table_.get_deleter().num_threads = maintenance_threads_;
+  secondary_table_.get_deleter().num_threads = maintenance_threads_;
 }
 
-template <typename KeyType, typename ValueType>
-void ThreadsafeHashmap<KeyType, ValueType>::ContinuousMoving() {
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+void ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::ResizingBegin(
+    uint64_t num_buckets) {
+  CollectRetired(); // a pinned lookup may have kept the table of the previous resizing
+  bool expected = false;
+  if (!resize_preparing_.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+    return; // another thread is allocating the new table
+
+  {
+    std::shared_lock<StateMutex> lock(stateupdate_mutex_);
+    if (state_ != State::kNormal || num_buckets == num_buckets_primary_)
+      num_buckets = 0;
+    else if (0 == num_buckets && LoadFactor() >= kMaxLoadFactor)
+      num_buckets = IndexPolicy::BucketCount(static_cast<uint64_t> (num_buckets_primary_ * kIncreaseRate));
+    else if (0 == num_buckets && ShrinkingWanted())
+      num_buckets = std::max(min_num_buckets_,
+                             IndexPolicy::BucketCount(static_cast<uint64_t> (num_buckets_primary_ / kIncreaseRate)));
+  }
+
+  if (num_buckets > 0) {
+    auto table = NewTable(num_buckets);
+    {
+      // only the preparing thread leaves the normal state, so the primary table is still the same
+      std::lock_guard<StateMutex> lock(stateupdate_mutex_);
+      num_buckets_secondary_ = num_buckets;
+      secondary_table_ = std::move(table);
+      secondary_size_.Store(0);
+      batch_elements_to_move_ = static_cast<uint64_t> (std::sqrt(num_buckets_primary_ * Bucket::kSlotsPerBucket));
+      // a claimed range costs about as much as one step of the incremental resizing
+      transfer_stride_ = std::max(kMinTransferStride, batch_elements_to_move_ / Bucket::kSlotsPerBucket);
+      transfer_cursor_.store(0, std::memory_order_relaxed);
+
+      static std::atomic<uint64_t> next_resize_id(1);
+      resize_id_ = next_resize_id++;
+      resize_start_ = std::chrono::steady_clock::now();
+      resize_start_time_ = std::chrono::system_clock::now();
+      resize_buckets_moved_ = 0;
+      resize_elements_moved_ = 0;
+      resize_ranges_claimed_ = 0;
+      resize_helpers_ = 0;
+      state_ = State::kResizing;
+      PublishTables();
+    }
+    NotifyResizer();
+  }
+  resize_preparing_.store(false, std::memory_order_release);
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+void ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::ResizingDone() {
+  Table old_table;
+  {
+    std::lock_guard<StateMutex> lock(stateupdate_mutex_);
+    if (state_ != State::kResizing || !PrimaryDrained())
+      return;
+
+    last_resize_stats_.num_resizes++;
+    last_resize_stats_.old_num_buckets = num_buckets_primary_;
+    last_resize_stats_.new_num_buckets = num_buckets_secondary_;
+    last_resize_stats_.buckets_moved = resize_buckets_moved_.load(std::memory_order_relaxed);
+    last_resize_stats_.elements_moved = resize_elements_moved_.load(std::memory_order_relaxed);
+    last_resize_stats_.ranges_claimed = resize_ranges_claimed_.load(std::memory_order_relaxed);
+    last_resize_stats_.num_helpers = resize_helpers_.load(std::memory_order_relaxed);
+    last_resize_stats_.duration_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - resize_start_).count();
+    last_resize_stats_.start_time_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        resize_start_time_.time_since_epoch()).count();
+    last_resize_stats_.finish_time_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    old_table = std::move(primary_table_);
+    primary_table_ = std::move(secondary_table_);
+    primary_size_.Store(secondary_size_.Load());
+    secondary_size_.Store(0);
+    num_buckets_primary_ = num_buckets_secondary_;
+    num_buckets_secondary_ = 0;
+    UpdateLoadCheckStep();
+
+    state_ = State::kNormal;
+    PublishTables();
+  }
+  RetireTable(std::move(old_table));
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+bool ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::
+ShrinkingWanted() const {
+  const double kMinLoadFactor = min_load_factor_.load(std::memory_order_relaxed);
+  return kMinLoadFactor > 0 && num_buckets_primary_ > min_num_buckets_ && LoadFactor() < kMinLoadFactor;
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+uint64_t ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::
+BucketCount() const {
+  std::shared_lock<StateMutex> lock(stateupdate_mutex_);
+  return state_ == State::kResizing? num_buckets_secondary_ : num_buckets_primary_;
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+void ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::SetMinLoadFactor(
+    double min_load_factor) {
+  if (min_load_factor > kMaxMinLoadFactor) {
+    WARNING("min load factor " << min_load_factor << " is capped by " << kMaxMinLoadFactor);
+    min_load_factor = kMaxMinLoadFactor;
+  }
+  min_load_factor_.store(std::max(0.0, min_load_factor), std::memory_order_relaxed);
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+uint64_t ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::
+BucketsFor(uint64_t num_elements) {
+  return IndexPolicy::BucketCount(
+      static_cast<uint64_t> (std::ceil(num_elements / (kMaxLoadFactor * Bucket::kSlotsPerBucket))));
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+void ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::
+BulkLoad(const KeyType *keys, const ValueType *values, uint64_t count) {
+  const uint64_t kNumBuckets = BucketsFor(count);
+  if (kNumBuckets > num_buckets_primary_) {
+    // nobody else sees the map yet, the table is replaced without the lock
+    num_buckets_primary_ = kNumBuckets;
+    min_num_buckets_ = kNumBuckets;
+    primary_table_ = NewTable(kNumBuckets);
+    UpdateLoadCheckStep();
+    PublishTables();
+  }
+
+  const uint32_t kNumThreads = maintenance_threads_.load(std::memory_order_relaxed);
+  std::vector<internals::BatchItem> items(count);
+  internals::ParallelFor(count, kNumThreads, kMinElementsPerWorker, [&](uint64_t begin, uint64_t end) {
+    for (uint64_t i = begin; i < end; i++) {
+      const uint64_t kHash = Hash(keys[i]);
+      items[i] = {PrimaryIndex(kHash), kHash, i};
+    }
+  });
+
+  // part p owns a contiguous range of buckets, chunk c is a contiguous range of the items. Every chunk counts its
+  // items per part, then scatters them, so a part keeps the order of the keys
+  const uint64_t kNumParts = std::max<uint64_t>(1, std::min<uint64_t>(kNumThreads, count / kMinElementsPerWorker));
+  auto part_of = [this, kNumParts](uint64_t bucket) { return bucket * kNumParts / num_buckets_primary_; };
+  auto chunk_begin = [count, kNumParts](uint64_t chunk) { return count * chunk / kNumParts; };
+  std::vector<uint64_t> offsets(kNumParts * kNumParts, 0); // [chunk][part]
+  internals::ParallelFor(kNumParts, kNumParts, 1, [&](uint64_t begin, uint64_t end) {
+    for (uint64_t chunk = begin; chunk < end; chunk++)
+      for (uint64_t i = chunk_begin(chunk); i < chunk_begin(chunk + 1); i++)
+        offsets[chunk * kNumParts + part_of(items[i].bucket)]++;
+  });
+  std::vector<uint64_t> part_begin(kNumParts + 1, 0);
+  for (uint64_t part = 0; part < kNumParts; part++) {
+    part_begin[part + 1] = part_begin[part];
+    for (uint64_t chunk = 0; chunk < kNumParts; chunk++) {
+      const uint64_t kCount = offsets[chunk * kNumParts + part];
+      offsets[chunk * kNumParts + part] = part_begin[part + 1];
+      part_begin[part + 1] += kCount;
+    }
+  }
+  std::vector<internals::BatchItem> partitioned(count);
+  internals::ParallelFor(kNumParts, kNumParts, 1, [&](uint64_t begin, uint64_t end) {
+    for (uint64_t chunk = begin; chunk < end; chunk++)
+      for (uint64_t i = chunk_begin(chunk); i < chunk_begin(chunk + 1); i++)
+        partitioned[offsets[chunk * kNumParts + part_of(items[i].bucket)]++] = items[i];
+  });
+
+  std::vector<uint64_t> num_inserted(kNumParts, 0);
+  internals::ParallelFor(kNumParts, kNumParts, 1, [&](uint64_t begin, uint64_t end) {
+    for (uint64_t part = begin; part < end; part++) {
+      auto first = partitioned.begin() + part_begin[part];
+      auto last = partitioned.begin() + part_begin[part + 1];
+      std::stable_sort(first, last, [](const internals::BatchItem &lhs, const internals::BatchItem &rhs) {
+        return lhs.bucket < rhs.bucket;
+      });
+      for (auto group = first; group != last;) {
+        auto group_end = group;
+        while (group_end != last && group_end->bucket == group->bucket)
+          ++group_end;
+        num_inserted[part] += primary_table_[group->bucket].InsertBatch(&*group, group_end - group, keys, values);
+        group = group_end;
+      }
+    }
+  });
+  for (uint64_t part_inserted : num_inserted)
+    primary_size_.Add(part_inserted);
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+void ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::Reserve(
+    uint64_t num_elements) {
+  while (true) {
+    FinishResizing();
+    const uint64_t kNumBuckets = BucketsFor(num_elements);
+    {
+      std::shared_lock<StateMutex> lock(stateupdate_mutex_);
+      if (kNumBuckets <= num_buckets_primary_)
+        return;
+    }
+    // another thread may start its own resizing meanwhile, then the loop finishes it and checks again
+    ResizingBegin(kNumBuckets);
+  }
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+bool ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::SaveSnapshot(
+    const std::string &path) const {
+  typedef internals::SnapshotCodec<KeyType> KeyCodec;
+  typedef internals::SnapshotCodec<ValueType> ValueCodec;
+  std::vector<internals::BatchItem> items;
+  std::vector<typename KeyCodec::Stored> keys;
+  std::vector<typename ValueCodec::Stored> values;
+  std::string blob;
+  uint64_t num_buckets = 0;
+  {
+    // the elements are saved by the buckets of the table, which gets all of them at the end of the resizing
+    std::lock_guard<StateMutex> lock(stateupdate_mutex_);
+    num_buckets = state_ == State::kResizing? num_buckets_secondary_ : num_buckets_primary_;
+    items.reserve(Size());
+    keys.reserve(Size());
+    values.reserve(Size());
+    auto save = [&](const KeyType &key, const ValueType &value) {
+      const uint64_t kHash = Hash(key);
+      items.push_back({IndexPolicy::Index(kHash, num_buckets), kHash, items.size()});
+      keys.push_back(KeyCodec::Encode(key, blob));
+      values.push_back(ValueCodec::Encode(value, blob));
+    };
+    for (uint64_t i = 0; i < num_buckets_primary_; i++)
+      primary_table_[i].ForEach(save);
+    if (state_ == State::kResizing)
+      for (uint64_t i = 0; i < num_buckets_secondary_; i++)
+        secondary_table_[i].ForEach(save);
+  }
+
+  // counting sort by bucket
+  std::vector<uint64_t> bucket_offsets(num_buckets + 1, 0);
+  for (auto &item : items)
+    bucket_offsets[item.bucket + 1]++;
+  for (uint64_t i = 0; i < num_buckets; i++)
+    bucket_offsets[i + 1] += bucket_offsets[i];
+  std::vector<uint64_t> hashes(items.size());
+  std::vector<typename KeyCodec::Stored> sorted_keys(items.size());
+  std::vector<typename ValueCodec::Stored> sorted_values(items.size());
+  std::vector<uint64_t> next(bucket_offsets.begin(), bucket_offsets.end() - 1);
+  for (auto &item : items) {
+    const uint64_t kPosition = next[item.bucket]++;
+    hashes[kPosition] = item.hash;
+    sorted_keys[kPosition] = keys[item.position];
+    sorted_values[kPosition] = values[item.position];
+  }
+
+  internals::SnapshotHeader header = {};
+  std::memcpy(header.magic, internals::kSnapshotMagic, sizeof(header.magic));
+  header.version = internals::kSnapshotVersion;
+  header.key_format = KeyCodec::kFormat;
+  header.value_format = ValueCodec::kFormat;
+  header.key_size = sizeof(typename KeyCodec::Stored);
+  header.value_size = sizeof(typename ValueCodec::Stored);
+  header.hash_seed = Hash(KeyType());
+  header.num_buckets = num_buckets;
+  header.num_elements = items.size();
+  header.blob_size = blob.size();
+  return internals::WriteSnapshot(path, header, bucket_offsets, hashes, sorted_keys, sorted_values, blob);
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+bool ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::LoadSnapshot(
+    const std::string &path) {
+  typedef internals::SnapshotCodec<KeyType> KeyCodec;
+  typedef internals::SnapshotCodec<ValueType> ValueCodec;
+  internals::MappedFile file;
+  if (!file.Open(path))
+    return false;
+  const internals::SnapshotHeader *header = internals::CheckSnapshot<KeyType, ValueType>(file);
+  if (nullptr == header || !internals::CheckSnapshotSections<KeyType, ValueType>(file))
+    return false;
+  const internals::SnapshotLayout kLayout(*header);
+  const uint64_t kCount = header->num_elements;
+  const uint64_t kNumBuckets = header->num_buckets;
+  auto bucket_offsets = reinterpret_cast<const uint64_t *>(file.Data() + kLayout.bucket_offsets);
+  auto hashes = reinterpret_cast<const uint64_t *>(file.Data() + kLayout.hashes);
+  auto stored_keys = reinterpret_cast<const typename KeyCodec::Stored *>(file.Data() + kLayout.keys);
+  auto stored_values = reinterpret_cast<const typename ValueCodec::Stored *>(file.Data() + kLayout.values);
+  const char *blob = file.Data() + kLayout.blob;
+
+  // trivially copyable elements are read from the mapping as is, the rest is decoded first
+  const uint32_t kNumThreads = maintenance_threads_.load(std::memory_order_relaxed);
+  std::vector<KeyType> decoded_keys;
+  std::vector<ValueType> decoded_values;
+  const KeyType *keys = nullptr;
+  const ValueType *values = nullptr;
+  if constexpr (std::is_same<typename KeyCodec::Stored, KeyType>::value) {
+    keys = stored_keys;
+  } else {
+    decoded_keys.resize(kCount);
+    internals::ParallelFor(kCount, kNumThreads, kMinElementsPerWorker, [&](uint64_t begin, uint64_t end) {
+      for (uint64_t i = begin; i < end; i++)
+        decoded_keys[i] = KeyCodec::Decode(stored_keys[i], blob);
+    });
+    keys = decoded_keys.data();
+  }
+  if constexpr (std::is_same<typename ValueCodec::Stored, ValueType>::value) {
+    values = stored_values;
+  } else {
+    decoded_values.resize(kCount);
+    internals::ParallelFor(kCount, kNumThreads, kMinElementsPerWorker, [&](uint64_t begin, uint64_t end) {
+      for (uint64_t i = begin; i < end; i++)
+        decoded_values[i] = ValueCodec::Decode(stored_values[i], blob);
+    });
+    values = decoded_values.data();
+  }
+
+  // the stored layout is used if the hasher and the index policy of the map give the same buckets, and the buckets
+  // are not loaded above kMaxLoadFactor: the map would begin its resizing at the first insertion then
+  bool is_layout_valid = header->hash_seed == Hash(KeyType()) && IndexPolicy::BucketCount(kNumBuckets) == kNumBuckets
+      && kCount <= kMaxLoadFactor * kNumBuckets * Bucket::kSlotsPerBucket;
+  for (uint64_t i = 0; is_layout_valid && i < std::min(kCount, internals::kSnapshotHashSamples); i++)
+    is_layout_valid = hashes[i] == Hash(keys[i]);
+
+  FinishResizing();
+  primary_size_.Store(0);
+  if (!is_layout_valid) {
+    WARNING("the stored buckets do not fit the map, the elements are rehashed");
+    num_buckets_primary_ = min_num_buckets_;
+    primary_table_ = NewTable(num_buckets_primary_);
+    UpdateLoadCheckStep();
+    PublishTables();
+    BulkLoad(keys, values, kCount);
+    return true;
+  }
+
+  num_buckets_primary_ = kNumBuckets;
+  min_num_buckets_ = kNumBuckets;
+  primary_table_ = NewTable(kNumBuckets);
+  UpdateLoadCheckStep();
+  PublishTables();
+  std::atomic<uint64_t> num_inserted(0);
+  internals::ParallelFor(kNumBuckets, kNumThreads, kMinBucketsPerWorker, [&](uint64_t begin, uint64_t end) {
+    std::vector<internals::BatchItem> items;
+    uint64_t range_inserted = 0;
+    for (uint64_t bucket = begin; bucket < end; bucket++) {
+      items.clear();
+      for (uint64_t i = bucket_offsets[bucket]; i < bucket_offsets[bucket + 1]; i++)
+        items.push_back({bucket, hashes[i], i});
+      if (!items.empty())
+        range_inserted += primary_table_[bucket].InsertBatch(items.data(), items.size(), keys, values);
+    }
+    num_inserted += range_inserted;
+  });
+  primary_size_.Store(num_inserted);
+  return true;
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+void ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::ShrinkToFit() {
+  while (true) {
+    FinishResizing();
+    uint64_t num_buckets = 0;
+    {
+      std::shared_lock<StateMutex> lock(stateupdate_mutex_);
+      const double kFitLoad = kMaxLoadFactor / kIncreaseRate * Bucket::kSlotsPerBucket;
+      num_buckets = IndexPolicy::BucketCount(static_cast<uint64_t> (std::ceil(Size() / kFitLoad)));
+      if (num_buckets >= num_buckets_primary_)
+        return;
+    }
+    // another thread may start its own resizing meanwhile, then the loop finishes it and checks again
+    ResizingBegin(num_buckets);
+  }
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+void ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::FinishResizing() {
+  while (true) {
+    bool is_drained = false;
+    {
+      std::shared_lock<StateMutex> lock(stateupdate_mutex_);
+      if (state_ != State::kResizing)
+        return;
+      ContinuousMoving(std::numeric_limits<uint64_t>::max());
+      is_drained = PrimaryDrained();
+    }
+    if (is_drained)
+      ResizingDone();
+    else
+      std::this_thread::yield(); // other helpers are draining their ranges
+  }
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+bool ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::
+CallerHelpsResizing() const {
+  if (!background_resizing_.load(std::memory_order_acquire))
+    return true;
+  // the resizer falls behind the writers: the new table is about to need its own resizing
+  return secondary_size_.Load() > kMaxLoadFactor * num_buckets_secondary_ * Bucket::kSlotsPerBucket;
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+void ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::NotifyResizer() {
+  if (!background_resizing_.load(std::memory_order_acquire))
+    return;
+  {
+    std::lock_guard<std::mutex> lock(resizer_mutex_);
+    resizer_has_work_ = true;
+  }
+  resizer_cv_.notify_one();
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+void ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::
+StartBackgroundResizing(uint64_t batch_size, std::chrono::microseconds pause) {
+  std::lock_guard<std::mutex> lock(resizer_mutex_);
+  if (resizer_thread_.joinable())
+    return;
+  resizer_batch_ = std::max<uint64_t>(1, batch_size);
+  resizer_pause_ = pause;
+  resizer_stop_ = false;
+  resizer_has_work_ = true; // the map may be resizing already
+  background_resizing_.store(true, std::memory_order_release);
+  resizer_thread_ = std::thread(&ThreadsafeHashmap::BackgroundResizing, this);
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+void ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::
+StopBackgroundResizing() {
+  std::thread resizer;
+  {
+    std::lock_guard<std::mutex> lock(resizer_mutex_);
+    if (!resizer_thread_.joinable())
+      return;
+    background_resizing_.store(false, std::memory_order_release);
+    resizer_stop_ = true;
+    resizer = std::move(resizer_thread_);
+  }
+  resizer_cv_.notify_one();
+  resizer.join();
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+void ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::
+BackgroundResizing() {
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(resizer_mutex_);
+      resizer_cv_.wait(lock, [this]() { return resizer_stop_ || resizer_has_work_; });
+      if (resizer_stop_)
+        return;
+    }
+
+    bool is_drained = false;
+    {
+      std::shared_lock<StateMutex> lock(stateupdate_mutex_);
+      if (state_ == State::kResizing) {
+        ContinuousMoving(resizer_batch_);
+        is_drained = PrimaryDrained();
+      } else {
+        std::lock_guard<std::mutex> resizer_lock(resizer_mutex_);
+        resizer_has_work_ = false;
+        continue;
+      }
+    }
+
+    if (is_drained) {
+      ResizingDone();
+    } else if (resizer_pause_.count() > 0) {
+      std::unique_lock<std::mutex> lock(resizer_mutex_);
+      resizer_cv_.wait_for(lock, resizer_pause_, [this]() { return resizer_stop_; });
+    } else {
+      std::this_thread::yield();
+    }
+  }
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+bool ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::ContinuousMoving(
+    uint64_t num_elements) {
+  bool has_claimed = false;
   uint64_t counter = 0;
-  thread_local static uint64_t bucket_id =
-      std::hash<std::thread::id>()(std::this_thread::get_id()) % num_buckets_primary_;
-
-  while (counter < batch_elements_to_move_ && primary_size_.load(std::memory_order_acquire) > 0) {
-    auto &bucket = primary_table_[bucket_id];
-    if (0 == bucket.Size()) {
-      bucket_id = (bucket_id + 1) % num_buckets_primary_;
-      continue;
+  while (counter < num_elements) {
+    // the load keeps the late helpers from hammering the cursor when all of the ranges are taken
+    if (transfer_cursor_.load(std::memory_order_relaxed) >= num_buckets_primary_)
+      break;
+    const uint64_t kRangeBegin = transfer_cursor_.fetch_add(transfer_stride_, std::memory_order_relaxed);
+    if (kRangeBegin >= num_buckets_primary_)
+      break;
+    has_claimed = true;
+    const uint64_t kRangeEnd = std::min(kRangeBegin + transfer_stride_, num_buckets_primary_);
+    RegisterHelper();
+
+    uint64_t range_migrated = 0;
+    for (uint64_t bucket_id = kRangeBegin; bucket_id < kRangeEnd; bucket_id++) {
+      auto &bucket = primary_table_[bucket_id];
+      if (!bucket.Empty())
+        range_migrated += DrainBucket(bucket);
+    }
+    counter += range_migrated;
+    resize_buckets_moved_.fetch_add(kRangeEnd - kRangeBegin, std::memory_order_relaxed);
+    resize_ranges_claimed_.fetch_add(1, std::memory_order_relaxed);
+  }
+  if constexpr (internals::kCollectStats)
+    moved_per_call_[internals::HistogramSlot(counter, kStatsHistogramSlots)].fetch_add(1, std::memory_order_relaxed);
+  return has_claimed;
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+uint64_t ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::DrainBucket(
+    Bucket &bucket) {
+  auto hasher = [this](const KeyType &key) { return Hash(key); };
+  auto destination_router = [this](uint64_t hash) -> Bucket & {
+    return secondary_table_[SecondaryIndex(hash)];
+  };
+  uint64_t num_migrated = bucket.MigrateTo(hasher, destination_router);
+  secondary_size_.Add(num_migrated);
+  primary_size_.Add(-static_cast<int64_t>(num_migrated));
+  resize_elements_moved_.fetch_add(num_migrated, std::memory_order_relaxed);
+  return num_migrated;
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+void ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::RegisterHelper() {
+  thread_local static uint64_t helped_resize_id = 0;
+  if (helped_resize_id == resize_id_)
+    return;
+  helped_resize_id = resize_id_;
+  resize_helpers_.fetch_add(1, std::memory_order_relaxed);
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+typename ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::ResizeStats
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::
+LastResizeStats() const {
+  std::shared_lock<StateMutex> lock(stateupdate_mutex_);
+  return last_resize_stats_;
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+typename ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::MapStats
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::Stats() {
+  MapStats stats;
+  {
+    std::shared_lock<StateMutex> lock(stateupdate_mutex_);
+    stats.num_buckets = num_buckets_primary_;
+    stats.last_resize = last_resize_stats_;
+    stats.is_resizing = state_ == State::kResizing;
+    if (stats.is_resizing) {
+      stats.current_resize.old_num_buckets = num_buckets_primary_;
+      stats.current_resize.new_num_buckets = num_buckets_secondary_;
+      stats.current_resize.buckets_moved = resize_buckets_moved_.load(std::memory_order_relaxed);
+      stats.current_resize.elements_moved = resize_elements_moved_.load(std::memory_order_relaxed);
+      stats.current_resize.ranges_claimed = resize_ranges_claimed_.load(std::memory_order_relaxed);
+      stats.current_resize.num_helpers = resize_helpers_.load(std::memory_order_relaxed);
+      stats.current_resize.duration_us = std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - resize_start_).count();
+      stats.current_resize.start_time_us = std::chrono::duration_cast<std::chrono::microseconds>(
+          resize_start_time_.time_since_epoch()).count();
+      stats.new_table_elements = secondary_size_.Load();
+    }
+  }
+  stats.chain_lengths.assign(kStatsMaxChainLength + 1, 0);
+  for (uint64_t chunk_begin = 0; chunk_begin < stats.num_buckets; chunk_begin += kScanChunk) {
+    std::shared_lock<StateMutex> lock(stateupdate_mutex_);
+    const uint64_t kChunkEnd = std::min(std::min(stats.num_buckets, chunk_begin + kScanChunk), num_buckets_primary_);
+    for (uint64_t i = chunk_begin; i < kChunkEnd; i++) {
+      const uint64_t kLength = primary_table_[i].Size();
+      stats.chain_lengths[std::min(kLength, kStatsMaxChainLength)]++;
+      stats.max_chain_length = std::max(stats.max_chain_length, kLength);
+      stats.num_elements += kLength;
+      stats.bucket_lock_waits += primary_table_[i].WaitStats();
+    }
+  }
+  stats.chain_lengths.resize(std::min(stats.max_chain_length, kStatsMaxChainLength) + 1);
+  stats.empty_bucket_fraction = stats.chain_lengths[0] / double(stats.num_buckets);
+  stats.expected_empty_fraction = std::exp(-(stats.num_elements / double(stats.num_buckets)));
+  stats.state_lock_waits = internals::WaitsOf(stateupdate_mutex_);
+  stats.retired_tables = num_retired_.load(std::memory_order_relaxed);
+
+  for (const auto &slot : moved_per_call_)
+    stats.moved_per_call.push_back(slot.load(std::memory_order_relaxed));
+  while (!stats.moved_per_call.empty() && stats.moved_per_call.back() == 0)
+    stats.moved_per_call.pop_back();
+  return stats;
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+std::string ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::DumpStats(
+    StatsFormat format) {
+  const MapStats kStats = Stats();
+  const bool kJson = format == StatsFormat::kJson;
+  std::ostringstream out;
+  const char *separator = kJson? "{" : "";
+  auto field = [&out, &separator, kJson](const char *name) -> std::ostream & {
+    out << separator << (kJson? "\"" : "") << name << (kJson? "\": " : ": ");
+    separator = kJson? ", " : "\n";
+    return out;
+  };
+  auto list = [&out, kJson](const std::vector<uint64_t> &values) {
+    out << (kJson? "[" : "");
+    for (uint64_t i = 0; i < values.size(); i++)
+      out << (i == 0? "" : kJson? ", " : " ") << values[i];
+    out << (kJson? "]" : "");
+  };
+
+  field("is_detailed") << (kStats.is_detailed? "true" : "false");
+  field("num_buckets") << kStats.num_buckets;
+  field("num_elements") << kStats.num_elements;
+  field("max_chain_length") << kStats.max_chain_length;
+  field("chain_lengths");
+  list(kStats.chain_lengths);
+  field("empty_bucket_fraction") << kStats.empty_bucket_fraction;
+  field("expected_empty_fraction") << kStats.expected_empty_fraction;
+  field("bucket_lock_waits") << kStats.bucket_lock_waits.count;
+  field("bucket_lock_wait_ns") << kStats.bucket_lock_waits.wait_ns;
+  field("state_lock_waits") << kStats.state_lock_waits.count;
+  field("state_lock_wait_ns") << kStats.state_lock_waits.wait_ns;
+  field("num_resizes") << kStats.last_resize.num_resizes;
+  field("resize_old_num_buckets") << kStats.last_resize.old_num_buckets;
+  field("resize_new_num_buckets") << kStats.last_resize.new_num_buckets;
+  field("resize_elements_moved") << kStats.last_resize.elements_moved;
+  field("resize_num_helpers") << kStats.last_resize.num_helpers;
+  field("resize_start_time_us") << kStats.last_resize.start_time_us;
+  field("resize_finish_time_us") << kStats.last_resize.finish_time_us;
+  field("resize_duration_us") << kStats.last_resize.duration_us;
+  field("is_resizing") << (kStats.is_resizing? "true" : "false");
+  field("resizing_new_num_buckets") << kStats.current_resize.new_num_buckets;
+  field("resizing_buckets_moved") << kStats.current_resize.buckets_moved;
+  field("resizing_elements_moved") << kStats.current_resize.elements_moved;
+  field("resizing_duration_us") << kStats.current_resize.duration_us;
+  field("new_table_elements") << kStats.new_table_elements;
+  field("retired_tables") << kStats.retired_tables;
+  field("moved_per_call");
+  list(kStats.moved_per_call);
+  out << (kJson? "}" : "\n");
+  return out.str();
+}
+
+/// @brief ThreadsafeHashmap which buckets are open addressing groups probed by hash tags
+template <typename KeyType, typename ValueType, typename Hasher = std::hash<KeyType>,
+          typename KeyEqual = std::equal_to<KeyType>>
+using FlatThreadsafeHashmap = ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, internals::FlatBucket>;
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+class ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::ScanCursor {
+ public:
+  ScanCursor() = default;
+  /// @brief traversal of the whole current table
+  explicit ScanCursor(ThreadsafeHashmap &map) : map_(&map) {
+    std::shared_lock<StateMutex> lock(map.stateupdate_mutex_);
+    num_buckets_ = end_ = first_num_buckets_ = first_end_ = map.num_buckets_primary_;
+  }
+  /// @brief traversal of the elements which hash into the buckets [begin, end) of a table with num_buckets buckets
+  ScanCursor(ThreadsafeHashmap &map, uint64_t num_buckets, uint64_t begin, uint64_t end)
+      : map_(&map), num_buckets_(num_buckets), begin_(begin), position_(begin), end_(end),
+        first_num_buckets_(num_buckets), first_begin_(begin), first_end_(end) { }
+
+  /// @brief visits the elements of the next max_buckets positions under one acquisition of the state lock, so Clear
+  ///        and the resizings are not held back for long
+  /// @return false once the traversal is over
+  template <typename Visitor>
+  bool Step(Visitor &visitor, uint64_t max_buckets) {
+    std::shared_lock<StateMutex> lock(map_->stateupdate_mutex_);
+    if (position_ >= end_)
+      return false;
+    const bool kIsResizing = map_->state_ == State::kResizing;
+    const uint64_t kNumOld = map_->num_buckets_primary_;
+    const uint64_t kNumNew = kIsResizing? map_->num_buckets_secondary_ : kNumOld;
+    // the index is the hash modulo the bucket count, so the elements of position i are in the buckets
+    // i mod g + k * g of a table, where g is the greatest common divisor of its bucket count and num_buckets_
+    const uint64_t kOldStride = std::gcd(num_buckets_, kNumOld);
+    const uint64_t kNewStride = std::gcd(num_buckets_, kNumNew);
+    // a position spread over too many buckets, or a bucket shared by too many positions, is visited all over again
+    if (std::max(kNumOld, num_buckets_) / kOldStride > kMaxScanFanout ||
+        std::max(kNumNew, num_buckets_) / kNewStride > kMaxScanFanout) {
+      if (kIsResizing) {
+        lock.unlock();
+        map_->FinishResizing();
+        return true;
+      }
+      // the buckets of the current table become the positions, the passed elements are skipped there
+      passed_.push_back({num_buckets_, begin_, position_});
+      num_buckets_ = end_ = kNumOld;
+      begin_ = position_ = 0;
     }
 
-    auto destination_router = [this](const KeyType &key) -> Bucket & {
-      return secondary_table_[SecondaryIndex(key)];
+    const uint64_t kEnd = std::min(end_, position_ + max_buckets);
+    if (!kIsResizing && kNumOld == num_buckets_ && passed_.empty()) {
+      for (; position_ < kEnd; position_++)
+        map_->primary_table_[position_].ForEach(visitor);
+      return true;
+    }
+    auto visit_position = [this, &visitor](const KeyType &key, const ValueType &value) {
+      const uint64_t kHash = map_->Hash(key);
+      if (IndexPolicy::Index(kHash, num_buckets_) == position_ && IsNew(kHash))
+        visitor(key, value);
     };
-    uint64_t num_migrated = bucket.MigrateTo(destination_router);
-    secondary_size_ += num_migrated;
-    counter += num_migrated;
-    bucket_id = (bucket_id + 1) % num_buckets_primary_;
-    primary_size_ -= num_migrated;
+    bool may_be_drained = false;
+    for (; position_ < kEnd; position_++) {
+      if (!kIsResizing) {
+        for (uint64_t i = position_ % kOldStride; i < kNumOld; i += kOldStride)
+          map_->primary_table_[i].ForEach(visit_position);
+        continue;
+      }
+      // nothing goes into a drained old bucket, so all of the elements of the position are in the new table then
+      for (uint64_t i = position_ % kOldStride; i < kNumOld; i += kOldStride) {
+        auto &old_bucket = map_->primary_table_[i];
+        may_be_drained |= !old_bucket.Empty() && map_->DrainBucket(old_bucket) > 0;
+      }
+      for (uint64_t i = position_ % kNewStride; i < kNumNew; i += kNewStride)
+        map_->secondary_table_[i].ForEach(visit_position);
+    }
+    if (may_be_drained && map_->PrimaryDrained()) {
+      lock.unlock();
+      map_->ResizingDone();
+    }
+    return true;
+  }
+
+ private:
+  /// @brief buckets [begin, end) of a table with num_buckets buckets
+  struct Range {
+    uint64_t num_buckets;
+    uint64_t begin;
+    uint64_t end;
+  };
+  /// @return true if the hash belongs to the traversal and was not passed in the earlier positions
+  bool IsNew(uint64_t hash) const {
+    const uint64_t kFirstIndex = IndexPolicy::Index(hash, first_num_buckets_);
+    if (kFirstIndex < first_begin_ || kFirstIndex >= first_end_)
+      return false;
+    for (const Range &range : passed_) {
+      const uint64_t kIndex = IndexPolicy::Index(hash, range.num_buckets);
+      if (kIndex >= range.begin && kIndex < range.end)
+        return false;
+    }
+    return true;
+  }
+
+  ThreadsafeHashmap *map_ = nullptr;
+  uint64_t num_buckets_ = 0; ///< the positions are the buckets of a table of this size, which may be gone
+  uint64_t begin_ = 0;
+  uint64_t position_ = 0;
+  uint64_t end_ = 0;
+  uint64_t first_num_buckets_ = 0; ///< the traversal owns the hashes of [first_begin_, first_end_) of the first table
+  uint64_t first_begin_ = 0;
+  uint64_t first_end_ = 0;
+  std::vector<Range> passed_; ///< the earlier positions
+};
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+template <typename Visitor>
+void ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::
+ForEach(Visitor visitor) {
+  ScanCursor cursor(*this);
+  while (cursor.Step(visitor, kScanChunk)) { }
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+template <typename Visitor>
+void ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::ParallelForEach(
+    Visitor visitor, uint32_t num_threads) {
+  uint64_t num_buckets = 0;
+  {
+    std::shared_lock<StateMutex> lock(stateupdate_mutex_);
+    num_buckets = num_buckets_primary_;
   }
+  auto scan_range = [this, &visitor, num_buckets](uint64_t begin, uint64_t end) {
+    ScanCursor cursor(*this, num_buckets, begin, end);
+    while (cursor.Step(visitor, kScanChunk)) { }
+  };
+  internals::ParallelFor(num_buckets, num_threads, kMinBucketsPerWorker, scan_range);
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+class ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::ScanIterator {
+ public:
+  typedef std::input_iterator_tag iterator_category;
+  typedef std::pair<KeyType, ValueType> value_type;
+  typedef std::ptrdiff_t difference_type;
+  typedef const value_type *pointer;
+  typedef const value_type &reference;
+
+  /// @brief end of any traversal
+  ScanIterator() = default;
+  explicit ScanIterator(ThreadsafeHashmap &map) : map_(&map), cursor_(map) {
+    LoadNextBucket();
+  }
+
+  reference operator*() const { return elements_[position_]; }
+  pointer operator->() const { return &elements_[position_]; }
+
+  ScanIterator &operator++() {
+    if (++position_ == elements_.size())
+      LoadNextBucket();
+    return *this;
+  }
+
+  bool operator==(const ScanIterator &rhs) const {
+    return map_ == rhs.map_ && num_steps_ == rhs.num_steps_ && position_ == rhs.position_;
+  }
+  bool operator!=(const ScanIterator &rhs) const { return !(*this == rhs); }
+
+ private:
+  /// @brief copies the elements of the next non-empty bucket, turns into End() after the last one
+  void LoadNextBucket() {
+    elements_.clear();
+    position_ = 0;
+    auto copy = [this](const KeyType &key, const ValueType &value) { elements_.emplace_back(key, value); };
+    while (elements_.empty() && cursor_.Step(copy, 1))
+      num_steps_++;
+    if (elements_.empty()) {
+      map_ = nullptr;
+      num_steps_ = 0;
+    }
+  }
+
+  ThreadsafeHashmap *map_ = nullptr;
+  ScanCursor cursor_;
+  std::vector<value_type> elements_; ///< copy of the current bucket
+  uint64_t num_steps_ = 0;
+  uint64_t position_ = 0;
+};
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+typename ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::ScanIterator
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::Begin() {
+  return ScanIterator(*this);
+}
+
+template <typename KeyType, typename ValueType, typename Hasher, typename KeyEqual,
+          template <typename...> class BucketType, typename NodeAllocator, typename IndexPolicy>
+typename ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::ScanIterator
+ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>::End() {
+  return ScanIterator();
 }
 
 } // namespace my_concurrency
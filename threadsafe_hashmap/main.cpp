@@ -1,7 +1,16 @@
 #include <iostream>
 
 #include "tests/bucket_test.h"
+#include "tests/cache_test.h"
 #include "tests/concurrent_bucket_test.h"
+#include "tests/counter_map_test.h"
+#include "tests/cuckoo_hashmap_test.h"
+#include "tests/expiring_hashmap_test.h"
+#include "tests/flat_bucket_test.h"
+#include "tests/lockfree_bucket_test.h"
+#include "tests/node_allocator_test.h"
+#include "tests/seqlock_bucket_test.h"
+#include "tests/snapshot_test.h"
 #include "tests/hashmap_test.h"
 
 using namespace std;
@@ -13,9 +22,56 @@ int main() {
   tests::ConcurrentListTest concurrent_test;
   concurrent_test.TestAll();
 
-  tests::ConcurrentMapTest map_test;
+  tests::FlatBucketTest flat_bucket_test;
+  flat_bucket_test.TestAll();
+
+  tests::LockFreeBucketTest lockfree_bucket_test;
+  lockfree_bucket_test.TestAll();
+
+  tests::NodeAllocatorTest node_allocator_test;
+  node_allocator_test.TestAll();
+
+  tests::SeqLockBucketTest seqlock_bucket_test;
+  seqlock_bucket_test.TestAll();
+
+  tests::ConcurrentMapTest<> map_test;
   map_test.TestAll();
 
+  tests::ConcurrentMapTest<my_concurrency::internals::FlatBucket> flat_map_test;
+  flat_map_test.TestAll();
+
+  tests::ConcurrentMapTest<my_concurrency::internals::LockFreeReadBucket> lockfree_map_test;
+  lockfree_map_test.TestAll();
+
+  tests::ConcurrentMapTest<my_concurrency::internals::CompactBucket> compact_map_test;
+  compact_map_test.TestAll();
+
+  tests::ConcurrentMapTest<my_concurrency::internals::OptimisticReadBucket> optimistic_map_test;
+  optimistic_map_test.TestAll();
+
+  tests::ConcurrentMapTest<my_concurrency::internals::Bucket, my_concurrency::internals::SlabNodeAllocator>
+      slab_map_test;
+  slab_map_test.TestAll();
+
+  tests::ConcurrentMapTest<my_concurrency::internals::Bucket, my_concurrency::internals::HeapNodeAllocator,
+                           my_concurrency::PowerOfTwoIndexing> pow2_map_test;
+  pow2_map_test.TestAll();
+
+  tests::SnapshotTest snapshot_test;
+  snapshot_test.TestAll();
+
+  tests::ConcurrentCacheTest cache_test;
+  cache_test.TestAll();
+
+  tests::ExpiringHashmapTest expiring_map_test;
+  expiring_map_test.TestAll();
+
+  tests::CuckooHashmapTest cuckoo_map_test;
+  cuckoo_map_test.TestAll();
+
+  tests::CounterMapTest counter_map_test;
+  counter_map_test.TestAll();
+
   std::cout << "All tests passed.\n" << std::endl;
   return 0;
 }
\ No newline at end of file
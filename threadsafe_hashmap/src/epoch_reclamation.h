@@ -0,0 +1,265 @@
+#ifndef THREADSAFE_HASHMAP_EPOCH_RECLAMATION_H
+#define THREADSAFE_HASHMAP_EPOCH_RECLAMATION_H
+
+#include <algorithm> // min
+#include <atomic>
+#include <inttypes.h>
+#include <limits>
+#include <mutex>
+#include <utility> // swap
+#include <vector>
+
+#include "helpers.h"
+
+namespace my_concurrency {
+namespace internals {
+
+/// @brief Epoch based memory reclamation for lock-free readers.
+///        A reader pins the current epoch with EpochGuard before it loads any shared pointer.
+///        A writer unlinks an object and hands it to Retire; the object is deleted once every
+///        reader which was pinned at the moment of retirement has left its critical section.
+///        The domain is process-wide, every thread gets its own padded record on first use.
+class EpochDomain {
+ public:
+  static EpochDomain &Instance() {
+    static EpochDomain domain;
+    return domain;
+  }
+
+  ~EpochDomain();
+
+  /// @brief Enters read-side critical section. Calls may be nested
+  void Pin();
+  /// @brief Leaves read-side critical section
+  void Unpin();
+
+  /// @brief Schedules deletion of the unlinked object
+  /// @param deleter is called exactly once when no reader can observe ptr anymore
+  void Retire(void *ptr, void (*deleter)(void *));
+
+  template <typename T>
+  void Retire(T *ptr) {
+    Retire(ptr, [](void *p) { delete static_cast<T *>(p); });
+  }
+
+  /// @brief Stamps an unlinked object which the caller keeps in a list of its own instead of handing it to Retire,
+  ///        so any thread may delete it later
+  /// @return epoch of the retirement, see Advance
+  uint64_t RetireEpoch();
+
+  /// @brief Advances the epoch
+  /// @return smallest epoch pinned by any thread: the objects stamped by RetireEpoch before it are unreachable
+  uint64_t Advance();
+
+  /// @brief Advances the epoch and deletes retired objects of the calling thread which became unreachable
+  /// @return number of deleted objects
+  uint64_t Collect();
+
+  /// @return number of retired objects of the calling thread waiting for deletion
+  uint64_t PendingCount();
+
+  constexpr static uint64_t kCollectThreshold = 64; ///< amount of retirements which triggers Collect
+ private:
+  EpochDomain() : global_epoch_(1), records_(nullptr), has_orphans_(false) { }
+  EpochDomain(const EpochDomain &) = delete;
+  EpochDomain &operator=(const EpochDomain &) = delete;
+
+  constexpr static uint64_t kQuiescent = std::numeric_limits<uint64_t>::max();
+
+  struct Retired {
+    void *ptr;
+    void (*deleter)(void *);
+    uint64_t epoch; ///< global epoch at the moment of retirement
+  };
+
+  struct ThreadRecord {
+    std::atomic<uint64_t> epoch{kQuiescent}; ///< pinned epoch or kQuiescent
+    std::atomic<bool> in_use{true};
+    ThreadRecord *next = nullptr;
+    uint32_t nesting = 0; ///< owned by the thread
+    std::vector<Retired> limbo; ///< owned by the thread
+    char padding[64]; ///< keeps records of different threads in different cache lines
+  };
+
+  /// @brief binds a record to the thread and releases it when the thread exits
+  class ThreadHandle {
+   public:
+    ThreadHandle() : record_(nullptr) { }
+    ~ThreadHandle();
+    ThreadRecord *Get();
+   private:
+    ThreadRecord *record_;
+  };
+
+  ThreadRecord *LocalRecord();
+  ThreadRecord *AcquireRecord();
+  void ReleaseRecord(ThreadRecord *record);
+
+  /// @return smallest epoch pinned by any thread
+  uint64_t MinPinnedEpoch() const;
+
+  /// @brief deletes objects retired before min_epoch, keeps the rest in the list
+  static uint64_t Reclaim(std::vector<Retired> &retired, uint64_t min_epoch);
+
+  std::atomic<uint64_t> global_epoch_;
+  std::atomic<ThreadRecord *> records_; ///< push-only list, records are reused by new threads
+  std::mutex orphans_mutex_;
+  std::vector<Retired> orphans_; ///< retired objects of the exited threads
+  std::atomic<bool> has_orphans_;
+};
+
+/// @brief RAII read-side critical section of the process-wide epoch domain
+class EpochGuard {
+ public:
+  EpochGuard() { EpochDomain::Instance().Pin(); }
+  ~EpochGuard() { EpochDomain::Instance().Unpin(); }
+  EpochGuard(const EpochGuard &) = delete;
+  EpochGuard &operator=(const EpochGuard &) = delete;
+};
+
+inline EpochDomain::~EpochDomain() {
+  // no reader can be pinned at static destruction time
+  Reclaim(orphans_, kQuiescent);
+  auto record = records_.load(std::memory_order_acquire);
+  while (record != nullptr) {
+    auto temp = record;
+    record = record->next;
+    Reclaim(temp->limbo, kQuiescent);
+    delete temp;
+  }
+}
+
+inline EpochDomain::ThreadHandle::~ThreadHandle() {
+  if (record_ != nullptr)
+    EpochDomain::Instance().ReleaseRecord(record_);
+}
+
+inline EpochDomain::ThreadRecord *EpochDomain::ThreadHandle::Get() {
+  if (record_ == nullptr)
+    record_ = EpochDomain::Instance().AcquireRecord();
+  return record_;
+}
+
+inline EpochDomain::ThreadRecord *EpochDomain::LocalRecord() {
+  thread_local static ThreadHandle handle;
+  return handle.Get();
+}
+
+inline EpochDomain::ThreadRecord *EpochDomain::AcquireRecord() {
+  for (auto record = records_.load(std::memory_order_acquire); record != nullptr; record = record->next) {
+    bool expected = false;
+    if (!record->in_use.load(std::memory_order_relaxed) &&
+        record->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire))
+      return record;
+  }
+
+  auto record = new ThreadRecord();
+  record->next = records_.load(std::memory_order_relaxed);
+  while (!records_.compare_exchange_weak(record->next, record,
+                                        std::memory_order_release, std::memory_order_relaxed)) {
+  }
+  return record;
+}
+
+inline void EpochDomain::ReleaseRecord(ThreadRecord *record) {
+  record->epoch.store(kQuiescent, std::memory_order_release);
+  record->nesting = 0;
+  if (!record->limbo.empty()) {
+    std::lock_guard<std::mutex> lock(orphans_mutex_);
+    orphans_.insert(orphans_.end(), record->limbo.begin(), record->limbo.end());
+    record->limbo.clear();
+    has_orphans_.store(true, std::memory_order_release);
+  }
+  record->in_use.store(false, std::memory_order_release);
+}
+
+inline void EpochDomain::Pin() {
+  auto record = LocalRecord();
+  if (record->nesting++ > 0)
+    return;
+  record->epoch.store(global_epoch_.load(std::memory_order_acquire), std::memory_order_relaxed);
+  // the announcement must be visible to writers before any shared pointer is loaded
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+inline void EpochDomain::Unpin() {
+  auto record = LocalRecord();
+  if (--record->nesting > 0)
+    return;
+  record->epoch.store(kQuiescent, std::memory_order_release);
+}
+
+inline void EpochDomain::Retire(void *ptr, void (*deleter)(void *)) {
+  auto record = LocalRecord();
+  // readers which pin a later epoch are guaranteed to see the object already unlinked
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  record->limbo.push_back({ptr, deleter, global_epoch_.load(std::memory_order_acquire)});
+  if (record->limbo.size() % kCollectThreshold == 0)
+    Collect();
+}
+
+inline uint64_t EpochDomain::MinPinnedEpoch() const {
+  uint64_t min_epoch = kQuiescent;
+  for (auto record = records_.load(std::memory_order_acquire); record != nullptr; record = record->next)
+    min_epoch = std::min(min_epoch, record->epoch.load(std::memory_order_acquire));
+  return min_epoch;
+}
+
+inline uint64_t EpochDomain::Reclaim(std::vector<Retired> &retired, uint64_t min_epoch) {
+  uint64_t num_deleted = 0;
+  auto alive_end = retired.begin();
+  for (auto &item : retired) {
+    if (item.epoch < min_epoch) {
+      item.deleter(item.ptr);
+      num_deleted++;
+    } else {
+      *alive_end++ = item;
+    }
+  }
+  retired.erase(alive_end, retired.end());
+  return num_deleted;
+}
+
+inline uint64_t EpochDomain::RetireEpoch() {
+  // readers which pin a later epoch are guaranteed to see the object already unlinked
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  return global_epoch_.load(std::memory_order_acquire);
+}
+
+inline uint64_t EpochDomain::Advance() {
+  global_epoch_.fetch_add(1, std::memory_order_acq_rel);
+  // pairs with the fence in Pin: either the reader is seen pinned or it sees the object unlinked
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  return MinPinnedEpoch();
+}
+
+inline uint64_t EpochDomain::Collect() {
+  auto record = LocalRecord();
+  const uint64_t kMinEpoch = Advance();
+
+  uint64_t num_deleted = Reclaim(record->limbo, kMinEpoch);
+  if (has_orphans_.load(std::memory_order_acquire)) {
+    std::vector<Retired> orphans;
+    {
+      std::lock_guard<std::mutex> lock(orphans_mutex_);
+      std::swap(orphans, orphans_);
+      has_orphans_.store(false, std::memory_order_release);
+    }
+    num_deleted += Reclaim(orphans, kMinEpoch);
+    if (!orphans.empty()) {
+      std::lock_guard<std::mutex> lock(orphans_mutex_);
+      orphans_.insert(orphans_.end(), orphans.begin(), orphans.end());
+      has_orphans_.store(true, std::memory_order_release);
+    }
+  }
+  return num_deleted;
+}
+
+inline uint64_t EpochDomain::PendingCount() {
+  return LocalRecord()->limbo.size();
+}
+
+} // namespace internals
+} // namespace my_concurrency
+
+#endif //THREADSAFE_HASHMAP_EPOCH_RECLAMATION_H
@@ -0,0 +1,498 @@
+#ifndef THREADSAFE_HASHMAP_FLAT_BUCKET_H
+#define THREADSAFE_HASHMAP_FLAT_BUCKET_H
+
+#include <algorithm> // fill
+#include <atomic>
+#include <functional>
+#include <inttypes.h>
+#include <mutex>
+#include <new>
+#include <shared_mutex>
+#include <tuple> // forward_as_tuple
+#include <type_traits>
+#include <utility> // pair
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "helpers.h"
+#include "map_stats.h"
+#include "node_allocator.h"
+
+namespace my_concurrency {
+namespace internals {
+
+/// @brief Many readers - single writer bucket based on open addressing.
+///        Elements are kept in groups of kGroupSize slots with a parallel array of 1-byte hash tags.
+///        A lookup compares all tags of a group at once (SSE2) and touches the keys of matching slots only.
+///        The first group is stored inline, overflow groups are chained and released as soon as they get empty.
+/// @tparam ValueType should have default constructor in order to lookup non-existing elements
+/// @tparam NodeAllocator source of the overflow groups
+/// @tparam KeyEqual equality predicate of the keys
+template <typename KeyType, typename ValueType, typename NodeAllocator = HeapNodeAllocator,
+          typename KeyEqual = std::equal_to<KeyType>>
+class FlatBucket : private PolicyHolder<NodeAllocator, 0>, private PolicyHolder<KeyEqual, 1> {
+ public:
+  explicit FlatBucket(const NodeAllocator &allocator = NodeAllocator(), const KeyEqual &key_equal = KeyEqual())
+      : AllocatorHolder(allocator), KeyEqualHolder(key_equal), size_(0) { }
+
+  /// @brief snapshot copy: requires full lock. The copy shares the allocator and the predicate
+  FlatBucket(const FlatBucket &rhs);
+  ~FlatBucket() {
+    Clear();
+  }
+
+  uint64_t Size() const;
+  /// @brief contended acquisitions of the bucket lock, zeros unless the mutex counts them
+  LockWaitStats WaitStats() const { return WaitsOf(mutex_); }
+  bool Empty() const;
+
+  /// @brief Remove all elements in the bucket
+  void Clear();
+
+  /// @brief add key-value pair to the bucket. Rewrites value in case the key already exists
+  /// @param hash full hash of the key computed by the owner. The same key must always come with the same hash
+  /// @return true if new element was inserted, false if a slot was overwritten
+  bool Insert(uint64_t hash, const KeyType &key, const ValueType &value);
+  bool Insert(uint64_t hash, KeyType &&key, ValueType &&value);
+
+  /// @tparam K KeyType or any type the KeyEqual compares with the keys, e.g. std::string_view
+  /// @return true in case successful removal, false in case no such key in the bucket
+  template <typename K>
+  bool Remove(uint64_t hash, const K &key);
+
+  /// @return pair: first part is true if element with such key exists in the bucket, false otherwise
+  ///               second part is a value
+  template <typename K>
+  std::pair<bool, ValueType> Lookup(uint64_t hash, const K &key) const;
+
+  /// @brief calls visitor(const ValueType &) for the element under the shared lock, the value is not copied
+  /// @return true if element with such key exists in the bucket
+  template <typename K, typename Visitor>
+  bool Visit(uint64_t hash, const K &key, Visitor &&visitor) const;
+
+  /// @brief read-modify-write under the exclusive lock: calls update(ValueType &) for the existing element,
+  ///        otherwise inserts the value returned by create()
+  /// @return true if new element was inserted
+  template <typename Updater, typename Creator>
+  bool Upsert(uint64_t hash, const KeyType &key, Updater &&update, Creator &&create);
+
+  /// @brief calls update(ValueType &) for the existing element under the exclusive lock, otherwise constructs
+  ///        the element in a free slot from the forwarded key and args
+  /// @return true if new element was inserted
+  template <typename K, typename Updater, typename... Args>
+  bool EmplaceOrUpdate(uint64_t hash, K &&key, Updater &&update, Args &&... args);
+
+  /// @brief inserts the batch under one exclusive lock. Rewrites values in case the keys already exist
+  /// @param items elements of this bucket: keys[item.position] and values[item.position] are inserted in order
+  /// @return number of new elements
+  uint64_t InsertBatch(const BatchItem *items, uint64_t count, const KeyType *keys, const ValueType *values);
+
+  /// @brief looks the batch up under one shared lock
+  /// @param results receives the result of keys[item.position] at the same position
+  void LookupBatch(const BatchItem *items, uint64_t count, const KeyType *keys,
+                   std::pair<bool, ValueType> *results) const;
+
+  /// @brief makes a snapshot full copy of the other bucket
+  FlatBucket &operator=(const FlatBucket &rhs);
+
+  /// @brief calls visitor(const KeyType &, const ValueType &) for every element under the shared lock
+  template <typename Visitor>
+  void ForEach(Visitor &&visitor) const;
+
+  /// @brief removes the elements for which predicate(const KeyType &, const ValueType &) is true under the writer lock
+  /// @return number of removed elements
+  template <typename Predicate>
+  uint64_t RemoveIf(Predicate &&predicate);
+
+  /// @brief Moves all of the items to different buckets obtained by dest function
+  /// @param hasher returns the same hash the owner passes to Insert
+  /// @param dest returns appropriate bucket according to the hash of the key
+  /// @returns number of items were migrated
+  template <typename Hasher, typename Router>
+  uint64_t MigrateTo(const Hasher &hasher, const Router &dest);
+
+  constexpr static uint64_t kGroupSize = 16;
+  constexpr static uint64_t kSlotsPerBucket = kGroupSize; ///< nominal capacity used by the owner for load factor
+  constexpr static bool kLockedVisit = true; ///< Visit passes the stored value under the lock of the bucket
+
+  constexpr static bool kOperationSuccess = true;
+  constexpr static bool kOperationFailed = false;
+ private:
+  typedef int8_t ControlByte;
+  typedef std::pair<KeyType, ValueType> Slot;
+
+  constexpr static ControlByte kEmpty = -128; ///< full slots hold a 7-bit tag, so the sign bit marks a free one
+  constexpr static uint32_t kFullGroupMask = (1u << kGroupSize) - 1;
+
+  struct Group {
+    alignas(16) ControlByte ctrl[kGroupSize];
+    typename std::aligned_storage<sizeof(Slot), alignof(Slot)>::type slots[kGroupSize];
+    Group *next = nullptr;
+
+    Group() { std::fill(ctrl, ctrl + kGroupSize, kEmpty); }
+    Group(const Group &) = delete;
+    Group &operator=(const Group &) = delete;
+
+    /// @return bitmask of the slots which control byte is equal to the given one
+    uint32_t Match(ControlByte tag) const;
+    uint32_t MatchEmpty() const { return Match(kEmpty); }
+    uint32_t MatchFull() const { return ~MatchEmpty() & kFullGroupMask; }
+
+    Slot &At(uint32_t idx) { return *reinterpret_cast<Slot *>(&slots[idx]); }
+    const Slot &At(uint32_t idx) const { return *reinterpret_cast<const Slot *>(&slots[idx]); }
+
+    /// @brief destroys all of the elements in the group
+    void Destroy();
+  };
+
+  /// @brief 7 bits of the hash which are independent from the low bits the owner uses for indexing
+  static ControlByte Tag(uint64_t hash);
+
+  /// @return pointer to the slot with such key or nullptr. Requires the lock
+  template <typename K>
+  const Slot *Find(ControlByte tag, const K &key) const;
+
+  /// @brief places the pair into the bucket. Requires exclusive lock
+  /// @return true if new element was inserted, false if a slot was overwritten
+  template <typename K, typename V>
+  bool InsertLocked(ControlByte tag, K &&key, V &&value);
+
+  /// @brief constructs the element in the first free slot, the key must be absent. Requires exclusive lock
+  template <typename K, typename... Args>
+  void PlaceLocked(ControlByte tag, K &&key, Args &&... args);
+
+  /// @brief destroys all of the elements and releases overflow groups. Requires exclusive lock
+  void ClearLocked();
+
+  typedef PolicyHolder<NodeAllocator, 0> AllocatorHolder;
+  typedef PolicyHolder<KeyEqual, 1> KeyEqualHolder;
+
+  NodeAllocator &Allocator() { return AllocatorHolder::Policy(); }
+  template <typename K>
+  bool KeysEqual(const KeyType &lhs, const K &rhs) const { return KeyEqualHolder::Policy()(lhs, rhs); }
+
+  typedef StatsMutex<std::shared_timed_mutex> Mutex;
+
+  mutable Mutex mutex_;
+  Group head_;
+  std::atomic_ullong size_;
+};
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+uint32_t FlatBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::Group::Match(ControlByte tag) const {
+#ifdef __SSE2__
+  const __m128i kCtrl = _mm_load_si128(reinterpret_cast<const __m128i *>(ctrl));
+  return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(tag), kCtrl)));
+#else
+  uint32_t mask = 0;
+  for (uint32_t i = 0; i < kGroupSize; i++)
+    if (ctrl[i] == tag)
+      mask |= 1u << i;
+  return mask;
+#endif
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+void FlatBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::Group::Destroy() {
+  for (uint32_t mask = MatchFull(); mask != 0; mask &= mask - 1) {
+    uint32_t idx = __builtin_ctz(mask);
+    At(idx).~Slot();
+    ctrl[idx] = kEmpty;
+  }
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+typename FlatBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::ControlByte
+FlatBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::Tag(uint64_t hash) {
+  return static_cast<ControlByte>((hash * 0x9E3779B97F4A7C15ull) >> 57);
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+FlatBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::FlatBucket(const FlatBucket &rhs)
+    : AllocatorHolder(rhs), KeyEqualHolder(rhs), size_(0) {
+  *this = rhs;
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+FlatBucket<KeyType, ValueType, NodeAllocator, KeyEqual> &
+FlatBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::operator=(const FlatBucket &rhs) {
+  if (this == &rhs)
+    return *this;
+  std::shared_lock<Mutex> rhs_lock(rhs.mutex_);
+  std::lock_guard<Mutex> lock(mutex_);
+  ClearLocked();
+
+  // the layout is copied as is, so there is no need to rehash anything
+  Group *group = &head_;
+  for (const Group *rhs_group = &rhs.head_; rhs_group != nullptr; rhs_group = rhs_group->next) {
+    for (uint32_t mask = rhs_group->MatchFull(); mask != 0; mask &= mask - 1) {
+      uint32_t idx = __builtin_ctz(mask);
+      new (&group->slots[idx]) Slot(rhs_group->At(idx));
+      group->ctrl[idx] = rhs_group->ctrl[idx];
+    }
+    if (rhs_group->next != nullptr) {
+      group->next = Allocator().template New<Group>();
+      group = group->next;
+    }
+  }
+  size_.store(rhs.size_.load(std::memory_order_acquire), std::memory_order_release);
+  return *this;
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+uint64_t FlatBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::Size() const {
+  return size_.load(std::memory_order_acquire);
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+bool FlatBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::Empty() const {
+  return 0 == size_.load(std::memory_order_acquire);
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+void FlatBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::Clear() {
+  std::lock_guard<Mutex> lock(mutex_);
+  ClearLocked();
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+void FlatBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::ClearLocked() {
+  head_.Destroy();
+  while (head_.next != nullptr) {
+    auto temp = head_.next;
+    head_.next = temp->next;
+    temp->Destroy();
+    Allocator().Delete(temp);
+  }
+  size_.store(0, std::memory_order_release);
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+template <typename K>
+const typename FlatBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::Slot *
+FlatBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::Find(ControlByte tag, const K &key) const {
+  for (const Group *group = &head_; group != nullptr; group = group->next) {
+    for (uint32_t mask = group->Match(tag); mask != 0; mask &= mask - 1) {
+      const Slot &slot = group->At(__builtin_ctz(mask));
+      if (KeysEqual(slot.first, key))
+        return &slot;
+    }
+  }
+  return nullptr;
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+template <typename K>
+std::pair<bool, ValueType>
+FlatBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::Lookup(uint64_t hash, const K &key) const {
+  std::shared_lock<Mutex> lock(mutex_);
+  auto slot = Find(Tag(hash), key);
+  if (slot != nullptr)
+    return {true, slot->second};
+  return {false, ValueType()};
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+bool FlatBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::Insert(uint64_t hash, const KeyType &key,
+                                                                     const ValueType &value) {
+  std::lock_guard<Mutex> lock(mutex_);
+  return InsertLocked(Tag(hash), key, value);
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+bool FlatBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::Insert(uint64_t hash, KeyType &&key, ValueType &&value) {
+  std::lock_guard<Mutex> lock(mutex_);
+  return InsertLocked(Tag(hash), std::move(key), std::move(value));
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+template <typename K, typename V>
+bool FlatBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::InsertLocked(ControlByte tag, K &&key, V &&value) {
+  const bool kWasNewElementCreated = true;
+  auto existing = const_cast<Slot *>(Find(tag, key));
+  if (existing != nullptr) {
+    existing->second = std::forward<V>(value);
+    return !kWasNewElementCreated;
+  }
+  PlaceLocked(tag, std::forward<K>(key), std::forward<V>(value));
+  return kWasNewElementCreated;
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+template <typename K, typename... Args>
+void FlatBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::PlaceLocked(ControlByte tag, K &&key, Args &&... args) {
+  Group *group = &head_;
+  uint32_t empty_mask = group->MatchEmpty();
+  while (0 == empty_mask) {
+    if (group->next == nullptr)
+      group->next = Allocator().template New<Group>();
+    group = group->next;
+    empty_mask = group->MatchEmpty();
+  }
+
+  uint32_t idx = __builtin_ctz(empty_mask);
+  new (&group->slots[idx]) Slot(std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)),
+                                std::forward_as_tuple(std::forward<Args>(args)...));
+  group->ctrl[idx] = tag;
+  size_++;
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+template <typename K, typename Visitor>
+bool FlatBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::Visit(uint64_t hash, const K &key,
+                                                                    Visitor &&visitor) const {
+  std::shared_lock<Mutex> lock(mutex_);
+  auto slot = Find(Tag(hash), key);
+  if (slot == nullptr)
+    return kOperationFailed;
+  visitor(slot->second);
+  return kOperationSuccess;
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+template <typename Updater, typename Creator>
+bool FlatBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::Upsert(uint64_t hash, const KeyType &key,
+                                                                     Updater &&update, Creator &&create) {
+  const bool kWasNewElementCreated = true;
+  const ControlByte kTag = Tag(hash);
+  std::lock_guard<Mutex> lock(mutex_);
+  auto existing = const_cast<Slot *>(Find(kTag, key));
+  if (existing != nullptr) {
+    update(existing->second);
+    return !kWasNewElementCreated;
+  }
+  PlaceLocked(kTag, key, create());
+  return kWasNewElementCreated;
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+template <typename K, typename Updater, typename... Args>
+bool FlatBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::EmplaceOrUpdate(uint64_t hash, K &&key,
+                                                                              Updater &&update, Args &&... args) {
+  const bool kWasNewElementCreated = true;
+  const ControlByte kTag = Tag(hash);
+  std::lock_guard<Mutex> lock(mutex_);
+  auto existing = const_cast<Slot *>(Find(kTag, key));
+  if (existing != nullptr) {
+    update(existing->second);
+    return !kWasNewElementCreated;
+  }
+  PlaceLocked(kTag, std::forward<K>(key), std::forward<Args>(args)...);
+  return kWasNewElementCreated;
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+uint64_t FlatBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::InsertBatch(const BatchItem *items, uint64_t count,
+                                                                             const KeyType *keys,
+                                                                             const ValueType *values) {
+  std::lock_guard<Mutex> lock(mutex_);
+  uint64_t num_inserted = 0;
+  for (uint64_t i = 0; i < count; i++)
+    if (InsertLocked(Tag(items[i].hash), keys[items[i].position], values[items[i].position]))
+      num_inserted++;
+  return num_inserted;
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+void FlatBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::LookupBatch(const BatchItem *items, uint64_t count,
+                                                                         const KeyType *keys,
+                                                                         std::pair<bool, ValueType> *results) const {
+  std::shared_lock<Mutex> lock(mutex_);
+  for (uint64_t i = 0; i < count; i++) {
+    auto slot = Find(Tag(items[i].hash), keys[items[i].position]);
+    results[items[i].position] = slot != nullptr? std::make_pair(true, slot->second)
+                                                 : std::make_pair(false, ValueType());
+  }
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+template <typename K>
+bool FlatBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::Remove(uint64_t hash, const K &key) {
+  std::lock_guard<Mutex> lock(mutex_);
+  const ControlByte kTag = Tag(hash);
+
+  Group *prev = nullptr;
+  for (Group *group = &head_; group != nullptr; prev = group, group = group->next) {
+    for (uint32_t mask = group->Match(kTag); mask != 0; mask &= mask - 1) {
+      uint32_t idx = __builtin_ctz(mask);
+      if (!KeysEqual(group->At(idx).first, key))
+        continue;
+
+      group->At(idx).~Slot();
+      group->ctrl[idx] = kEmpty;
+      size_--;
+      if (prev != nullptr && group->MatchEmpty() == kFullGroupMask) {
+        prev->next = group->next;
+        Allocator().Delete(group);
+      }
+      return kOperationSuccess;
+    }
+  }
+  return kOperationFailed;
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+template <typename Visitor>
+void FlatBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::ForEach(Visitor &&visitor) const {
+  std::shared_lock<Mutex> lock(mutex_);
+  for (const Group *group = &head_; group != nullptr; group = group->next) {
+    for (uint32_t mask = group->MatchFull(); mask != 0; mask &= mask - 1) {
+      const Slot &slot = group->At(__builtin_ctz(mask));
+      visitor(slot.first, slot.second);
+    }
+  }
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+template <typename Predicate>
+uint64_t FlatBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::RemoveIf(Predicate &&predicate) {
+  std::lock_guard<Mutex> lock(mutex_);
+  uint64_t num_removed = 0;
+  Group *prev = nullptr;
+  for (Group *group = &head_; group != nullptr; ) {
+    for (uint32_t mask = group->MatchFull(); mask != 0; mask &= mask - 1) {
+      const uint32_t kIdx = __builtin_ctz(mask);
+      const Slot &slot = group->At(kIdx);
+      if (!predicate(slot.first, slot.second))
+        continue;
+      group->At(kIdx).~Slot();
+      group->ctrl[kIdx] = kEmpty;
+      num_removed++;
+    }
+    Group *next = group->next;
+    if (prev != nullptr && group->MatchEmpty() == kFullGroupMask) {
+      prev->next = next;
+      Allocator().Delete(group);
+    } else {
+      prev = group;
+    }
+    group = next;
+  }
+  size_ -= num_removed;
+  return num_removed;
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+template <typename Hasher, typename Router>
+uint64_t FlatBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::MigrateTo(const Hasher &hasher, const Router &dest) {
+  std::lock_guard<Mutex> lock(mutex_);
+  for (Group *group = &head_; group != nullptr; group = group->next) {
+    for (uint32_t mask = group->MatchFull(); mask != 0; mask &= mask - 1) {
+      Slot &slot = group->At(__builtin_ctz(mask));
+      const uint64_t kHash = hasher(slot.first);
+      auto &bucket = dest(kHash);
+      std::lock_guard<Mutex> dest_lock(bucket.mutex_);
+      bucket.InsertLocked(Tag(kHash), std::move(slot.first), std::move(slot.second));
+    }
+  }
+  const uint64_t kNumItems = size_.load(std::memory_order_acquire);
+  ClearLocked();
+  return kNumItems;
+}
+
+} // namespace internals
+} // namespace my_concurrency
+
+#endif //THREADSAFE_HASHMAP_FLAT_BUCKET_H
@@ -0,0 +1,62 @@
+#ifndef THREADSAFE_HASHMAP_HASH_POLICIES_H
+#define THREADSAFE_HASHMAP_HASH_POLICIES_H
+
+#include <functional> // hash
+#include <inttypes.h>
+#include <string_view>
+
+namespace my_concurrency {
+
+/// @brief Bucket index policy for arbitrary bucket count: the hash is taken as is, index is hash % num_buckets
+struct ModuloIndexing {
+  static uint64_t BucketCount(uint64_t requested) {
+    return requested > 0? requested : 1;
+  }
+
+  static uint64_t Mix(uint64_t hash) {
+    return hash;
+  }
+
+  static uint64_t Index(uint64_t hash, uint64_t num_buckets) {
+    return hash % num_buckets;
+  }
+};
+
+/// @brief Bucket index policy for power of two bucket count: the hash goes through a 64-bit finalizer
+///        (MurmurHash3 fmix64), so masking its low bits is good enough even for identity hashers
+struct PowerOfTwoIndexing {
+  /// @return the smallest power of two not less than requested
+  static uint64_t BucketCount(uint64_t requested) {
+    uint64_t count = 1;
+    while (count < requested)
+      count <<= 1;
+    return count;
+  }
+
+  static uint64_t Mix(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash;
+  }
+
+  static uint64_t Index(uint64_t hash, uint64_t num_buckets) {
+    return hash & (num_buckets - 1);
+  }
+};
+
+/// @brief Transparent hasher of std::string keys: std::string_view, C strings and std::string are hashed as is,
+///        with the same value std::hash<std::string> gives. Pair it with std::equal_to<> for heterogeneous lookup
+struct StringHash {
+  typedef void is_transparent;
+
+  uint64_t operator()(std::string_view key) const {
+    return std::hash<std::string_view>()(key);
+  }
+};
+
+} // namespace my_concurrency
+
+#endif //THREADSAFE_HASHMAP_HASH_POLICIES_H
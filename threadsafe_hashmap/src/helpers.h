@@ -1,9 +1,16 @@
 #ifndef THREADSAFE_HASHMAP_HELPERS_H
 #define THREADSAFE_HASHMAP_HELPERS_H
 
+#include <algorithm> // min, max
+#include <atomic>
+#include <inttypes.h>
 #include <iostream>
+#include <iterator> // iterator_traits
 #include <stdlib.h>
 #include <thread>
+#include <time.h> // clock_gettime
+#include <type_traits>
+#include <vector>
 
 #ifndef NDEBUG
 #define DEBUG(x) do { std::cerr << "DBG: " << x << "\n"; } while (false)
@@ -18,5 +25,103 @@
 #define ERROR(x) do { std::cerr << "ERR: " << __FILE__ << " > " << __func__ << ": " << x << "\n"; \
                       exit(EXIT_FAILURE); } while (false)
 
+#if defined(__GNUC__) || defined(__clang__)
+#define PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define PREFETCH(addr) do {} while (false)
+#endif
+
+namespace my_concurrency {
+namespace internals {
+
+/// @brief Keeps a policy object (allocator, hasher, key comparator) of the owner.
+///        Stateless policies become an empty base and take no space
+/// @tparam kTag distinguishes several policies of the same owner
+template <typename T, int kTag, bool kIsEmpty = std::is_empty<T>::value>
+class PolicyHolder : private T {
+ public:
+  explicit PolicyHolder(const T &policy) : T(policy) { }
+  T &Policy() { return *this; }
+  const T &Policy() const { return *this; }
+};
+
+template <typename T, int kTag>
+class PolicyHolder<T, kTag, false> {
+ public:
+  explicit PolicyHolder(const T &policy) : policy_(policy) { }
+  T &Policy() { return policy_; }
+  const T &Policy() const { return policy_; }
+ private:
+  T policy_;
+};
+
+/// @brief small unique number of the calling thread, used to spread the threads over the shards of a structure
+inline uint64_t ThreadIndex() {
+  static std::atomic<uint64_t> next_thread_index(0);
+  thread_local static uint64_t thread_index = next_thread_index++;
+  return thread_index;
+}
+
+/// @brief splits [0, count) into at most num_threads contiguous ranges of at least min_range elements and calls
+///        operation(begin, end) for each of them. The caller takes the first range, the rest go to new threads
+template <typename Operation>
+void ParallelFor(uint64_t count, uint32_t num_threads, uint64_t min_range, Operation operation) {
+  const uint64_t kMaxRanges = count / std::max<uint64_t>(1, min_range);
+  const uint64_t kNumRanges = std::max<uint64_t>(1, std::min<uint64_t>(num_threads, kMaxRanges));
+  if (1 == kNumRanges) {
+    operation(0, count);
+    return;
+  }
+  std::vector<std::thread> workers;
+  workers.reserve(kNumRanges - 1);
+  for (uint64_t i = 1; i < kNumRanges; i++) {
+    const uint64_t kBegin = count * i / kNumRanges;
+    const uint64_t kEnd = count * (i + 1) / kNumRanges;
+    workers.emplace_back([&operation, kBegin, kEnd]() { operation(kBegin, kEnd); });
+  }
+  operation(0, count / kNumRanges);
+  for (auto &worker : workers)
+    worker.join();
+}
+
+/// @return monotonic milliseconds of CLOCK_MONOTONIC_COARSE. The kernel updates it once per tick and the vDSO reads
+///         it without a syscall, so it costs a few nanoseconds, at the resolution of the tick (1-4 ms)
+inline uint64_t CoarseNowMs() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+  return static_cast<uint64_t>(now.tv_sec) * 1000 + static_cast<uint64_t>(now.tv_nsec) / 1000000;
+}
+
+/// @brief element of a batch operation passed to a bucket: the batches are grouped by bucket
+struct BatchItem {
+  uint64_t bucket; ///< index of the bucket in the table
+  uint64_t hash;
+  uint64_t position; ///< index of the key in the arrays of the caller
+};
+
+/// @brief enables the range constructors for iterators only, so two integers still mean a bucket count and a hasher
+template <typename Iterator>
+using EnableIfIterator = typename std::iterator_traits<Iterator>::iterator_category;
+
+/// @brief true if the policy declares is_transparent, i.e. it accepts other types than the key
+template <typename Policy, typename = void>
+struct IsTransparent : std::false_type { };
+template <typename Policy>
+struct IsTransparent<Policy, std::void_t<typename Policy::is_transparent>> : std::true_type { };
+
+/// @brief enables heterogeneous overloads for key type K when both the hasher and the key predicate are transparent
+template <typename Hasher, typename KeyEqual, typename K>
+using EnableIfTransparent =
+    typename std::enable_if<IsTransparent<Hasher>::value && IsTransparent<KeyEqual>::value, K>::type;
+
+/// @brief updater of the buckets which leaves the existing value as is, so they may skip the update entirely
+struct KeepValue {
+  template <typename ValueType>
+  void operator()(ValueType &) const { }
+};
+
+} // namespace internals
+} // namespace my_concurrency
+
 
 #endif //THREADSAFE_HASHMAP_HELPERS_H
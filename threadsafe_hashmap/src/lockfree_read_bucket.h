@@ -0,0 +1,433 @@
+#ifndef THREADSAFE_HASHMAP_LOCKFREE_READ_BUCKET_H
+#define THREADSAFE_HASHMAP_LOCKFREE_READ_BUCKET_H
+
+#include <atomic>
+#include <functional>
+#include <inttypes.h>
+#include <mutex>
+#include <type_traits>
+#include <utility> // pair
+
+#include "epoch_reclamation.h"
+#include "helpers.h"
+#include "map_stats.h"
+#include "node_allocator.h"
+
+namespace my_concurrency {
+namespace internals {
+
+/// @brief Bucket with lock-free readers and serialized writers based on single linked list.
+///        Readers only pin the epoch and walk the list with acquire loads, so they never write shared memory
+///        except their own epoch record. Published nodes are immutable: writers replace a node instead of
+///        overwriting its value and retire unlinked nodes to the EpochDomain.
+/// @tparam ValueType should have default constructor in order to lookup non-existing elements
+/// @tparam NodeAllocator only HeapNodeAllocator: retired nodes are deleted by the EpochDomain
+/// @tparam KeyEqual equality predicate of the keys
+template <typename KeyType, typename ValueType, typename NodeAllocator = HeapNodeAllocator,
+          typename KeyEqual = std::equal_to<KeyType>>
+class LockFreeReadBucket : private PolicyHolder<KeyEqual, 1> {
+  static_assert(std::is_same<NodeAllocator, HeapNodeAllocator>::value,
+                "retired nodes are deleted by the EpochDomain, so they must come from the heap");
+ public:
+  explicit LockFreeReadBucket(const NodeAllocator & = NodeAllocator(), const KeyEqual &key_equal = KeyEqual())
+      : KeyEqualHolder(key_equal), head_(nullptr), size_(0) { }
+
+  /// @brief snapshot copy
+  LockFreeReadBucket(const LockFreeReadBucket &rhs);
+
+  /// @brief no reader can use the bucket being destroyed, so the nodes are deleted immediately
+  ~LockFreeReadBucket();
+
+  uint64_t Size() const;
+  /// @brief contended acquisitions of the writer lock, zeros unless the mutex counts them. The readers never wait
+  LockWaitStats WaitStats() const { return WaitsOf(writer_mutex_); }
+  bool Empty() const;
+
+  /// @brief Remove all elements in the list
+  void Clear();
+
+  /// @brief add key-value pair to the list. Rewrites value in case the key already exists
+  /// @return true if new element was inserted, false if a node was replaced
+  bool Insert(const KeyType &key, const ValueType &value);
+
+  /// @tparam K KeyType or any type the KeyEqual compares with the keys, e.g. std::string_view
+  /// @return true in case successful removal, false in case no such key in the list
+  template <typename K>
+  bool Remove(const K &key);
+
+  /// @brief lock-free lookup
+  /// @return pair: first part is true if element with such key exists in the list, false otherwise
+  ///               second part is a value
+  template <typename K>
+  std::pair<bool, ValueType> Lookup(const K &key) const;
+
+  /// @brief lock-free visit: calls visitor(const ValueType &) for the published node within an epoch pin
+  /// @return true if element with such key exists in the list
+  template <typename K, typename Visitor>
+  bool Visit(const K &key, Visitor &&visitor) const;
+
+  /// @brief read-modify-write under the writer lock. Published nodes are immutable, so update(ValueType &)
+  ///        gets a copy of the value which replaces the node; otherwise the value returned by create() is inserted
+  /// @return true if new element was inserted
+  template <typename Updater, typename Creator>
+  bool Upsert(const KeyType &key, Updater &&update, Creator &&create);
+
+  /// @brief hash-aware overloads used by the owner table. The list doesn't need the hash
+  bool Insert(uint64_t, const KeyType &key, const ValueType &value) { return Insert(key, value); }
+  template <typename K>
+  bool Remove(uint64_t, const K &key) { return Remove(key); }
+  template <typename K>
+  std::pair<bool, ValueType> Lookup(uint64_t, const K &key) const { return Lookup(key); }
+  template <typename K, typename Visitor>
+  bool Visit(uint64_t, const K &key, Visitor &&visitor) const { return Visit(key, visitor); }
+  template <typename Updater, typename Creator>
+  bool Upsert(uint64_t, const KeyType &key, Updater &&update, Creator &&create) { return Upsert(key, update, create); }
+  template <typename K, typename Updater, typename... Args>
+  bool EmplaceOrUpdate(uint64_t, K &&key, Updater &&update, Args &&... args) {
+    return EmplaceOrUpdateImpl(std::forward<K>(key), update, std::forward<Args>(args)...);
+  }
+
+  /// @brief inserts the batch under one exclusive lock. Rewrites values in case the keys already exist
+  /// @param items elements of this bucket: keys[item.position] and values[item.position] are inserted in order
+  /// @return number of new elements
+  uint64_t InsertBatch(const BatchItem *items, uint64_t count, const KeyType *keys, const ValueType *values);
+
+  /// @brief lock-free lookup of the batch within one epoch pin
+  /// @param results receives the result of keys[item.position] at the same position
+  void LookupBatch(const BatchItem *items, uint64_t count, const KeyType *keys,
+                   std::pair<bool, ValueType> *results) const;
+
+  /// @brief makes a snapshot full copy of the other bucket
+  LockFreeReadBucket &operator=(const LockFreeReadBucket &rhs);
+
+  /// @brief calls visitor(const KeyType &, const ValueType &) for every element under the writer lock:
+  ///        the writers of the bucket wait, the readers don't
+  template <typename Visitor>
+  void ForEach(Visitor &&visitor) const;
+
+  /// @brief removes the elements for which predicate(const KeyType &, const ValueType &) is true under the writer lock
+  /// @return number of removed elements
+  template <typename Predicate>
+  uint64_t RemoveIf(Predicate &&predicate);
+
+  /// @brief Copies all of the items to different buckets obtained by dest function and retires the originals.
+  ///        Nodes are not relinked: a reader walking this list must never be diverted into another one
+  /// @param hasher returns the same hash the owner passes to Insert
+  /// @param dest function returns appropriate bucket according to the hash of the key
+  /// @returns number of items were migrated
+  template <typename Hasher, typename Router>
+  uint64_t MigrateTo(const Hasher &hasher, const Router &dest);
+
+  constexpr static uint64_t kSlotsPerBucket = 1; ///< nominal capacity used by the owner for load factor
+  constexpr static bool kLockedVisit = false; ///< Visit reads a node which a writer may replace meanwhile
+  constexpr static bool kOperationSuccess = true;
+  constexpr static bool kOperationFailed = false;
+ private:
+  /// @brief hashless EmplaceOrUpdate, not public: it is ambiguous with the hash-aware one for uint64_t keys.
+  ///        Calls update(ValueType &) for a copy of the existing value which replaces the node, otherwise
+  ///        constructs the node from the forwarded key and args. Requires no lock
+  /// @return true if new element was inserted
+  template <typename K, typename Updater, typename... Args>
+  bool EmplaceOrUpdateImpl(K &&key, Updater &&update, Args &&... args);
+
+  struct ListNode {
+    const KeyType key;
+    const ValueType value;
+    std::atomic<ListNode *> next;
+
+    template <typename K, typename... Args>
+    explicit ListNode(ListNode *next, K &&key, Args &&... args)
+        : key(std::forward<K>(key)), value(std::forward<Args>(args)...), next(next) { }
+    ListNode(const ListNode &) = delete;
+    ListNode &operator=(const ListNode &) = delete;
+  };
+
+  typedef PolicyHolder<KeyEqual, 1> KeyEqualHolder;
+
+  template <typename K>
+  bool KeysEqual(const KeyType &lhs, const K &rhs) const { return KeyEqualHolder::Policy()(lhs, rhs); }
+
+  /// @brief unlinks and retires all of the nodes. Requires writer lock
+  void ClearLocked();
+
+  /// @brief places a copy of the pair into the list. Requires writer lock
+  /// @return true if new element was inserted, false if a node was replaced
+  bool InsertLocked(const KeyType &key, const ValueType &value);
+
+  typedef StatsMutex<std::mutex> WriterMutex;
+
+  mutable WriterMutex writer_mutex_;
+  std::atomic<ListNode *> head_;
+  std::atomic_ullong size_;
+};
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+LockFreeReadBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::LockFreeReadBucket(const LockFreeReadBucket &rhs)
+    : KeyEqualHolder(rhs), head_(nullptr), size_(0) {
+  *this = rhs;
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+LockFreeReadBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::~LockFreeReadBucket() {
+  auto node = head_.load(std::memory_order_acquire);
+  while (node != nullptr) {
+    auto temp = node;
+    node = node->next.load(std::memory_order_relaxed);
+    delete temp;
+  }
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+LockFreeReadBucket<KeyType, ValueType, NodeAllocator, KeyEqual> &
+LockFreeReadBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::operator=(const LockFreeReadBucket &rhs) {
+  if (this == &rhs)
+    return *this;
+  std::lock_guard<WriterMutex> lock(writer_mutex_);
+  ClearLocked();
+
+  EpochGuard guard;
+  ListNode *tail = nullptr;
+  uint64_t size = 0;
+  for (auto node = rhs.head_.load(std::memory_order_acquire); node != nullptr;
+       node = node->next.load(std::memory_order_acquire)) {
+    auto new_node = new ListNode(nullptr, node->key, node->value);
+    if (tail == nullptr)
+      head_.store(new_node, std::memory_order_release);
+    else
+      tail->next.store(new_node, std::memory_order_release);
+    tail = new_node;
+    size++;
+  }
+  size_.store(size, std::memory_order_release);
+  return *this;
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+uint64_t LockFreeReadBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::Size() const {
+  return size_.load(std::memory_order_acquire);
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+bool LockFreeReadBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::Empty() const {
+  return 0 == size_.load(std::memory_order_acquire);
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+void LockFreeReadBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::Clear() {
+  std::lock_guard<WriterMutex> lock(writer_mutex_);
+  ClearLocked();
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+void LockFreeReadBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::ClearLocked() {
+  auto node = head_.exchange(nullptr, std::memory_order_acq_rel);
+  size_.store(0, std::memory_order_release);
+  while (node != nullptr) {
+    auto temp = node;
+    node = node->next.load(std::memory_order_relaxed);
+    EpochDomain::Instance().Retire(temp);
+  }
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+template <typename K>
+std::pair<bool, ValueType>
+LockFreeReadBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::Lookup(const K &key) const {
+  EpochGuard guard;
+  for (auto node = head_.load(std::memory_order_acquire); node != nullptr;
+       node = node->next.load(std::memory_order_acquire))
+    if (KeysEqual(node->key, key))
+      return {true, node->value};
+
+  return {false, ValueType()};
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+bool LockFreeReadBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::Insert(const KeyType &key,
+                                                                             const ValueType &value) {
+  std::lock_guard<WriterMutex> lock(writer_mutex_);
+  return InsertLocked(key, value);
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+bool LockFreeReadBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::InsertLocked(const KeyType &key,
+                                                                                   const ValueType &value) {
+  const bool kWasNewElementCreated = true;
+  std::atomic<ListNode *> *link = &head_;
+  for (auto node = link->load(std::memory_order_relaxed); node != nullptr;
+       node = link->load(std::memory_order_relaxed)) {
+    if (KeysEqual(node->key, key)) {
+      auto new_node = new ListNode(node->next.load(std::memory_order_relaxed), key, value);
+      link->store(new_node, std::memory_order_release);
+      EpochDomain::Instance().Retire(node);
+      return !kWasNewElementCreated;
+    }
+    link = &node->next;
+  }
+
+  head_.store(new ListNode(head_.load(std::memory_order_relaxed), key, value), std::memory_order_release);
+  size_++;
+  return kWasNewElementCreated;
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+template <typename K, typename Visitor>
+bool LockFreeReadBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::Visit(const K &key, Visitor &&visitor) const {
+  EpochGuard guard;
+  for (auto node = head_.load(std::memory_order_acquire); node != nullptr;
+       node = node->next.load(std::memory_order_acquire))
+    if (KeysEqual(node->key, key)) {
+      visitor(node->value);
+      return kOperationSuccess;
+    }
+  return kOperationFailed;
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+template <typename Updater, typename Creator>
+bool LockFreeReadBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::Upsert(const KeyType &key, Updater &&update,
+                                                                            Creator &&create) {
+  const bool kWasNewElementCreated = true;
+  std::lock_guard<WriterMutex> lock(writer_mutex_);
+  std::atomic<ListNode *> *link = &head_;
+  for (auto node = link->load(std::memory_order_relaxed); node != nullptr;
+       node = link->load(std::memory_order_relaxed)) {
+    if (KeysEqual(node->key, key)) {
+      if (std::is_same<typename std::decay<Updater>::type, KeepValue>::value)
+        return !kWasNewElementCreated;
+      ValueType value(node->value);
+      update(value);
+      link->store(new ListNode(node->next.load(std::memory_order_relaxed), key, std::move(value)),
+                  std::memory_order_release);
+      EpochDomain::Instance().Retire(node);
+      return !kWasNewElementCreated;
+    }
+    link = &node->next;
+  }
+
+  head_.store(new ListNode(head_.load(std::memory_order_relaxed), key, create()), std::memory_order_release);
+  size_++;
+  return kWasNewElementCreated;
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+template <typename K, typename Updater, typename... Args>
+bool LockFreeReadBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::EmplaceOrUpdateImpl(K &&key, Updater &&update,
+                                                                                         Args &&... args) {
+  const bool kWasNewElementCreated = true;
+  std::lock_guard<WriterMutex> lock(writer_mutex_);
+  std::atomic<ListNode *> *link = &head_;
+  for (auto node = link->load(std::memory_order_relaxed); node != nullptr;
+       node = link->load(std::memory_order_relaxed)) {
+    if (KeysEqual(node->key, key)) {
+      if (std::is_same<typename std::decay<Updater>::type, KeepValue>::value)
+        return !kWasNewElementCreated;
+      ValueType value(node->value);
+      update(value);
+      link->store(new ListNode(node->next.load(std::memory_order_relaxed), node->key, std::move(value)),
+                  std::memory_order_release);
+      EpochDomain::Instance().Retire(node);
+      return !kWasNewElementCreated;
+    }
+    link = &node->next;
+  }
+
+  head_.store(new ListNode(head_.load(std::memory_order_relaxed), std::forward<K>(key), std::forward<Args>(args)...),
+              std::memory_order_release);
+  size_++;
+  return kWasNewElementCreated;
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+uint64_t LockFreeReadBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::InsertBatch(
+    const BatchItem *items, uint64_t count, const KeyType *keys, const ValueType *values) {
+  std::lock_guard<WriterMutex> lock(writer_mutex_);
+  uint64_t num_inserted = 0;
+  for (uint64_t i = 0; i < count; i++)
+    if (InsertLocked(keys[items[i].position], values[items[i].position]))
+      num_inserted++;
+  return num_inserted;
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+void LockFreeReadBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::LookupBatch(
+    const BatchItem *items, uint64_t count, const KeyType *keys, std::pair<bool, ValueType> *results) const {
+  EpochGuard guard;
+  for (uint64_t i = 0; i < count; i++) {
+    const KeyType &key = keys[items[i].position];
+    auto node = head_.load(std::memory_order_acquire);
+    while (node != nullptr && !KeysEqual(node->key, key))
+      node = node->next.load(std::memory_order_acquire);
+    results[items[i].position] = node != nullptr? std::make_pair(true, node->value)
+                                                 : std::make_pair(false, ValueType());
+  }
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+template <typename K>
+bool LockFreeReadBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::Remove(const K &key) {
+  std::lock_guard<WriterMutex> lock(writer_mutex_);
+  std::atomic<ListNode *> *link = &head_;
+  for (auto node = link->load(std::memory_order_relaxed); node != nullptr;
+       node = link->load(std::memory_order_relaxed)) {
+    if (KeysEqual(node->key, key)) {
+      link->store(node->next.load(std::memory_order_relaxed), std::memory_order_release);
+      size_--;
+      EpochDomain::Instance().Retire(node);
+      return kOperationSuccess;
+    }
+    link = &node->next;
+  }
+  return kOperationFailed;
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+template <typename Visitor>
+void LockFreeReadBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::ForEach(Visitor &&visitor) const {
+  std::lock_guard<WriterMutex> lock(writer_mutex_);
+  for (auto node = head_.load(std::memory_order_acquire); node != nullptr;
+       node = node->next.load(std::memory_order_acquire))
+    visitor(node->key, node->value);
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+template <typename Predicate>
+uint64_t LockFreeReadBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::RemoveIf(Predicate &&predicate) {
+  std::lock_guard<WriterMutex> lock(writer_mutex_);
+  uint64_t num_removed = 0;
+  std::atomic<ListNode *> *link = &head_;
+  for (auto node = link->load(std::memory_order_relaxed); node != nullptr;
+       node = link->load(std::memory_order_relaxed)) {
+    if (predicate(static_cast<const KeyType &>(node->key), static_cast<const ValueType &>(node->value))) {
+      link->store(node->next.load(std::memory_order_relaxed), std::memory_order_release);
+      EpochDomain::Instance().Retire(node);
+      num_removed++;
+    } else {
+      link = &node->next;
+    }
+  }
+  size_ -= num_removed;
+  return num_removed;
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+template <typename Hasher, typename Router>
+uint64_t LockFreeReadBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::MigrateTo(const Hasher &hasher,
+                                                                                   const Router &dest) {
+  std::lock_guard<WriterMutex> lock(writer_mutex_);
+  // copies are published before the originals get unlinked, so a reader which misses the key here finds it there
+  for (auto node = head_.load(std::memory_order_relaxed); node != nullptr;
+       node = node->next.load(std::memory_order_relaxed)) {
+    auto &bucket = dest(hasher(node->key));
+    std::lock_guard<WriterMutex> dest_lock(bucket.writer_mutex_);
+    bucket.InsertLocked(node->key, node->value);
+  }
+  const uint64_t kNumItems = size_.load(std::memory_order_acquire);
+  ClearLocked();
+  return kNumItems;
+}
+
+} // namespace internals
+} // namespace my_concurrency
+
+#endif //THREADSAFE_HASHMAP_LOCKFREE_READ_BUCKET_H
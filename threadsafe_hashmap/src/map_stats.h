@@ -0,0 +1,110 @@
+#ifndef THREADSAFE_HASHMAP_MAP_STATS_H
+#define THREADSAFE_HASHMAP_MAP_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <inttypes.h>
+#include <type_traits> // conditional
+
+namespace my_concurrency {
+namespace internals {
+
+/// @brief THREADSAFE_HASHMAP_STATS turns on the counters which cost time on the hot paths: the lock waits and
+///        the sizes of the migration steps. Without it the locks are the plain mutexes, and the statistics
+///        which are gathered by a traversal (chain lengths, empty buckets, resize timestamps) stay available
+#ifdef THREADSAFE_HASHMAP_STATS
+constexpr bool kCollectStats = true;
+#else
+constexpr bool kCollectStats = false;
+#endif
+
+/// @brief acquisitions which did not get the lock at once and the total time they waited
+struct LockWaitStats {
+  uint64_t count = 0;
+  uint64_t wait_ns = 0;
+
+  LockWaitStats &operator+=(const LockWaitStats &rhs) {
+    count += rhs.count;
+    wait_ns += rhs.wait_ns;
+    return *this;
+  }
+};
+
+/// @brief Wraps a mutex (exclusive or shared) and counts its contended acquisitions: the lock is tried first,
+///        only a failed try reads the clock. The uncontended path costs one try_lock as before
+template <typename Mutex>
+class InstrumentedMutex {
+ public:
+  InstrumentedMutex() = default;
+  InstrumentedMutex(const InstrumentedMutex &) = delete;
+  InstrumentedMutex &operator=(const InstrumentedMutex &) = delete;
+
+  void lock() {
+    if (mutex_.try_lock())
+      return;
+    const auto kStart = std::chrono::steady_clock::now();
+    mutex_.lock();
+    RecordWait(kStart);
+  }
+
+  bool try_lock() { return mutex_.try_lock(); }
+  void unlock() { mutex_.unlock(); }
+
+  void lock_shared() {
+    if (mutex_.try_lock_shared())
+      return;
+    const auto kStart = std::chrono::steady_clock::now();
+    mutex_.lock_shared();
+    RecordWait(kStart);
+  }
+
+  bool try_lock_shared() { return mutex_.try_lock_shared(); }
+  void unlock_shared() { mutex_.unlock_shared(); }
+
+  LockWaitStats Waits() const {
+    LockWaitStats result;
+    result.count = waits_.load(std::memory_order_relaxed);
+    result.wait_ns = wait_ns_.load(std::memory_order_relaxed);
+    return result;
+  }
+
+ private:
+  void RecordWait(std::chrono::steady_clock::time_point start) {
+    waits_.fetch_add(1, std::memory_order_relaxed);
+    wait_ns_.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+  }
+
+  Mutex mutex_;
+  std::atomic<uint64_t> waits_{0};
+  std::atomic<uint64_t> wait_ns_{0};
+};
+
+/// @brief the mutex of the buckets and of the table state: counted in the statistics mode, plain otherwise
+template <typename Mutex>
+using StatsMutex = typename std::conditional<kCollectStats, InstrumentedMutex<Mutex>, Mutex>::type;
+
+/// @return the contended acquisitions of the mutex, zeros if it does not count them
+template <typename Mutex>
+LockWaitStats WaitsOf(const Mutex &) {
+  return LockWaitStats();
+}
+
+template <typename Mutex>
+LockWaitStats WaitsOf(const InstrumentedMutex<Mutex> &mutex) {
+  return mutex.Waits();
+}
+
+/// @return slot of the power-of-two histogram: 0 for zero, i for the values in [2^(i-1), 2^i), the last slot
+///         takes the bigger values too
+inline uint32_t HistogramSlot(uint64_t value, uint32_t num_slots) {
+  uint32_t slot = 0;
+  for (; value != 0 && slot + 1 < num_slots; value >>= 1)
+    slot++;
+  return slot;
+}
+
+} // namespace internals
+} // namespace my_concurrency
+
+#endif //THREADSAFE_HASHMAP_MAP_STATS_H
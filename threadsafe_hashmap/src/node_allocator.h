@@ -0,0 +1,199 @@
+#ifndef THREADSAFE_HASHMAP_NODE_ALLOCATOR_H
+#define THREADSAFE_HASHMAP_NODE_ALLOCATOR_H
+
+#include <algorithm> // max
+#include <atomic>
+#include <cstddef> // max_align_t
+#include <inttypes.h>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility> // forward
+#include <vector>
+
+#include "helpers.h"
+
+namespace my_concurrency {
+namespace internals {
+
+/// @brief Default node allocator of the buckets: every node comes from the global heap.
+///        Node allocators are cheap handles, buckets keep a copy of the one of their owner table
+class HeapNodeAllocator {
+ public:
+  template <typename Node, typename... Args>
+  Node *New(Args &&... args) {
+    return new Node(std::forward<Args>(args)...);
+  }
+
+  template <typename Node>
+  void Delete(Node *node) {
+    delete node;
+  }
+};
+
+/// @brief Storage for fixed-size nodes carved from big slabs.
+///        Free nodes are kept in kNumShards free lists; a thread always works with the same shard,
+///        so concurrent writers rarely meet on the same lock. Slabs are released with the arena only
+class SlabArena {
+ public:
+  struct Stats {
+    uint64_t slabs_in_use = 0;
+    uint64_t free_list_length = 0; ///< released nodes ready for reuse
+    uint64_t nodes_in_use = 0;
+  };
+
+  /// @param nodes_per_slab amount of nodes allocated from the heap at once
+  explicit SlabArena(uint64_t nodes_per_slab = kDefaultNodesPerSlab)
+      : nodes_per_slab_(nodes_per_slab), node_size_(0) { }
+  ~SlabArena();
+
+  /// @brief all of the allocations of one arena must have the same size
+  void *Allocate(size_t node_size);
+  void Deallocate(void *node);
+
+  Stats GetStats() const;
+
+  constexpr static uint64_t kNumShards = 16;
+  constexpr static uint64_t kDefaultNodesPerSlab = 1024;
+ private:
+  SlabArena(const SlabArena &) = delete;
+  SlabArena &operator=(const SlabArena &) = delete;
+
+  struct FreeNode {
+    FreeNode *next;
+  };
+
+  struct Shard {
+    mutable std::mutex mutex;
+    FreeNode *free_list = nullptr;
+    uint64_t free_list_length = 0;
+    char *slab_cursor = nullptr; ///< never used part of the last slab of the shard
+    char *slab_end = nullptr;
+    uint64_t num_allocated = 0;
+    uint64_t num_released = 0;
+    char padding[64]; ///< keeps shards in different cache lines
+  };
+
+  Shard &LocalShard();
+  /// @brief takes a new slab for the shard. Requires the lock of the shard
+  void RefillShard(Shard &shard);
+
+  const uint64_t nodes_per_slab_;
+  std::atomic<size_t> node_size_;
+  Shard shards_[kNumShards];
+  mutable std::mutex slabs_mutex_;
+  std::vector<char *> slabs_;
+};
+
+/// @brief Node allocator which serves all of the buckets of a map from one SlabArena.
+///        Copies share the arena, so nodes may be relinked between buckets of the same map
+class SlabNodeAllocator {
+ public:
+  /// @param nodes_per_slab amount of nodes allocated from the heap at once
+  explicit SlabNodeAllocator(uint64_t nodes_per_slab = SlabArena::kDefaultNodesPerSlab)
+      : arena_(std::make_shared<SlabArena>(nodes_per_slab)) { }
+
+  template <typename Node, typename... Args>
+  Node *New(Args &&... args) {
+    static_assert(alignof(Node) <= alignof(std::max_align_t), "over-aligned nodes are not supported");
+    void *memory = arena_->Allocate(sizeof(Node));
+    try {
+      return new (memory) Node(std::forward<Args>(args)...);
+    } catch (...) {
+      arena_->Deallocate(memory);
+      throw;
+    }
+  }
+
+  template <typename Node>
+  void Delete(Node *node) {
+    node->~Node();
+    arena_->Deallocate(node);
+  }
+
+  SlabArena::Stats Stats() const {
+    return arena_->GetStats();
+  }
+
+ private:
+  std::shared_ptr<SlabArena> arena_;
+};
+
+inline SlabArena::~SlabArena() {
+  for (auto slab : slabs_)
+    ::operator delete(slab);
+}
+
+inline SlabArena::Shard &SlabArena::LocalShard() {
+  return shards_[ThreadIndex() % kNumShards];
+}
+
+inline void SlabArena::RefillShard(Shard &shard) {
+  const size_t kNodeSize = node_size_.load(std::memory_order_relaxed);
+  auto slab = static_cast<char *>(::operator new(kNodeSize * nodes_per_slab_));
+  {
+    std::lock_guard<std::mutex> lock(slabs_mutex_);
+    slabs_.push_back(slab);
+  }
+  shard.slab_cursor = slab;
+  shard.slab_end = slab + kNodeSize * nodes_per_slab_;
+}
+
+inline void *SlabArena::Allocate(size_t node_size) {
+  // every node is aligned as the slab itself
+  const size_t kAlignedSize = (std::max(node_size, sizeof(FreeNode)) + alignof(std::max_align_t) - 1)
+      / alignof(std::max_align_t) * alignof(std::max_align_t);
+  size_t expected = 0;
+  if (!node_size_.compare_exchange_strong(expected, kAlignedSize, std::memory_order_relaxed)
+      && expected != kAlignedSize)
+    ERROR("SlabArena serves nodes of " << expected << " bytes, requested " << kAlignedSize);
+
+  auto &shard = LocalShard();
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  shard.num_allocated++;
+  if (shard.free_list != nullptr) {
+    auto node = shard.free_list;
+    shard.free_list = node->next;
+    shard.free_list_length--;
+    return node;
+  }
+
+  if (shard.slab_cursor == shard.slab_end)
+    RefillShard(shard);
+  auto node = shard.slab_cursor;
+  shard.slab_cursor += kAlignedSize;
+  return node;
+}
+
+inline void SlabArena::Deallocate(void *node) {
+  auto &shard = LocalShard();
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto free_node = static_cast<FreeNode *>(node);
+  free_node->next = shard.free_list;
+  shard.free_list = free_node;
+  shard.free_list_length++;
+  shard.num_released++;
+}
+
+inline SlabArena::Stats SlabArena::GetStats() const {
+  Stats stats;
+  uint64_t num_allocated = 0;
+  uint64_t num_released = 0;
+  for (auto &shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    stats.free_list_length += shard.free_list_length;
+    num_allocated += shard.num_allocated;
+    num_released += shard.num_released;
+  }
+  // a node may be released to another shard, so only the sums are meaningful
+  stats.nodes_in_use = num_allocated - num_released;
+
+  std::lock_guard<std::mutex> lock(slabs_mutex_);
+  stats.slabs_in_use = slabs_.size();
+  return stats;
+}
+
+} // namespace internals
+} // namespace my_concurrency
+
+#endif //THREADSAFE_HASHMAP_NODE_ALLOCATOR_H
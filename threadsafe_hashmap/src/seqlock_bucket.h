@@ -0,0 +1,496 @@
+#ifndef THREADSAFE_HASHMAP_SEQLOCK_BUCKET_H
+#define THREADSAFE_HASHMAP_SEQLOCK_BUCKET_H
+
+#include <atomic>
+#include <cstring> // memcpy
+#include <functional>
+#include <inttypes.h>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility> // pair
+
+#include "bucket.h"
+#include "helpers.h"
+#include "map_stats.h"
+#include "node_allocator.h"
+#include "spin_lock.h"
+
+namespace my_concurrency {
+namespace internals {
+
+/// @brief Bucket of trivially copyable keys and values with optimistic readers: a lookup writes nothing to the shared
+///        memory. It copies the slots out without a lock and retries if the sequence counter shows a writer in
+///        between. Writers are serialized by a spin lock and make the counter odd for the time of the change.
+///        Elements are kept in groups of kGroupSize slots, the first group is inline. A reader may walk any group
+///        at any time, so the overflow groups are reused but released by the destructor only
+/// @tparam NodeAllocator source of the overflow groups
+/// @tparam KeyEqual equality predicate of the keys, it may see a torn copy of a key which is thrown away later
+template <typename KeyType, typename ValueType, typename NodeAllocator = HeapNodeAllocator,
+          typename KeyEqual = std::equal_to<KeyType>>
+class SeqLockBucket : private PolicyHolder<NodeAllocator, 0>, private PolicyHolder<KeyEqual, 1> {
+  static_assert(std::is_trivially_copyable<KeyType>::value && std::is_trivially_copyable<ValueType>::value,
+                "the readers copy the slots while they may be changed, so the elements must be trivially copyable");
+ public:
+  explicit SeqLockBucket(const NodeAllocator &allocator = NodeAllocator(), const KeyEqual &key_equal = KeyEqual())
+      : AllocatorHolder(allocator), KeyEqualHolder(key_equal) { }
+
+  /// @brief snapshot copy: requires full lock. The copy shares the allocator and the predicate
+  SeqLockBucket(const SeqLockBucket &rhs);
+  ~SeqLockBucket();
+
+  uint64_t Size() const;
+  /// @brief contended acquisitions of the writer lock, zeros unless the mutex counts them
+  LockWaitStats WaitStats() const { return WaitsOf(mutex_); }
+  bool Empty() const;
+
+  /// @brief Remove all elements in the bucket. The overflow groups are kept for reuse
+  void Clear();
+
+  /// @brief add key-value pair to the bucket. Rewrites value in case the key already exists
+  /// @return true if new element was inserted, false if a slot was overwritten
+  bool Insert(uint64_t hash, const KeyType &key, const ValueType &value);
+
+  /// @return true in case successful removal, false in case no such key in the bucket
+  template <typename K>
+  bool Remove(uint64_t hash, const K &key);
+
+  /// @brief optimistic lookup, falls back to the writer lock after kMaxOptimisticAttempts failed validations
+  /// @return pair: first part is true if element with such key exists in the bucket, false otherwise
+  ///               second part is a value
+  template <typename K>
+  std::pair<bool, ValueType> Lookup(uint64_t hash, const K &key) const;
+
+  /// @brief calls visitor(const ValueType &) with the validated copy of the value
+  /// @return true if element with such key exists in the bucket
+  template <typename K, typename Visitor>
+  bool Visit(uint64_t hash, const K &key, Visitor &&visitor) const;
+
+  /// @brief read-modify-write under the writer lock: calls update(ValueType &) for the existing element,
+  ///        otherwise inserts the value returned by create()
+  /// @return true if new element was inserted
+  template <typename Updater, typename Creator>
+  bool Upsert(uint64_t hash, const KeyType &key, Updater &&update, Creator &&create);
+
+  /// @brief calls update(ValueType &) for the existing element under the writer lock, otherwise constructs
+  ///        the element in a free slot from the forwarded key and args
+  /// @return true if new element was inserted
+  template <typename K, typename Updater, typename... Args>
+  bool EmplaceOrUpdate(uint64_t hash, K &&key, Updater &&update, Args &&... args);
+
+  /// @brief inserts the batch under one writer lock. Rewrites values in case the keys already exist
+  /// @return number of new elements
+  uint64_t InsertBatch(const BatchItem *items, uint64_t count, const KeyType *keys, const ValueType *values);
+
+  /// @brief looks every key of the batch up optimistically
+  /// @param results receives the result of keys[item.position] at the same position
+  void LookupBatch(const BatchItem *items, uint64_t count, const KeyType *keys,
+                   std::pair<bool, ValueType> *results) const;
+
+  /// @brief makes a snapshot full copy of the other bucket
+  SeqLockBucket &operator=(const SeqLockBucket &rhs);
+
+  /// @brief calls visitor(const KeyType &, const ValueType &) for every element under the writer lock:
+  ///        the writers of the bucket wait, the optimistic readers don't
+  template <typename Visitor>
+  void ForEach(Visitor &&visitor) const;
+
+  /// @brief removes the elements for which predicate(const KeyType &, const ValueType &) is true under the writer lock
+  /// @return number of removed elements
+  template <typename Predicate>
+  uint64_t RemoveIf(Predicate &&predicate);
+
+  /// @brief Moves all of the items to different buckets obtained by dest function
+  /// @param hasher returns the same hash the owner passes to Insert
+  /// @param dest returns appropriate bucket according to the hash of the key
+  /// @returns number of items were migrated
+  template <typename Hasher, typename Router>
+  uint64_t MigrateTo(const Hasher &hasher, const Router &dest);
+
+  constexpr static uint64_t kGroupSize = 8;
+  constexpr static uint64_t kSlotsPerBucket = kGroupSize; ///< nominal capacity used by the owner for load factor
+  constexpr static uint32_t kMaxOptimisticAttempts = 16;
+  constexpr static bool kLockedVisit = false; ///< Visit passes a validated copy of the value
+
+  constexpr static bool kOperationSuccess = true;
+  constexpr static bool kOperationFailed = false;
+ private:
+  /// @brief unlike std::pair it is trivially copyable
+  struct Slot {
+    KeyType first;
+    ValueType second;
+  };
+  typedef typename std::aligned_storage<sizeof(Slot), alignof(Slot)>::type SlotStorage;
+
+  struct Group {
+    std::atomic<uint32_t> full_mask{0}; ///< bit per occupied slot
+    std::atomic<Group *> next{nullptr};
+    SlotStorage slots[kGroupSize];
+
+    Group() = default;
+    Group(const Group &) = delete;
+    Group &operator=(const Group &) = delete;
+
+    Slot &At(uint32_t idx) { return *reinterpret_cast<Slot *>(&slots[idx]); }
+    const Slot &At(uint32_t idx) const { return *reinterpret_cast<const Slot *>(&slots[idx]); }
+  };
+
+  /// @brief exclusive access of a writer: the sequence is odd while it lasts, so the overlapping readers retry
+  class WriteSection {
+   public:
+    explicit WriteSection(const SeqLockBucket &bucket);
+    ~WriteSection();
+    WriteSection(const WriteSection &) = delete;
+    WriteSection &operator=(const WriteSection &) = delete;
+   private:
+    const SeqLockBucket &bucket_;
+  };
+
+  /// @brief copies the value of the key out of the bucket without taking the lock
+  /// @return true if the key is present
+  template <typename K>
+  bool ReadValue(const K &key, ValueType &value) const;
+
+  /// @return pointer to the slot with such key or nullptr. Requires the writer lock
+  template <typename K>
+  Slot *FindLocked(const K &key) const;
+
+  /// @brief constructs the element in the first free slot, the key must be absent. Requires writer section
+  template <typename K, typename... Args>
+  void PlaceLocked(K &&key, Args &&... args);
+
+  /// @brief places the pair into the bucket. Requires writer section
+  /// @return true if new element was inserted, false if a slot was overwritten
+  bool InsertLocked(const KeyType &key, const ValueType &value);
+
+  /// @brief frees all of the slots, the groups stay. Requires writer section
+  void ClearLocked();
+
+  typedef PolicyHolder<NodeAllocator, 0> AllocatorHolder;
+  typedef PolicyHolder<KeyEqual, 1> KeyEqualHolder;
+
+  NodeAllocator &Allocator() { return AllocatorHolder::Policy(); }
+  template <typename K>
+  bool KeysEqual(const KeyType &lhs, const K &rhs) const { return KeyEqualHolder::Policy()(lhs, rhs); }
+
+  typedef StatsMutex<SharedSpinLock> Mutex;
+
+  mutable Mutex mutex_; ///< serializes the writers, the readers never take it unless they starve
+  mutable std::atomic<uint32_t> sequence_{0}; ///< odd while a writer changes the bucket
+  std::atomic<uint32_t> size_{0};
+  Group head_;
+};
+
+/// @brief SeqLockBucket for trivially copyable keys and values, the shared mutex Bucket for the rest
+template <typename KeyType, typename ValueType, typename NodeAllocator = HeapNodeAllocator,
+          typename KeyEqual = std::equal_to<KeyType>>
+using OptimisticReadBucket =
+    typename std::conditional<std::is_trivially_copyable<KeyType>::value
+                                  && std::is_trivially_copyable<ValueType>::value,
+                              SeqLockBucket<KeyType, ValueType, NodeAllocator, KeyEqual>,
+                              Bucket<KeyType, ValueType, NodeAllocator, KeyEqual>>::type;
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+SeqLockBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::WriteSection::WriteSection(const SeqLockBucket &bucket)
+    : bucket_(bucket) {
+  bucket_.mutex_.lock();
+  bucket_.sequence_.store(bucket_.sequence_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  // the odd sequence must be visible before any change of the slots
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+SeqLockBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::WriteSection::~WriteSection() {
+  bucket_.sequence_.store(bucket_.sequence_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  bucket_.mutex_.unlock();
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+SeqLockBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::SeqLockBucket(const SeqLockBucket &rhs)
+    : AllocatorHolder(rhs), KeyEqualHolder(rhs) {
+  *this = rhs;
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+SeqLockBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::~SeqLockBucket() {
+  while (Group *group = head_.next.load(std::memory_order_relaxed)) {
+    head_.next.store(group->next.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    Allocator().Delete(group);
+  }
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+SeqLockBucket<KeyType, ValueType, NodeAllocator, KeyEqual> &
+SeqLockBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::operator=(const SeqLockBucket &rhs) {
+  if (this == &rhs)
+    return *this;
+  std::lock_guard<Mutex> rhs_lock(rhs.mutex_);
+  WriteSection section(*this);
+  ClearLocked();
+  for (const Group *group = &rhs.head_; group != nullptr; group = group->next.load(std::memory_order_relaxed))
+    for (uint32_t mask = group->full_mask.load(std::memory_order_relaxed); mask != 0; mask &= mask - 1)
+      PlaceLocked(group->At(__builtin_ctz(mask)).first, group->At(__builtin_ctz(mask)).second);
+  return *this;
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+uint64_t SeqLockBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::Size() const {
+  return size_.load(std::memory_order_acquire);
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+bool SeqLockBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::Empty() const {
+  return 0 == size_.load(std::memory_order_acquire);
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+void SeqLockBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::Clear() {
+  WriteSection section(*this);
+  ClearLocked();
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+void SeqLockBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::ClearLocked() {
+  for (Group *group = &head_; group != nullptr; group = group->next.load(std::memory_order_relaxed))
+    group->full_mask.store(0, std::memory_order_relaxed);
+  size_.store(0, std::memory_order_release);
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+template <typename K>
+bool SeqLockBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::ReadValue(const K &key, ValueType &value) const {
+  SlotStorage copy_storage;
+  const Slot &copy = *reinterpret_cast<const Slot *>(&copy_storage);
+  for (uint32_t attempt = 0; attempt < kMaxOptimisticAttempts; attempt++) {
+    const uint32_t kSequence = sequence_.load(std::memory_order_acquire);
+    if (kSequence & 1)
+      continue;
+
+    // the groups are never released, so whatever the reader sees in next is safe to follow
+    bool is_found = false;
+    for (const Group *group = &head_; group != nullptr && !is_found;
+         group = group->next.load(std::memory_order_acquire)) {
+      for (uint32_t mask = group->full_mask.load(std::memory_order_relaxed); mask != 0; mask &= mask - 1) {
+        std::memcpy(&copy_storage, &group->slots[__builtin_ctz(mask)], sizeof(Slot));
+        if ((is_found = KeysEqual(copy.first, key)))
+          break;
+      }
+    }
+
+    // the copies must complete before the sequence is checked again
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (sequence_.load(std::memory_order_relaxed) != kSequence)
+      continue;
+    if (is_found)
+      value = copy.second;
+    return is_found;
+  }
+
+  // a stream of writers: wait for the turn instead of retrying forever
+  std::lock_guard<Mutex> lock(mutex_);
+  auto slot = FindLocked(key);
+  if (slot != nullptr)
+    value = slot->second;
+  return slot != nullptr;
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+template <typename K>
+typename SeqLockBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::Slot *
+SeqLockBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::FindLocked(const K &key) const {
+  for (const Group *group = &head_; group != nullptr; group = group->next.load(std::memory_order_relaxed)) {
+    for (uint32_t mask = group->full_mask.load(std::memory_order_relaxed); mask != 0; mask &= mask - 1) {
+      const Slot &slot = group->At(__builtin_ctz(mask));
+      if (KeysEqual(slot.first, key))
+        return const_cast<Slot *>(&slot);
+    }
+  }
+  return nullptr;
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+template <typename K, typename... Args>
+void SeqLockBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::PlaceLocked(K &&key, Args &&... args) {
+  const uint32_t kAllSlots = (1u << kGroupSize) - 1;
+  Group *group = &head_;
+  while (kAllSlots == group->full_mask.load(std::memory_order_relaxed)) {
+    if (group->next.load(std::memory_order_relaxed) == nullptr)
+      group->next.store(Allocator().template New<Group>(), std::memory_order_release);
+    group = group->next.load(std::memory_order_relaxed);
+  }
+
+  const uint32_t kFullMask = group->full_mask.load(std::memory_order_relaxed);
+  const uint32_t kIdx = __builtin_ctz(~kFullMask);
+  new (&group->slots[kIdx]) Slot{KeyType(std::forward<K>(key)), ValueType(std::forward<Args>(args)...)};
+  group->full_mask.store(kFullMask | (1u << kIdx), std::memory_order_relaxed);
+  size_.fetch_add(1, std::memory_order_release);
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+bool SeqLockBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::InsertLocked(const KeyType &key,
+                                                                              const ValueType &value) {
+  const bool kWasNewElementCreated = true;
+  auto existing = FindLocked(key);
+  if (existing != nullptr) {
+    existing->second = value;
+    return !kWasNewElementCreated;
+  }
+  PlaceLocked(key, value);
+  return kWasNewElementCreated;
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+template <typename K>
+std::pair<bool, ValueType>
+SeqLockBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::Lookup(uint64_t, const K &key) const {
+  std::pair<bool, ValueType> result(false, ValueType());
+  result.first = ReadValue(key, result.second);
+  return result;
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+template <typename K, typename Visitor>
+bool SeqLockBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::Visit(uint64_t, const K &key,
+                                                                       Visitor &&visitor) const {
+  ValueType value;
+  if (!ReadValue(key, value))
+    return kOperationFailed;
+  visitor(static_cast<const ValueType &>(value));
+  return kOperationSuccess;
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+bool SeqLockBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::Insert(uint64_t, const KeyType &key,
+                                                                        const ValueType &value) {
+  WriteSection section(*this);
+  return InsertLocked(key, value);
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+template <typename K>
+bool SeqLockBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::Remove(uint64_t, const K &key) {
+  WriteSection section(*this);
+  for (Group *group = &head_; group != nullptr; group = group->next.load(std::memory_order_relaxed)) {
+    const uint32_t kFullMask = group->full_mask.load(std::memory_order_relaxed);
+    for (uint32_t mask = kFullMask; mask != 0; mask &= mask - 1) {
+      const uint32_t kIdx = __builtin_ctz(mask);
+      if (!KeysEqual(group->At(kIdx).first, key))
+        continue;
+      group->full_mask.store(kFullMask & ~(1u << kIdx), std::memory_order_relaxed);
+      size_.fetch_sub(1, std::memory_order_release);
+      return kOperationSuccess;
+    }
+  }
+  return kOperationFailed;
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+template <typename Updater, typename Creator>
+bool SeqLockBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::Upsert(uint64_t, const KeyType &key,
+                                                                        Updater &&update, Creator &&create) {
+  const bool kWasNewElementCreated = true;
+  WriteSection section(*this);
+  auto existing = FindLocked(key);
+  if (existing != nullptr) {
+    update(existing->second);
+    return !kWasNewElementCreated;
+  }
+  PlaceLocked(key, create());
+  return kWasNewElementCreated;
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+template <typename K, typename Updater, typename... Args>
+bool SeqLockBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::EmplaceOrUpdate(uint64_t, K &&key,
+                                                                                 Updater &&update, Args &&... args) {
+  const bool kWasNewElementCreated = true;
+  WriteSection section(*this);
+  auto existing = FindLocked(key);
+  if (existing != nullptr) {
+    update(existing->second);
+    return !kWasNewElementCreated;
+  }
+  PlaceLocked(std::forward<K>(key), std::forward<Args>(args)...);
+  return kWasNewElementCreated;
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+uint64_t SeqLockBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::InsertBatch(const BatchItem *items,
+                                                                                 uint64_t count, const KeyType *keys,
+                                                                                 const ValueType *values) {
+  WriteSection section(*this);
+  uint64_t num_inserted = 0;
+  for (uint64_t i = 0; i < count; i++)
+    if (InsertLocked(keys[items[i].position], values[items[i].position]))
+      num_inserted++;
+  return num_inserted;
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+void SeqLockBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::LookupBatch(const BatchItem *items, uint64_t count,
+                                                                            const KeyType *keys,
+                                                                            std::pair<bool, ValueType> *results) const {
+  for (uint64_t i = 0; i < count; i++) {
+    auto &result = results[items[i].position];
+    result.second = ValueType();
+    result.first = ReadValue(keys[items[i].position], result.second);
+  }
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+template <typename Visitor>
+void SeqLockBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::ForEach(Visitor &&visitor) const {
+  std::lock_guard<Mutex> lock(mutex_);
+  for (const Group *group = &head_; group != nullptr; group = group->next.load(std::memory_order_relaxed)) {
+    for (uint32_t mask = group->full_mask.load(std::memory_order_relaxed); mask != 0; mask &= mask - 1) {
+      const Slot &slot = group->At(__builtin_ctz(mask));
+      visitor(slot.first, slot.second);
+    }
+  }
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+template <typename Predicate>
+uint64_t SeqLockBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::RemoveIf(Predicate &&predicate) {
+  WriteSection section(*this);
+  uint64_t num_removed = 0;
+  for (Group *group = &head_; group != nullptr; group = group->next.load(std::memory_order_relaxed)) {
+    const uint32_t kFullMask = group->full_mask.load(std::memory_order_relaxed);
+    uint32_t kept_mask = kFullMask;
+    for (uint32_t mask = kFullMask; mask != 0; mask &= mask - 1) {
+      const uint32_t kIdx = __builtin_ctz(mask);
+      if (predicate(static_cast<const KeyType &>(group->At(kIdx).first),
+                    static_cast<const ValueType &>(group->At(kIdx).second)))
+        kept_mask &= ~(1u << kIdx);
+    }
+    if (kept_mask != kFullMask) {
+      group->full_mask.store(kept_mask, std::memory_order_relaxed);
+      num_removed += __builtin_popcount(kFullMask ^ kept_mask);
+    }
+  }
+  size_.fetch_sub(num_removed, std::memory_order_release);
+  return num_removed;
+}
+
+template <typename KeyType, typename ValueType, typename NodeAllocator, typename KeyEqual>
+template <typename Hasher, typename Router>
+uint64_t SeqLockBucket<KeyType, ValueType, NodeAllocator, KeyEqual>::MigrateTo(const Hasher &hasher,
+                                                                               const Router &dest) {
+  WriteSection section(*this);
+  for (Group *group = &head_; group != nullptr; group = group->next.load(std::memory_order_relaxed)) {
+    for (uint32_t mask = group->full_mask.load(std::memory_order_relaxed); mask != 0; mask &= mask - 1) {
+      const Slot &slot = group->At(__builtin_ctz(mask));
+      auto &bucket = dest(hasher(slot.first));
+      WriteSection dest_section(bucket);
+      bucket.InsertLocked(slot.first, slot.second);
+    }
+  }
+  const uint64_t kNumItems = size_.load(std::memory_order_acquire);
+  ClearLocked();
+  return kNumItems;
+}
+
+} // namespace internals
+} // namespace my_concurrency
+
+#endif //THREADSAFE_HASHMAP_SEQLOCK_BUCKET_H
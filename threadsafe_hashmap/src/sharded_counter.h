@@ -0,0 +1,62 @@
+#ifndef THREADSAFE_HASHMAP_SHARDED_COUNTER_H
+#define THREADSAFE_HASHMAP_SHARDED_COUNTER_H
+
+#include <atomic>
+#include <inttypes.h>
+
+#include "helpers.h"
+
+namespace my_concurrency {
+namespace internals {
+
+/// @brief Counter split into kNumShards cells, each in its own cache line. A thread always updates the same cell,
+///        so writers on different cores rarely meet on one cache line. Reading sums all of the cells.
+///        The operations are sequentially consistent: of the threads which update the counter and then read it,
+///        the last one to read sees all of the updates
+class ShardedCounter {
+ public:
+  ShardedCounter() = default;
+  explicit ShardedCounter(uint64_t value) { Store(value); }
+  ShardedCounter(const ShardedCounter &) = delete;
+  ShardedCounter &operator=(const ShardedCounter &) = delete;
+
+  /// @return value of the cell of the thread after the update. Cells wrap around, only their changes matter
+  uint64_t Add(int64_t delta);
+
+  /// @brief sum of the cells. Concurrent updates may be partially seen, so it is exact only when nobody updates.
+  ///        A decrement may be seen without the increment it follows, the sum is clamped at zero then
+  uint64_t Load() const;
+
+  /// @brief resets the counter to the value. Requires no concurrent updates
+  void Store(uint64_t value);
+
+  constexpr static uint64_t kNumShards = 32;
+ private:
+  struct alignas(64) Cell {
+    std::atomic<uint64_t> value{0};
+  };
+
+  Cell cells_[kNumShards];
+};
+
+inline uint64_t ShardedCounter::Add(int64_t delta) {
+  return cells_[ThreadIndex() % kNumShards].value.fetch_add(static_cast<uint64_t>(delta)) + delta;
+}
+
+inline uint64_t ShardedCounter::Load() const {
+  int64_t sum = 0;
+  for (auto &cell : cells_)
+    sum += static_cast<int64_t>(cell.value.load());
+  return sum < 0? 0 : static_cast<uint64_t>(sum);
+}
+
+inline void ShardedCounter::Store(uint64_t value) {
+  for (auto &cell : cells_)
+    cell.value.store(0, std::memory_order_relaxed);
+  cells_[0].value.store(value);
+}
+
+} // namespace internals
+} // namespace my_concurrency
+
+#endif //THREADSAFE_HASHMAP_SHARDED_COUNTER_H
@@ -0,0 +1,250 @@
+#ifndef THREADSAFE_HASHMAP_SNAPSHOT_H
+#define THREADSAFE_HASHMAP_SNAPSHOT_H
+
+#include <cstdio> // FILE, rename
+#include <cstring> // memcmp, memcpy
+#include <fcntl.h> // open
+#include <inttypes.h>
+#include <string>
+#include <sys/mman.h> // mmap
+#include <sys/stat.h> // fstat
+#include <type_traits>
+#include <unistd.h> // close
+#include <vector>
+
+#include "helpers.h"
+
+namespace my_concurrency {
+namespace internals {
+
+/// On-disk image of a map, all sections start at multiples of kSnapshotAlignment:
+///   SnapshotHeader
+///   uint64_t bucket_offsets[num_buckets + 1] - the elements of bucket i are [bucket_offsets[i], bucket_offsets[i + 1])
+///   uint64_t hashes[num_elements]           - mixed hashes (IndexPolicy::Mix), the loader does not rehash
+///   Stored keys[num_elements]                - SnapshotCodec<KeyType>::Stored
+///   Stored values[num_elements]              - SnapshotCodec<ValueType>::Stored
+///   char blob[blob_size]                     - bytes of the strings, referenced by StringRef
+/// The numbers are in the byte order of the machine, the image is not portable between architectures
+
+constexpr char kSnapshotMagic[8] = {'T', 'S', 'H', 'M', 'S', 'N', 'A', 'P'};
+constexpr uint32_t kSnapshotVersion = 1;
+constexpr uint64_t kSnapshotAlignment = 64;
+/// number of the stored hashes the loader recomputes to check that the hasher did not change
+constexpr uint64_t kSnapshotHashSamples = 16;
+
+struct SnapshotHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t key_format; ///< SnapshotCodec::kFormat of the key type
+  uint32_t value_format;
+  uint32_t reserved;
+  uint64_t key_size; ///< sizeof of the stored key
+  uint64_t value_size;
+  uint64_t hash_seed; ///< mixed hash of the default key: differs if the hasher or its seed changed
+  uint64_t num_buckets;
+  uint64_t num_elements;
+  uint64_t blob_size;
+};
+
+/// @brief location of a string in the blob of the snapshot
+struct StringRef {
+  uint64_t offset;
+  uint64_t length;
+};
+
+/// @brief stores trivially copyable types as is. Other types need a specialization
+template <typename T, typename = void>
+struct SnapshotCodec {
+  static_assert(std::is_trivially_copyable<T>::value, "snapshots support trivially copyable types and std::string");
+};
+
+template <typename T>
+struct SnapshotCodec<T, std::enable_if_t<std::is_trivially_copyable<T>::value>> {
+  typedef T Stored;
+  static constexpr uint32_t kFormat = 1;
+
+  static Stored Encode(const T &value, std::string &) { return value; }
+  static T Decode(const Stored &stored, const char *) { return stored; }
+  static bool IsValid(const Stored &, uint64_t) { return true; }
+};
+
+template <>
+struct SnapshotCodec<std::string> {
+  typedef StringRef Stored;
+  static constexpr uint32_t kFormat = 2;
+
+  static Stored Encode(const std::string &value, std::string &blob) {
+    Stored stored{blob.size(), value.size()};
+    blob += value;
+    return stored;
+  }
+  /// @brief requires IsValid(stored, blob_size)
+  static std::string Decode(const Stored &stored, const char *blob) {
+    return std::string(blob + stored.offset, stored.length);
+  }
+  /// @return true if the string lies within the blob
+  static bool IsValid(const Stored &stored, uint64_t blob_size) {
+    return stored.offset <= blob_size && stored.length <= blob_size - stored.offset;
+  }
+};
+
+/// @brief offsets of the sections of a snapshot described by the header
+struct SnapshotLayout {
+  explicit SnapshotLayout(const SnapshotHeader &header) {
+    bucket_offsets = Align(sizeof(SnapshotHeader));
+    hashes = Align(bucket_offsets + (header.num_buckets + 1) * sizeof(uint64_t));
+    keys = Align(hashes + header.num_elements * sizeof(uint64_t));
+    values = Align(keys + header.num_elements * header.key_size);
+    blob = Align(values + header.num_elements * header.value_size);
+    total_size = blob + header.blob_size;
+  }
+
+  static uint64_t Align(uint64_t offset) {
+    return (offset + kSnapshotAlignment - 1) / kSnapshotAlignment * kSnapshotAlignment;
+  }
+
+  uint64_t bucket_offsets;
+  uint64_t hashes;
+  uint64_t keys;
+  uint64_t values;
+  uint64_t blob;
+  uint64_t total_size;
+};
+
+/// @brief read-only private mapping of a whole file, unmapped by the destructor
+class MappedFile {
+ public:
+  MappedFile() = default;
+  ~MappedFile() { Close(); }
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  /// @return false if the file can not be opened or mapped
+  bool Open(const std::string &path) {
+    Close();
+    const int kFd = ::open(path.c_str(), O_RDONLY);
+    if (kFd < 0) {
+      WARNING("can not open " << path);
+      return false;
+    }
+    struct stat file_stat;
+    if (0 == ::fstat(kFd, &file_stat) && file_stat.st_size > 0) {
+      void *memory = ::mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, kFd, 0);
+      if (memory != MAP_FAILED) {
+        data_ = static_cast<const char *>(memory);
+        size_ = static_cast<uint64_t>(file_stat.st_size);
+      }
+    }
+    ::close(kFd); // the mapping keeps the file
+    if (nullptr == data_)
+      WARNING("can not map " << path);
+    return data_ != nullptr;
+  }
+
+  void Close() {
+    if (data_ != nullptr)
+      ::munmap(const_cast<char *>(data_), size_);
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+  const char *Data() const { return data_; }
+  uint64_t Size() const { return size_; }
+
+ private:
+  const char *data_ = nullptr;
+  uint64_t size_ = 0;
+};
+
+/// @brief checks the header of a mapped snapshot against the key and value types of the reader
+/// @return the header, or nullptr if the file is not a snapshot of these types
+template <typename KeyType, typename ValueType>
+const SnapshotHeader *CheckSnapshot(const MappedFile &file) {
+  typedef SnapshotCodec<KeyType> KeyCodec;
+  typedef SnapshotCodec<ValueType> ValueCodec;
+  if (file.Size() < sizeof(SnapshotHeader))
+    return nullptr;
+  auto header = reinterpret_cast<const SnapshotHeader *>(file.Data());
+  if (0 != std::memcmp(header->magic, kSnapshotMagic, sizeof(kSnapshotMagic)) || header->version != kSnapshotVersion) {
+    WARNING("not a snapshot of version " << kSnapshotVersion);
+    return nullptr;
+  }
+  if (header->key_format != KeyCodec::kFormat || header->key_size != sizeof(typename KeyCodec::Stored) ||
+      header->value_format != ValueCodec::kFormat || header->value_size != sizeof(typename ValueCodec::Stored)) {
+    WARNING("the snapshot has other key or value types");
+    return nullptr;
+  }
+  // every section fits the file on its own, so the layout of a broken header does not overflow
+  const uint64_t kElementSize = sizeof(uint64_t) + header->key_size + header->value_size;
+  if (0 == header->num_buckets || header->num_buckets >= file.Size() / sizeof(uint64_t) ||
+      header->num_elements > file.Size() / kElementSize || header->blob_size > file.Size() ||
+      SnapshotLayout(*header).total_size > file.Size()) {
+    WARNING("the snapshot is truncated");
+    return nullptr;
+  }
+  return header;
+}
+
+/// @brief checks the sections of a snapshot accepted by CheckSnapshot: the buckets cover all of the elements in
+///        order and the strings lie within the blob. Reads the bucket offsets and the stored strings once
+/// @return false if the snapshot is corrupted
+template <typename KeyType, typename ValueType>
+bool CheckSnapshotSections(const MappedFile &file) {
+  typedef SnapshotCodec<KeyType> KeyCodec;
+  typedef SnapshotCodec<ValueType> ValueCodec;
+  auto header = reinterpret_cast<const SnapshotHeader *>(file.Data());
+  const SnapshotLayout kLayout(*header);
+  auto bucket_offsets = reinterpret_cast<const uint64_t *>(file.Data() + kLayout.bucket_offsets);
+  bool is_valid = 0 == bucket_offsets[0] && header->num_elements == bucket_offsets[header->num_buckets];
+  for (uint64_t i = 0; is_valid && i < header->num_buckets; i++)
+    is_valid = bucket_offsets[i] <= bucket_offsets[i + 1];
+
+  auto keys = reinterpret_cast<const typename KeyCodec::Stored *>(file.Data() + kLayout.keys);
+  auto values = reinterpret_cast<const typename ValueCodec::Stored *>(file.Data() + kLayout.values);
+  for (uint64_t i = 0; is_valid && i < header->num_elements; i++)
+    is_valid = KeyCodec::IsValid(keys[i], header->blob_size) && ValueCodec::IsValid(values[i], header->blob_size);
+  if (!is_valid)
+    WARNING("the snapshot is corrupted");
+  return is_valid;
+}
+
+/// @brief writes the sections into path + ".tmp" and renames it, so a reader never maps a half-written file
+/// @return false if the file can not be written
+template <typename KeyStored, typename ValueStored>
+bool WriteSnapshot(const std::string &path, const SnapshotHeader &header, const std::vector<uint64_t> &bucket_offsets,
+                   const std::vector<uint64_t> &hashes, const std::vector<KeyStored> &keys,
+                   const std::vector<ValueStored> &values, const std::string &blob) {
+  const std::string kTempPath = path + ".tmp";
+  std::FILE *file = std::fopen(kTempPath.c_str(), "wb");
+  if (nullptr == file) {
+    WARNING("can not create " << kTempPath);
+    return false;
+  }
+  const SnapshotLayout kLayout(header);
+  uint64_t position = 0;
+  bool is_written = true;
+  auto write_section = [&](uint64_t offset, const void *data, uint64_t size) {
+    static const char kPadding[kSnapshotAlignment] = {};
+    is_written = is_written && std::fwrite(kPadding, 1, offset - position, file) == offset - position;
+    is_written = is_written && (0 == size || std::fwrite(data, 1, size, file) == size);
+    position = offset + size;
+  };
+  write_section(0, &header, sizeof(header));
+  write_section(kLayout.bucket_offsets, bucket_offsets.data(), bucket_offsets.size() * sizeof(uint64_t));
+  write_section(kLayout.hashes, hashes.data(), hashes.size() * sizeof(uint64_t));
+  write_section(kLayout.keys, keys.data(), keys.size() * sizeof(KeyStored));
+  write_section(kLayout.values, values.data(), values.size() * sizeof(ValueStored));
+  write_section(kLayout.blob, blob.data(), blob.size());
+  is_written = 0 == std::fclose(file) && is_written;
+  if (!is_written || 0 != std::rename(kTempPath.c_str(), path.c_str())) {
+    WARNING("can not write " << path);
+    std::remove(kTempPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+} // namespace internals
+} // namespace my_concurrency
+
+#endif //THREADSAFE_HASHMAP_SNAPSHOT_H
@@ -0,0 +1,69 @@
+#ifndef THREADSAFE_HASHMAP_SPIN_LOCK_H
+#define THREADSAFE_HASHMAP_SPIN_LOCK_H
+
+#include <atomic>
+#include <inttypes.h>
+#include <thread>
+
+namespace my_concurrency {
+namespace internals {
+
+/// @brief Reader-writer spin lock in 4 bytes: meets the SharedMutex requirements, so it drops in for
+///        std::shared_timed_mutex (56 bytes) where there are millions of locks held for short time.
+///        Writers are preferred: a waiting writer stops new readers from coming in
+class SharedSpinLock {
+ public:
+  SharedSpinLock() : state_(0) { }
+  SharedSpinLock(const SharedSpinLock &) = delete;
+  SharedSpinLock &operator=(const SharedSpinLock &) = delete;
+
+  void lock() {
+    for (uint32_t attempt = 0; state_.fetch_or(kWriter, std::memory_order_acquire) & kWriter; attempt++)
+      Backoff(attempt);
+    // no reader comes in since now, the ones already in leave soon
+    for (uint32_t attempt = 0; state_.load(std::memory_order_acquire) != kWriter; attempt++)
+      Backoff(attempt);
+  }
+
+  bool try_lock() {
+    uint32_t expected = 0;
+    return state_.compare_exchange_strong(expected, kWriter, std::memory_order_acquire, std::memory_order_relaxed);
+  }
+
+  void unlock() {
+    state_.fetch_and(~kWriter, std::memory_order_release);
+  }
+
+  void lock_shared() {
+    for (uint32_t attempt = 0; !try_lock_shared(); attempt++)
+      Backoff(attempt);
+  }
+
+  bool try_lock_shared() {
+    if (!(state_.fetch_add(kReader, std::memory_order_acquire) & kWriter))
+      return true;
+    state_.fetch_sub(kReader, std::memory_order_relaxed);
+    return false;
+  }
+
+  void unlock_shared() {
+    state_.fetch_sub(kReader, std::memory_order_release);
+  }
+
+ private:
+  constexpr static uint32_t kWriter = 1u << 31;
+  constexpr static uint32_t kReader = 1;
+  constexpr static uint32_t kSpinsBeforeYield = 16;
+
+  static void Backoff(uint32_t attempt) {
+    if (attempt >= kSpinsBeforeYield)
+      std::this_thread::yield();
+  }
+
+  std::atomic<uint32_t> state_; ///< writer bit and the number of readers
+};
+
+} // namespace internals
+} // namespace my_concurrency
+
+#endif //THREADSAFE_HASHMAP_SPIN_LOCK_H
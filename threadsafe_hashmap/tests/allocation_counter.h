@@ -0,0 +1,134 @@
+#ifndef THREADSAFE_HASHMAP_ALLOCATION_COUNTER_H
+#define THREADSAFE_HASHMAP_ALLOCATION_COUNTER_H
+
+#include <cstddef> // max_align_t
+#include <inttypes.h>
+#include <new>
+#include <stdlib.h>
+
+/// Replaces all of the global operator new and delete forms of the test binary (plain, nothrow, array and aligned)
+/// to count the heap allocations and bytes of every thread. Every form allocates with malloc or posix_memalign and
+/// frees with free, so the memory of any form may be released by any other, as the default ones allow.
+/// The definitions are not inline, so the header must be included into one translation unit only.
+/// They are never inlined either, otherwise the compiler pairs malloc() and free() with new and delete expressions
+
+namespace tests {
+
+/// @return number of operator new calls made by the current thread
+inline uint64_t &ThreadAllocations() {
+  thread_local uint64_t counter = 0;
+  return counter;
+}
+
+/// @return number of bytes requested from operator new by the current thread
+inline uint64_t &ThreadAllocatedBytes() {
+  thread_local uint64_t counter = 0;
+  return counter;
+}
+
+/// @brief counts the allocation and takes the memory from malloc, or posix_memalign for the extended alignments
+/// @return nullptr if there is no memory
+inline void *CountedAllocate(size_t size, size_t alignment) {
+  ThreadAllocations()++;
+  ThreadAllocatedBytes() += size;
+  if (0 == size)
+    size = 1;
+  if (alignment <= alignof(std::max_align_t))
+    return malloc(size);
+  void *memory = nullptr;
+  return 0 == posix_memalign(&memory, alignment, size)? memory : nullptr;
+}
+
+/// @brief CountedAllocate for the throwing forms
+inline void *CountedAllocateOrThrow(size_t size, size_t alignment) {
+  void *memory = CountedAllocate(size, alignment);
+  if (memory == nullptr)
+    throw std::bad_alloc();
+  return memory;
+}
+
+} // namespace tests
+
+__attribute__((noinline)) void *operator new(size_t size) {
+  return tests::CountedAllocateOrThrow(size, alignof(std::max_align_t));
+}
+
+__attribute__((noinline)) void *operator new[](size_t size) {
+  return tests::CountedAllocateOrThrow(size, alignof(std::max_align_t));
+}
+
+__attribute__((noinline)) void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  return tests::CountedAllocate(size, alignof(std::max_align_t));
+}
+
+__attribute__((noinline)) void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+  return tests::CountedAllocate(size, alignof(std::max_align_t));
+}
+
+__attribute__((noinline)) void *operator new(size_t size, std::align_val_t alignment) {
+  return tests::CountedAllocateOrThrow(size, static_cast<size_t>(alignment));
+}
+
+__attribute__((noinline)) void *operator new[](size_t size, std::align_val_t alignment) {
+  return tests::CountedAllocateOrThrow(size, static_cast<size_t>(alignment));
+}
+
+__attribute__((noinline)) void *operator new(size_t size, std::align_val_t alignment,
+                                             const std::nothrow_t &) noexcept {
+  return tests::CountedAllocate(size, static_cast<size_t>(alignment));
+}
+
+__attribute__((noinline)) void *operator new[](size_t size, std::align_val_t alignment,
+                                               const std::nothrow_t &) noexcept {
+  return tests::CountedAllocate(size, static_cast<size_t>(alignment));
+}
+
+__attribute__((noinline)) void operator delete(void *memory) noexcept {
+  free(memory);
+}
+
+__attribute__((noinline)) void operator delete[](void *memory) noexcept {
+  free(memory);
+}
+
+__attribute__((noinline)) void operator delete(void *memory, size_t) noexcept {
+  free(memory);
+}
+
+__attribute__((noinline)) void operator delete[](void *memory, size_t) noexcept {
+  free(memory);
+}
+
+__attribute__((noinline)) void operator delete(void *memory, const std::nothrow_t &) noexcept {
+  free(memory);
+}
+
+__attribute__((noinline)) void operator delete[](void *memory, const std::nothrow_t &) noexcept {
+  free(memory);
+}
+
+__attribute__((noinline)) void operator delete(void *memory, std::align_val_t) noexcept {
+  free(memory);
+}
+
+__attribute__((noinline)) void operator delete[](void *memory, std::align_val_t) noexcept {
+  free(memory);
+}
+
+__attribute__((noinline)) void operator delete(void *memory, size_t, std::align_val_t) noexcept {
+  free(memory);
+}
+
+__attribute__((noinline)) void operator delete[](void *memory, size_t, std::align_val_t) noexcept {
+  free(memory);
+}
+
+__attribute__((noinline)) void operator delete(void *memory, std::align_val_t, const std::nothrow_t &) noexcept {
+  free(memory);
+}
+
+__attribute__((noinline)) void operator delete[](void *memory, std::align_val_t, const std::nothrow_t &) noexcept {
+  free(memory);
+}
+
+#endif //THREADSAFE_HASHMAP_ALLOCATION_COUNTER_H
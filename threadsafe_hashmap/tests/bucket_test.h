@@ -15,6 +15,8 @@
 
 #include <iostream>
 #include <memory>
+#include <string>
+#include <string_view>
 #include <vector>
 
 #include "../src/bucket.h"
@@ -22,6 +24,7 @@
 using std::make_pair;
 
 using my_concurrency::internals::Bucket;
+using my_concurrency::internals::HeapNodeAllocator;
 
 namespace tests {
 
@@ -35,6 +38,8 @@ class LinkedListTest {
     RemoveTest();
     IteratorTest();
     IteratorRvalueTest();
+    MigrateTest();
+    HeterogeneousLookupTest();
 
     std::cout << "Linked list tests passed." << std::endl;
   }
@@ -165,6 +170,44 @@ class LinkedListTest {
     iter = list.BeginSync();
     assert(22 == *((*iter).second));
   }
+
+  /// @brief the nodes of the hashless overloads are hashed by the hasher of the migration
+  void MigrateTest() {
+    Bucket<int, int> source;
+    for (int i = 0; i < 30; i++)
+      source.Insert(i, i * 10);
+
+    Bucket<int, int> destinations[2];
+    std::hash<int> hasher;
+    auto router = [&destinations](uint64_t hash) -> Bucket<int, int> & { return destinations[hash % 2]; };
+    assert(30 == source.MigrateTo(hasher, router));
+    assert(source.Empty());
+    for (int i = 0; i < 30; i++)
+      assert(make_pair(true, i * 10) == destinations[hasher(i) % 2].Lookup(i));
+    assert(15 == destinations[0].Size() && 15 == destinations[1].Size());
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  /// @brief the hashless overloads compare the keys with the KeyEqual only: nothing is converted to KeyType
+  void HeterogeneousLookupTest() {
+    Bucket<std::string, int, HeapNodeAllocator, std::equal_to<>> list;
+    list.Insert("one", 1);
+    list.Insert(std::string("two"), 2);
+    assert(make_pair(true, 1) == list.Lookup(std::string_view("one")));
+    assert(make_pair(true, 2) == list.Lookup("two"));
+    assert(list.Visit(std::string_view("two"), [](const int &value) { assert(2 == value); }));
+    assert(list.Remove(std::string_view("one")));
+    assert(make_pair(false, 0) == list.Lookup(std::string_view("one")));
+
+    // a predicate coarser than any hash still finds the equal keys
+    auto first_equal = [](const std::string &lhs, const std::string &rhs) { return lhs[0] == rhs[0]; };
+    Bucket<std::string, int, HeapNodeAllocator, decltype(first_equal)> coarse(HeapNodeAllocator(), first_equal);
+    assert(coarse.Insert("apple", 1));
+    assert(!coarse.Insert("avocado", 2));
+    assert(1 == coarse.Size());
+    assert(make_pair(true, 2) == coarse.Lookup(std::string("apricot")));
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
 };
 
 
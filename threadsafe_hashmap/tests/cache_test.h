@@ -0,0 +1,262 @@
+#ifndef THREADSAFE_HASHMAP_CACHE_TEST_H
+#define THREADSAFE_HASHMAP_CACHE_TEST_H
+
+#ifdef NDEBUG
+#undef NDEBUG
+  #define RESTORE_NDEBUG
+#endif
+
+#include <assert.h>
+
+#ifdef RESTORE_NDEBUG
+#undef RESTORE_NDEBUG
+  #define NDEBUG
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../include/concurrent_cache.h"
+
+using std::make_pair;
+
+using my_concurrency::ConcurrentCache;
+
+namespace tests {
+
+class ConcurrentCacheTest {
+ public:
+  void TestAll() {
+    SimpleTest();
+    ClockTest();
+    WeigherTest();
+    ConcurrentTest();
+    ZipfianBenchmark();
+
+    std::cout << "Concurrent cache tests passed." << std::endl;
+  }
+
+ private:
+  typedef ConcurrentCache<int, int> IntCache;
+
+  /// @brief weight of an element is the bytes of its value
+  struct StringWeigher {
+    uint64_t operator()(const int &, const std::string &value) const { return value.size(); }
+  };
+
+  /// @brief the wrapper the cache replaces: std::list LRU under one mutex
+  class GlobalLruCache {
+   public:
+    explicit GlobalLruCache(uint64_t capacity) : capacity_(capacity) { }
+
+    std::pair<bool, int> Lookup(int key) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto found = index_.find(key);
+      if (found == index_.end())
+        return make_pair(false, 0);
+      order_.splice(order_.begin(), order_, found->second);
+      return make_pair(true, found->second->second);
+    }
+
+    void Insert(int key, int value) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto found = index_.find(key);
+      if (found != index_.end()) {
+        found->second->second = value;
+        order_.splice(order_.begin(), order_, found->second);
+        return;
+      }
+      order_.emplace_front(key, value);
+      index_[key] = order_.begin();
+      if (order_.size() > capacity_) {
+        index_.erase(order_.back().first);
+        order_.pop_back();
+      }
+    }
+
+   private:
+    std::mutex mutex_;
+    std::list<std::pair<int, int>> order_;
+    std::unordered_map<int, std::list<std::pair<int, int>>::iterator> index_;
+    const uint64_t capacity_;
+  };
+
+  /// @brief keys 0..num_keys-1, the key of rank i is drawn with probability proportional to 1 / (i + 1)^skew
+  class ZipfianGenerator {
+   public:
+    ZipfianGenerator(uint64_t num_keys, double skew) : cdf_(num_keys) {
+      double sum = 0;
+      for (uint64_t i = 0; i < num_keys; i++)
+        cdf_[i] = sum += 1.0 / std::pow(i + 1, skew);
+      for (auto &value : cdf_)
+        value /= sum;
+    }
+
+    template <typename Random>
+    int Next(Random &random) const {
+      const double kPoint = std::uniform_real_distribution<double>(0, 1)(random);
+      return static_cast<int>(std::lower_bound(cdf_.begin(), cdf_.end() - 1, kPoint) - cdf_.begin());
+    }
+
+   private:
+    std::vector<double> cdf_;
+  };
+
+  void SimpleTest() {
+    IntCache cache(100);
+    assert(100 == cache.Capacity() && 0 == cache.Size());
+    assert(cache.Insert(1, 10));
+    assert(make_pair(true, 10) == cache.Lookup(1));
+    assert(make_pair(false, 0) == cache.Lookup(2));
+    assert(cache.Insert(1, 11));
+    assert(make_pair(true, 11) == cache.Lookup(1));
+    assert(1 == cache.Size() && 1 == cache.Weight());
+    assert(cache.Remove(1));
+    assert(!cache.Remove(1));
+    assert(!cache.Lookup(1).first && 0 == cache.Weight());
+
+    for (int i = 0; i < 1000; i++)
+      cache.Insert(i, i);
+    assert(cache.Weight() <= cache.Capacity() && cache.Size() == cache.Weight());
+    auto stats = cache.GetStats();
+    assert(2 == stats.hits && 2 == stats.misses);
+    assert(1000 - cache.Size() == stats.evictions);
+
+    // fewer elements than the default shards: every shard keeps at least one
+    IntCache small(10);
+    for (int i = 0; i < 100; i++)
+      assert(small.Insert(i, i));
+    assert(make_pair(true, 99) == small.Lookup(99));
+    assert(small.Size() > 0 && small.Weight() <= 10 && 0 == small.GetStats().rejections);
+    // the remainder of the division is spread over the shards, so the whole capacity is used
+    IntCache uneven(20, my_concurrency::UnitWeigher(), 8);
+    for (int i = 0; i < 1000; i++)
+      uneven.Insert(i, i);
+    assert(20 == uneven.Weight());
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  /// @brief elements hit since the last pass of the hand survive the eviction
+  void ClockTest() {
+    const int kCapacity = 64;
+    IntCache cache(kCapacity, my_concurrency::UnitWeigher(), 1);
+    for (int i = 0; i < kCapacity; i++)
+      cache.Insert(i, i);
+    for (int round = 0; round < 4; round++) {
+      for (int i = 0; i < kCapacity; i += 2)
+        assert(cache.Lookup(i).first);
+      for (int i = 0; i < kCapacity / 2; i++)
+        cache.Insert(kCapacity * (round + 1) + i, i);
+    }
+    for (int i = 0; i < kCapacity; i += 2)
+      assert(make_pair(true, i) == cache.Lookup(i));
+    assert(kCapacity == (int)cache.Size());
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  void WeigherTest() {
+    const uint64_t kCapacity = 4 * 1000;
+    ConcurrentCache<int, std::string, StringWeigher> cache(kCapacity, StringWeigher(), 4);
+    assert(!cache.Insert(1, std::string(2000, 'x'))); // heavier than a shard
+    assert(!cache.Lookup(1).first && 1 == cache.GetStats().rejections);
+    for (int i = 0; i < 1000; i++)
+      assert(cache.Insert(i, std::string(i % 100, 'x')));
+    assert(cache.Weight() <= kCapacity);
+    assert(cache.GetStats().evictions > 0);
+    // elements with zero weight still take a place
+    ConcurrentCache<int, std::string, StringWeigher> empty_values(8, StringWeigher(), 1);
+    for (int i = 0; i < 100; i++)
+      empty_values.Insert(i, "");
+    assert(8 == empty_values.Size() && 8 == empty_values.Weight());
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  void ConcurrentTest() {
+    const int kCapacity = 1000;
+    const int kNumThreads = 4;
+    IntCache cache(kCapacity);
+    auto worker = [&cache](uint32_t seed) {
+      std::minstd_rand random(seed);
+      for (int i = 0; i < 50000; i++) {
+        const int kKey = random() % (4 * kCapacity);
+        auto result = cache.Lookup(kKey);
+        assert(!result.first || kKey * 3 == result.second);
+        if (!result.first)
+          cache.Insert(kKey, kKey * 3);
+        else if (i % 16 == 0)
+          cache.Remove(kKey);
+      }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kNumThreads; i++)
+      threads.emplace_back(worker, i + 1);
+    for (auto &thread : threads)
+      thread.join();
+    assert(cache.Weight() <= kCapacity && cache.Size() == cache.Weight());
+    auto stats = cache.GetStats();
+    assert(kNumThreads * 50000 == stats.hits + stats.misses);
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  /// @return hit rate and operations per second of the threads doing Lookup and Insert on a miss
+  template <typename Cache>
+  std::pair<double, double> ZipfianRun(Cache &cache, const ZipfianGenerator &keys, uint32_t num_threads) {
+    const int kOperationsPerThread = 200000;
+    auto worker = [&cache, &keys, kOperationsPerThread](uint32_t seed) {
+      std::minstd_rand random(seed);
+      uint64_t num_hits = 0;
+      for (int i = 0; i < kOperationsPerThread; i++) {
+        const int kKey = keys.Next(random);
+        if (cache.Lookup(kKey).first)
+          num_hits++;
+        else
+          cache.Insert(kKey, kKey);
+      }
+      return num_hits;
+    };
+    auto time_start = std::chrono::high_resolution_clock::now();
+    std::vector<std::future<uint64_t>> results;
+    for (uint32_t i = 0; i < num_threads; i++)
+      results.push_back(std::async(std::launch::async, worker, i + 1));
+    uint64_t num_hits = 0;
+    for (auto &result : results)
+      num_hits += result.get();
+    auto time_stop = std::chrono::high_resolution_clock::now();
+    const double kNumOperations = double(num_threads) * kOperationsPerThread;
+    return make_pair(num_hits / kNumOperations,
+                     kNumOperations / std::chrono::duration<double>(time_stop - time_start).count());
+  }
+
+  void ZipfianBenchmark() {
+    const uint64_t kNumKeys = 1 << 20;
+    const uint64_t kCapacity = kNumKeys / 16;
+    const ZipfianGenerator kKeys(kNumKeys, 0.99);
+    std::cout << "\t" << __func__ << ": " << kNumKeys << " keys, capacity " << kCapacity
+        << ", threads / hit rate / operations per second, clock cache vs global LRU" << std::endl;
+    for (uint32_t num_threads : {1u, 2u, 4u, 8u}) {
+      IntCache cache(kCapacity);
+      GlobalLruCache lru(kCapacity);
+      auto clock_result = ZipfianRun(cache, kKeys, num_threads);
+      auto lru_result = ZipfianRun(lru, kKeys, num_threads);
+      assert(clock_result.first > 0.3 && lru_result.first > 0.3);
+      std::cout << "\t\t" << num_threads
+          << " / " << clock_result.first << " / " << static_cast<uint64_t>(clock_result.second)
+          << " vs " << lru_result.first << " / " << static_cast<uint64_t>(lru_result.second) << std::endl;
+    }
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+};
+
+} // namespace tests
+
+#endif //THREADSAFE_HASHMAP_CACHE_TEST_H
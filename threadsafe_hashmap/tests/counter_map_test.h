@@ -0,0 +1,167 @@
+#ifndef THREADSAFE_HASHMAP_COUNTER_MAP_TEST_H
+#define THREADSAFE_HASHMAP_COUNTER_MAP_TEST_H
+
+#ifdef NDEBUG
+#undef NDEBUG
+  #define RESTORE_NDEBUG
+#endif
+
+#include <assert.h>
+
+#ifdef RESTORE_NDEBUG
+#undef RESTORE_NDEBUG
+  #define NDEBUG
+#endif
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../include/counter_map.h"
+#include "../include/threadsafe_hashmap.h"
+
+using std::make_pair;
+
+using my_concurrency::CounterMap;
+using my_concurrency::ThreadsafeHashmap;
+
+namespace tests {
+
+class CounterMapTest {
+ public:
+  void TestAll() {
+    SimpleTest();
+    ConcurrentAddTest<my_concurrency::internals::Bucket>();
+    ConcurrentAddTest<my_concurrency::internals::FlatBucket>();
+    DrainTopKTest();
+    IncrementBenchmark();
+
+    std::cout << "Counter map tests passed." << std::endl;
+  }
+
+ private:
+  void SimpleTest() {
+    CounterMap<std::string> map;
+    assert(make_pair(false, uint64_t(0)) == map.Lookup("a"));
+    assert(1 == map.Add("a"));
+    assert(6 == map.Add("a", 5));
+    assert(10 == map.Add("b", 10));
+    assert(make_pair(true, uint64_t(6)) == map.Lookup("a"));
+    assert(2 == map.Size());
+    assert(map.Remove("a") && !map.Remove("a"));
+    assert(!map.Lookup("a").first && 1 == map.Size());
+    assert(1 == map.Add("a"));
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  /// @brief no increment is lost, while the first additions of the keys grow the table from a few buckets
+  template <template <typename...> class BucketType>
+  void ConcurrentAddTest() {
+    const int kNumKeys = 5000;
+    const int kRounds = 40;
+    const int kNumThreads = 4;
+    CounterMap<int, std::hash<int>, std::equal_to<int>, BucketType> map(4);
+    auto worker = [&map, kNumKeys, kRounds](int shift) {
+      for (int round = 0; round < kRounds; round++)
+        for (int i = 0; i < kNumKeys; i++)
+          map.Add((i + shift) % kNumKeys, i % 3 + 1);
+    };
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kNumThreads; i++)
+      threads.emplace_back(worker, i * kNumKeys / kNumThreads);
+    for (auto &thread : threads)
+      thread.join();
+
+    assert(kNumKeys == (int)map.Size() && map.BucketCount() > 4);
+    for (int i = 0; i < kNumKeys; i++) {
+      uint64_t expected = 0;
+      for (int thread = 0; thread < kNumThreads; thread++)
+        expected += kRounds * ((i - thread * kNumKeys / kNumThreads + kNumKeys) % kNumKeys % 3 + 1);
+      assert(make_pair(true, expected) == map.Lookup(i));
+    }
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  void DrainTopKTest() {
+    const int kNumKeys = 1000;
+    CounterMap<int> map;
+    for (int i = 0; i < kNumKeys; i++)
+      map.Add(i, i);
+    auto top = map.DrainTopK(10);
+    assert(10 == top.size());
+    for (int i = 0; i < 10; i++)
+      assert(make_pair(kNumKeys - 1 - i, uint64_t(kNumKeys - 1 - i)) == top[i]);
+
+    // all of the counters are reset, the keys stay
+    assert(kNumKeys == (int)map.Size());
+    for (int i = 0; i < kNumKeys; i++)
+      assert(make_pair(true, uint64_t(0)) == map.Lookup(i));
+    assert(map.DrainTopK(10).empty());
+
+    map.Add(3, 3);
+    map.Add(5, 1);
+    assert(map.DrainTopK(0).empty()); // drains anyway
+    assert(map.DrainTopK(10).empty());
+    map.Add(3, 3);
+    map.Add(5, 1);
+    top = map.DrainTopK(kNumKeys);
+    assert(2 == top.size() && make_pair(3, uint64_t(3)) == top[0] && make_pair(5, uint64_t(1)) == top[1]);
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  /// @return operations per second of the threads incrementing random keys of a small set
+  template <typename Increment>
+  double IncrementThroughput(uint32_t num_threads, Increment increment) {
+    const int kNumKeys = 1 << 10;
+    const int kOperationsPerThread = 400000;
+    auto worker = [&increment, kOperationsPerThread](uint32_t seed) {
+      uint32_t key = seed;
+      for (int i = 0; i < kOperationsPerThread; i++) {
+        key = key * 1103515245 + 12345;
+        increment(static_cast<int>((key >> 16) % kNumKeys));
+      }
+    };
+    auto time_start = std::chrono::high_resolution_clock::now();
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < num_threads; i++)
+      threads.emplace_back(worker, i + 1);
+    for (auto &thread : threads)
+      thread.join();
+    auto time_stop = std::chrono::high_resolution_clock::now();
+    return num_threads * kOperationsPerThread / std::chrono::duration<double>(time_stop - time_start).count();
+  }
+
+  /// @brief the increment of a plain map (Lookup and Insert, which loses updates, or Upsert under the exclusive
+  ///        bucket lock) against Add of the counter map
+  void IncrementBenchmark() {
+    const uint32_t kNumThreads = std::max(2u, std::thread::hardware_concurrency());
+    ThreadsafeHashmap<int, uint64_t> lookup_insert;
+    ThreadsafeHashmap<int, uint64_t> upsert;
+    CounterMap<int> counters;
+    const double kLookupInsert = IncrementThroughput(kNumThreads, [&lookup_insert](int key) {
+      lookup_insert.Insert(key, lookup_insert.Lookup(key).second + 1);
+    });
+    const double kUpsert = IncrementThroughput(kNumThreads, [&upsert](int key) {
+      upsert.Upsert(key, [](uint64_t &value) { value++; }, []() { return uint64_t(1); });
+    });
+    const double kAdd = IncrementThroughput(kNumThreads, [&counters](int key) { counters.Add(key); });
+
+    uint64_t lost = 0;
+    uint64_t total = 0;
+    for (auto &entry : counters.DrainTopK(1 << 10)) {
+      total += entry.second;
+      lost += entry.second - lookup_insert.Lookup(entry.first).second;
+    }
+    assert(total == kNumThreads * 400000ull);
+    std::cout << "\t" << __func__ << " passed. " << kNumThreads
+        << " threads, increments per second: Lookup + Insert " << static_cast<uint64_t>(kLookupInsert)
+        << " (lost " << lost << "), Upsert " << static_cast<uint64_t>(kUpsert)
+        << ", CounterMap::Add " << static_cast<uint64_t>(kAdd) << std::endl;
+  }
+};
+
+} // namespace tests
+
+#endif //THREADSAFE_HASHMAP_COUNTER_MAP_TEST_H
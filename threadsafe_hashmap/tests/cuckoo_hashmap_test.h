@@ -0,0 +1,206 @@
+#ifndef THREADSAFE_HASHMAP_CUCKOO_HASHMAP_TEST_H
+#define THREADSAFE_HASHMAP_CUCKOO_HASHMAP_TEST_H
+
+#ifdef NDEBUG
+#undef NDEBUG
+  #define RESTORE_NDEBUG
+#endif
+
+#include <assert.h>
+
+#ifdef RESTORE_NDEBUG
+#undef RESTORE_NDEBUG
+  #define NDEBUG
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../include/cuckoo_hashmap.h"
+#include "../include/threadsafe_hashmap.h"
+
+using std::make_pair;
+
+using my_concurrency::CuckooHashmap;
+using my_concurrency::ThreadsafeHashmap;
+
+namespace tests {
+
+class CuckooHashmapTest {
+ public:
+  void TestAll() {
+    SimpleTest();
+    DisplacementTest();
+    ConcurrentWriteRemoveTest();
+    ReadDuringGrowthTest();
+    ThroughputBenchmark();
+
+    std::cout << "Cuckoo hashmap tests passed." << std::endl;
+  }
+
+ private:
+  typedef CuckooHashmap<int, int> Map;
+
+  void SimpleTest() {
+    Map map;
+    assert(map.Empty());
+    map.Insert(1, 10);
+    assert(1 == map.Size() && !map.Empty());
+    assert(make_pair(true, 10) == map.Lookup(1));
+    map.Insert(1, 11);
+    assert(1 == map.Size());
+    assert(make_pair(true, 11) == map.Lookup(1));
+    assert(make_pair(false, 0) == map.Lookup(2));
+    assert(Map::kOperationSuccess == map.Remove(1));
+    assert(Map::kOperationFailed == map.Remove(1));
+    assert(0 == map.Size() && map.Empty());
+
+    for (int i = 0; i < 1000; i++)
+      map.Insert(i, i * 10);
+    assert(1000 == map.Size());
+    for (int i = 0; i < 1000; i++)
+      assert(make_pair(true, i * 10) == map.Lookup(i));
+    const uint64_t kBucketCount = map.BucketCount();
+    map.Clear();
+    assert(map.Empty() && !map.Lookup(1).first && kBucketCount == map.BucketCount());
+    map.Insert(1, 10);
+    assert(make_pair(true, 10) == map.Lookup(1));
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  /// @brief the cuckoo paths fill the table densely before it has to grow
+  void DisplacementTest() {
+    const uint64_t kNumBuckets = 1024;
+    Map map(kNumBuckets);
+    int num_inserted = 0;
+    while (map.BucketCount() == kNumBuckets) {
+      map.Insert(num_inserted, num_inserted);
+      num_inserted++;
+    }
+    const double kLoadFactor = double(num_inserted - 1) / (kNumBuckets * Map::kSlotsPerBucket);
+    assert(kLoadFactor > 0.9);
+
+    for (int i = 0; i < 4 * num_inserted; i++)
+      map.Insert(i, i + 1);
+    assert(4 * num_inserted == (int)map.Size());
+    for (int i = 0; i < 4 * num_inserted; i++)
+      assert(make_pair(true, i + 1) == map.Lookup(i));
+    std::cout << "\t" << __func__ << " passed. Load factor before the first growth: " << kLoadFactor << std::endl;
+  }
+
+  void ConcurrentWriteRemoveTest() {
+    Map map;
+    const int kDataSize = 10001;
+    auto writer = [&map, kDataSize] () {
+      for (int i = 0; i < kDataSize; i++)
+        map.Insert(i, i * 10);
+    };
+
+    auto remove_even = [&map, kDataSize] () {
+      int counter = 0;
+      while (counter < kDataSize / 2) {
+        for (int i = 0; i < kDataSize; i += 2)
+          counter += map.Remove(i)? 1 : 0;
+      }
+    };
+    std::thread t1(writer);
+    std::thread t2(remove_even);
+    t1.join();
+    t2.join();
+    for (int i = 0; i < kDataSize; i++)
+      assert(make_pair((i & 1) == 1, (i & 1) == 1? i * 10 : 0) == map.Lookup(i));
+
+    assert(kDataSize / 2 == (int)map.Size());
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  /// @brief the elements moved by the displacements and the growths stay visible to the lookups
+  void ReadDuringGrowthTest() {
+    const int kStable = 20000;
+    const int kAdded = 200000;
+    Map map;
+    for (int i = 0; i < kStable; i++)
+      map.Insert(i, i * 3);
+
+    std::atomic<bool> is_done(false);
+    auto reader = [&map, &is_done, kStable] () {
+      uint64_t num_lookups = 0;
+      while (!is_done.load()) {
+        for (int i = 0; i < kStable; i += 7, num_lookups++)
+          assert(make_pair(true, i * 3) == map.Lookup(i));
+      }
+      return num_lookups;
+    };
+    std::vector<std::future<uint64_t>> readers;
+    for (int i = 0; i < 3; i++)
+      readers.push_back(std::async(std::launch::async, reader));
+    for (int i = kStable; i < kStable + kAdded; i++)
+      map.Insert(i, i * 3);
+    is_done = true;
+    for (auto &result : readers)
+      assert(result.get() > 0);
+    assert(kStable + kAdded == (int)map.Size());
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  /// @return operations per second of the threads doing random Lookup, and Insert of existing keys
+  template <typename TestedMap>
+  double MixThroughput(uint32_t num_threads, uint32_t writes_per_hundred) {
+    const uint64_t kNumKeys = 1 << 16;
+    const int kOperationsPerThread = 400000;
+    TestedMap map;
+    for (uint64_t i = 0; i < kNumKeys; i++)
+      map.Insert(i, i);
+
+    auto worker = [&map, kNumKeys, kOperationsPerThread, writes_per_hundred](uint32_t seed) {
+      std::minstd_rand random(seed);
+      uint64_t num_found = 0;
+      for (int i = 0; i < kOperationsPerThread; i++) {
+        const uint64_t kKey = random() % kNumKeys;
+        if (random() % 100 < writes_per_hundred)
+          map.Insert(kKey, kKey + i);
+        else
+          num_found += map.Lookup(kKey).first? 1 : 0;
+      }
+      return num_found;
+    };
+
+    auto time_start = std::chrono::high_resolution_clock::now();
+    std::vector<std::future<uint64_t>> results;
+    for (uint32_t i = 0; i < num_threads; i++)
+      results.push_back(std::async(std::launch::async, worker, i + 1));
+    for (auto &result : results)
+      assert(result.get() > 0);
+    auto time_stop = std::chrono::high_resolution_clock::now();
+    assert(kNumKeys == map.Size());
+    double elapsed_s = std::chrono::duration<double>(time_stop - time_start).count();
+    return num_threads * kOperationsPerThread / elapsed_s;
+  }
+
+  void ThroughputBenchmark() {
+    typedef ThreadsafeHashmap<uint64_t, uint64_t> ChainedMap;
+    typedef ThreadsafeHashmap<uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>,
+                              my_concurrency::internals::OptimisticReadBucket> OptimisticMap;
+    typedef CuckooHashmap<uint64_t, uint64_t> CuckooMap;
+    const uint32_t kNumThreads = std::max(2u, std::thread::hardware_concurrency());
+    const uint32_t kWritesPerHundred[] = {0, 1, 5, 20};
+    std::cout << "\t" << __func__ << ": " << kNumThreads
+        << " threads, operations per second, reads/writes / chained / optimistic chained / cuckoo" << std::endl;
+    for (uint32_t writes : kWritesPerHundred) {
+      std::cout << "\t\t" << 100 - writes << "/" << writes
+          << " / " << static_cast<uint64_t>(MixThroughput<ChainedMap>(kNumThreads, writes))
+          << " / " << static_cast<uint64_t>(MixThroughput<OptimisticMap>(kNumThreads, writes))
+          << " / " << static_cast<uint64_t>(MixThroughput<CuckooMap>(kNumThreads, writes)) << std::endl;
+    }
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+};
+
+} // namespace tests
+
+#endif //THREADSAFE_HASHMAP_CUCKOO_HASHMAP_TEST_H
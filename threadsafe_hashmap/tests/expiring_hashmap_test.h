@@ -0,0 +1,155 @@
+#ifndef THREADSAFE_HASHMAP_EXPIRING_HASHMAP_TEST_H
+#define THREADSAFE_HASHMAP_EXPIRING_HASHMAP_TEST_H
+
+#ifdef NDEBUG
+#undef NDEBUG
+  #define RESTORE_NDEBUG
+#endif
+
+#include <assert.h>
+
+#ifdef RESTORE_NDEBUG
+#undef RESTORE_NDEBUG
+  #define NDEBUG
+#endif
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "../include/expiring_hashmap.h"
+#include "../include/threadsafe_hashmap.h"
+
+using std::make_pair;
+
+using my_concurrency::ExpiringHashmap;
+
+namespace tests {
+
+class ExpiringHashmapTest {
+ public:
+  void TestAll() {
+    ExpiryTest();
+    AmortizedSweepTest();
+    SweeperTest();
+    LookupBenchmark();
+
+    std::cout << "Expiring hashmap tests passed." << std::endl;
+  }
+
+ private:
+  typedef ExpiringHashmap<int, int> Map;
+
+  /// @brief the coarse clock moves in ticks, so the waits exceed the deadlines by a few of them
+  static void SleepPast(std::chrono::milliseconds ttl) {
+    std::this_thread::sleep_for(ttl + std::chrono::milliseconds(20));
+  }
+
+  void ExpiryTest() {
+    const std::chrono::milliseconds kTtl(30);
+    Map map;
+    map.Insert(1, 10);
+    map.Insert(2, 20, kTtl);
+    map.Insert(3, 30, std::chrono::milliseconds(0)); // expired at once
+    map.Insert(4, 40, std::chrono::hours(1));
+    assert(make_pair(true, 10) == map.Lookup(1));
+    assert(make_pair(true, 20) == map.Lookup(2));
+    assert(make_pair(false, 0) == map.Lookup(3));
+
+    SleepPast(kTtl);
+    assert(make_pair(false, 0) == map.Lookup(2));
+    assert(make_pair(true, 10) == map.Lookup(1) && make_pair(true, 40) == map.Lookup(4));
+    int num_visited = 0;
+    map.ForEach([&num_visited](const int &key, const int &) {
+      assert(1 == key || 4 == key);
+      num_visited++;
+    });
+    assert(2 == num_visited);
+
+    // the expired elements stay in the table until a sweep goes through their buckets
+    assert(4 == map.Size());
+    assert(2 == map.Sweep(map.BucketCount()));
+    assert(2 == map.Size());
+
+    // an overwrite takes the new deadline
+    map.Insert(2, 21, std::chrono::hours(1));
+    map.Insert(1, 11, std::chrono::milliseconds(0));
+    assert(make_pair(true, 21) == map.Lookup(2) && !map.Lookup(1).first);
+    assert(map.Remove(1) && !map.Remove(1));
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  /// @brief the writes alone reclaim the expired elements, no separate thread removes them
+  void AmortizedSweepTest() {
+    const int kDataSize = 10000;
+    const std::chrono::milliseconds kTtl(30);
+    Map map(kDataSize);
+    for (int i = 0; i < kDataSize; i++)
+      map.Insert(i, i, kTtl);
+    SleepPast(kTtl);
+
+    // the writes to another map in between do not take the sweep steps of this one
+    Map other(16);
+    const uint64_t kWritesPerTable = map.BucketCount() / Map::kBucketsPerSweepStep * Map::kWritesPerSweepStep;
+    for (uint64_t i = 0; i < kWritesPerTable + Map::kWritesPerSweepStep; i++) {
+      map.Insert(kDataSize + static_cast<int>(i % 100), 0);
+      other.Insert(static_cast<int>(i % 100), 0);
+    }
+    assert(100 == map.Size());
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  void SweeperTest() {
+    const int kDataSize = 50000;
+    const std::chrono::milliseconds kTtl(20);
+    Map map;
+    map.StartSweeper(256, std::chrono::milliseconds(1));
+    for (int i = 0; i < kDataSize; i++)
+      map.Insert(i, i, i % 2 == 0? kTtl : std::chrono::hours(1));
+    const auto kGiveUp = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (map.Size() > kDataSize / 2 && std::chrono::steady_clock::now() < kGiveUp)
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    map.StopSweeper();
+    assert(kDataSize / 2 == (int)map.Size());
+    for (int i = 0; i < kDataSize; i++)
+      assert(map.Lookup(i).first == (i % 2 == 1));
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  /// @brief cost of the deadline check: the clock read and the wider values
+  void LookupBenchmark() {
+    const int kDataSize = 100000;
+    const int kRounds = 10;
+    ThreadsafeHashmap<int, int> plain;
+    Map expiring;
+    for (int i = 0; i < kDataSize; i++) {
+      plain.Insert(i, i);
+      expiring.Insert(i, i, std::chrono::hours(1));
+    }
+
+    uint64_t num_found = 0;
+    auto time_start = std::chrono::high_resolution_clock::now();
+    for (int round = 0; round < kRounds; round++)
+      for (int i = 0; i < kDataSize; i++)
+        num_found += plain.Lookup(i).first? 1 : 0;
+    auto time_plain = std::chrono::high_resolution_clock::now();
+    for (int round = 0; round < kRounds; round++)
+      for (int i = 0; i < kDataSize; i++)
+        num_found += expiring.Lookup(i).first? 1 : 0;
+    auto time_expiring = std::chrono::high_resolution_clock::now();
+    assert(2 * kRounds * kDataSize == (int)num_found);
+
+    const double kNumLookups = double(kRounds) * kDataSize;
+    std::cout << "\t" << __func__ << " passed. Nanoseconds per lookup: plain "
+        << static_cast<uint64_t>(std::chrono::duration<double, std::nano>(time_plain - time_start).count()
+                                 / kNumLookups)
+        << ", with deadlines "
+        << static_cast<uint64_t>(std::chrono::duration<double, std::nano>(time_expiring - time_plain).count()
+                                 / kNumLookups) << std::endl;
+  }
+};
+
+} // namespace tests
+
+#endif //THREADSAFE_HASHMAP_EXPIRING_HASHMAP_TEST_H
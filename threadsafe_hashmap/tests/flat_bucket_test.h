@@ -0,0 +1,197 @@
+#ifndef THREADSAFE_HASHMAP_FLAT_BUCKET_TEST_H
+#define THREADSAFE_HASHMAP_FLAT_BUCKET_TEST_H
+
+#ifdef NDEBUG
+#undef NDEBUG
+  #define RESTORE_NDEBUG
+#endif
+
+#include <assert.h>
+
+#ifdef RESTORE_NDEBUG
+#undef RESTORE_NDEBUG
+  #define NDEBUG
+#endif
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/flat_bucket.h"
+
+using std::make_pair;
+
+using my_concurrency::internals::FlatBucket;
+
+namespace tests {
+
+class FlatBucketTest {
+ public:
+  void TestAll() {
+    SingleInsertTest();
+    OverwriteTest();
+    OverflowGroupsTest();
+    RemoveTest();
+    CopyTest();
+    MigrateTest();
+    NonTrivialTypesTest();
+    ManyWritersTest();
+
+    std::cout << "Flat bucket tests passed." << std::endl;
+  }
+
+ private:
+  typedef FlatBucket<int, int> Bucket;
+
+  /// @brief all of the keys share the same tag, so every probe has to compare keys
+  static uint64_t CollidingHash(int) { return 42; }
+
+  void SingleInsertTest() {
+    Bucket bucket;
+    assert(bucket.Empty());
+    assert(bucket.Insert(1, 1, 10));
+    assert(1 == bucket.Size());
+    assert(!bucket.Empty());
+    assert(make_pair(true, 10) == bucket.Lookup(1, 1));
+    assert(make_pair(false, 0) == bucket.Lookup(2, 2));
+    bucket.Clear();
+    assert(bucket.Empty());
+    assert(make_pair(false, 0) == bucket.Lookup(1, 1));
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  void OverwriteTest() {
+    Bucket bucket;
+    assert(bucket.Insert(CollidingHash(1), 1, 10));
+    assert(bucket.Insert(CollidingHash(2), 2, 20));
+    assert(!bucket.Insert(CollidingHash(1), 1, 11));
+    assert(2 == bucket.Size());
+    assert(make_pair(true, 11) == bucket.Lookup(CollidingHash(1), 1));
+    assert(make_pair(true, 20) == bucket.Lookup(CollidingHash(2), 2));
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  void OverflowGroupsTest() {
+    Bucket bucket;
+    const int kNumElements = 5 * Bucket::kGroupSize + 3;
+    for (int i = 0; i < kNumElements; i++)
+      assert(bucket.Insert(CollidingHash(i), i, i * 10));
+    assert(kNumElements == (int)bucket.Size());
+
+    for (int i = 0; i < kNumElements; i++)
+      assert(make_pair(true, i * 10) == bucket.Lookup(CollidingHash(i), i));
+    assert(make_pair(false, 0) == bucket.Lookup(CollidingHash(kNumElements), kNumElements));
+
+    // empties the overflow groups one by one
+    for (int i = kNumElements - 1; i >= 0; i--) {
+      assert(bucket.Remove(CollidingHash(i), i));
+      for (int j = 0; j < i; j++)
+        assert(make_pair(true, j * 10) == bucket.Lookup(CollidingHash(j), j));
+    }
+    assert(bucket.Empty());
+
+    for (int i = 0; i < kNumElements; i++)
+      assert(bucket.Insert(i, i, i));
+    assert(kNumElements == (int)bucket.Size());
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  void RemoveTest() {
+    Bucket bucket;
+    assert(Bucket::kOperationFailed == bucket.Remove(0, 0));
+    for (int i = 0; i < 10; i++)
+      bucket.Insert(i, i, i * 10);
+
+    assert(bucket.Remove(4, 4));
+    assert(!bucket.Remove(4, 4));
+    assert(make_pair(false, 0) == bucket.Lookup(4, 4));
+    assert(9 == bucket.Size());
+
+    // a freed slot is reused
+    assert(bucket.Insert(100, 100, 1000));
+    assert(make_pair(true, 1000) == bucket.Lookup(100, 100));
+    assert(10 == bucket.Size());
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  void CopyTest() {
+    Bucket bucket;
+    for (int i = 0; i < 40; i++)
+      bucket.Insert(i, i, i * 10);
+
+    Bucket copied = bucket;
+    bucket.Clear();
+    assert(40 == copied.Size());
+    for (int i = 0; i < 40; i++)
+      assert(make_pair(true, i * 10) == copied.Lookup(i, i));
+
+    copied = copied;
+    assert(40 == copied.Size());
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  void MigrateTest() {
+    Bucket source;
+    const int kNumElements = 50;
+    for (int i = 0; i < kNumElements; i++)
+      source.Insert(i, i, i * 10);
+
+    Bucket destinations[3];
+    auto hasher = [](const int &key) { return static_cast<uint64_t>(key); };
+    auto router = [&destinations](uint64_t hash) -> Bucket & { return destinations[hash % 3]; };
+    assert(kNumElements == (int)source.MigrateTo(hasher, router));
+    assert(source.Empty());
+
+    uint64_t total = 0;
+    for (auto &bucket : destinations)
+      total += bucket.Size();
+    assert(kNumElements == (int)total);
+    for (int i = 0; i < kNumElements; i++)
+      assert(make_pair(true, i * 10) == destinations[i % 3].Lookup(i, i));
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  void NonTrivialTypesTest() {
+    FlatBucket<std::string, std::unique_ptr<int>> bucket;
+    std::hash<std::string> hasher;
+    for (int i = 0; i < 20; i++) {
+      auto key = std::to_string(i);
+      bucket.Insert(hasher(key), std::move(key), nullptr);
+    }
+    assert(20 == bucket.Size());
+    assert(bucket.Remove(hasher("7"), "7"));
+    assert(!bucket.Remove(hasher("7"), "7"));
+    bucket.Clear();
+    assert(bucket.Empty());
+
+    FlatBucket<std::string, std::string> strings;
+    strings.Insert(hasher("key"), "key", std::string(100, 'x'));
+    assert(make_pair(true, std::string(100, 'x')) == strings.Lookup(hasher("key"), "key"));
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  void ManyWritersTest() {
+    Bucket bucket;
+    const int kNumElements = 101;
+    auto writer = [&bucket, kNumElements] (bool do_write_even) {
+      for (int i = do_write_even? 0 : 1; i < kNumElements; i += 2)
+        bucket.Insert(CollidingHash(i), i, i);
+    };
+
+    std::thread odd_writer(writer, false);
+    std::thread even_writer(writer, true);
+    odd_writer.join();
+    even_writer.join();
+
+    assert(kNumElements == (int)bucket.Size());
+    for (int i = 0; i < kNumElements; i++)
+      assert(make_pair(true, i) == bucket.Lookup(CollidingHash(i), i));
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+};
+
+} // namespace tests
+
+#endif //THREADSAFE_HASHMAP_FLAT_BUCKET_TEST_H
@@ -13,17 +13,38 @@
   #define NDEBUG
 #endif
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
 #include <random>
 #include <set>
+#include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
 #include "../include/threadsafe_hashmap.h"
+#include "allocation_counter.h"
 
+using my_concurrency::ModuloIndexing;
+using my_concurrency::PowerOfTwoIndexing;
+using my_concurrency::StringHash;
 using my_concurrency::ThreadsafeHashmap;
+using my_concurrency::internals::EpochDomain;
+using my_concurrency::internals::EpochGuard;
 
 namespace tests {
 
+/// @tparam BucketType storage backend of the tested map
+/// @tparam NodeAllocator node allocator of the tested map
+/// @tparam IndexPolicy bucket index policy of the tested map
+template <template <typename...> class BucketType = my_concurrency::internals::Bucket,
+          typename NodeAllocator = my_concurrency::internals::HeapNodeAllocator,
+          typename IndexPolicy = ModuloIndexing>
 class ConcurrentMapTest {
  public:
   void TestAll() {
@@ -35,6 +56,30 @@ class ConcurrentMapTest {
     ParallelInsert();
     ParallelResizeTest();
     ConcurrentWriteRemoveTest();
+    SizeTest();
+    ParallelMaintenanceTest();
+    ForEachTest();
+    BulkLoadTest();
+    RemoveIfTest();
+    ReadHeavyTest();
+    BackgroundResizeTest();
+    MoveAssignWhileResizingTest();
+    ResizeStatsTest();
+    StatsTest();
+    ShrinkTest();
+    ShrinkToFitTest();
+    RetiredTablesTest();
+    BatchTest();
+    VisitUpsertTest();
+    EmplaceTest();
+    HeterogeneousLookupTest();
+    CooperativeResizeBenchmark();
+    HashingBenchmark();
+    GrowthLatencyBenchmark();
+    BatchBenchmark();
+    HeterogeneousLookupBenchmark();
+    StringKeysBenchmark();
+    MemoryPerEntryBenchmark();
     HighLoadTest();
 
     std::cout << "Concurrent Hashmap tests passed." << std::endl;
@@ -43,7 +88,26 @@ class ConcurrentMapTest {
  private:
   std::vector<int> keys{1, 2, 5, 7, 11, 13, 17, 19, 20};
 
-  typedef ThreadsafeHashmap<int, int> Map;
+  template <typename KeyType, typename ValueType, typename Hasher = std::hash<KeyType>,
+            typename KeyEqual = std::equal_to<KeyType>>
+  using TestedMap = ThreadsafeHashmap<KeyType, ValueType, Hasher, KeyEqual, BucketType, NodeAllocator, IndexPolicy>;
+
+  typedef TestedMap<int, int> Map;
+  typedef TestedMap<std::string, int, StringHash, std::equal_to<>> StringMap;
+
+  /// @brief value which counts all of its constructions
+  struct Tracked {
+    int payload = 0;
+    Tracked() { Constructions()++; }
+    Tracked(int lhs, int rhs) : payload(lhs + rhs) { Constructions()++; }
+    Tracked(const Tracked &rhs) : payload(rhs.payload) { Constructions()++; }
+    Tracked &operator=(const Tracked &rhs) = default;
+
+    static int &Constructions() {
+      static int counter = 0;
+      return counter;
+    }
+  };
 
   void SimpleTests() {
     Map map;
@@ -85,7 +149,7 @@ class ConcurrentMapTest {
     x.values.push_back(1);
     SomeStruct y;
     x.values.push_back(2);
-    ThreadsafeHashmap<int, SomeStruct> map_to;
+    TestedMap<int, SomeStruct> map_to;
     map_to.Insert(1, x);
     map_to.Insert(2, y);
     assert(make_pair(true, x) == map_to.Lookup(1));
@@ -94,10 +158,22 @@ class ConcurrentMapTest {
       return t.values.size() == 0? 0ull : (uint64_t) t.values.front();
     };
 
-    ThreadsafeHashmap<SomeStruct, SomeStruct> map(64, custom_hash);
+    TestedMap<SomeStruct, SomeStruct, decltype(custom_hash)> map(64, custom_hash);
     map.Insert(x, y);
     map.Insert(y, x);
     assert(make_pair(true, y) == map.Lookup(x));
+
+    // keys are equal by the first value only, the hash is consistent with it
+    auto first_equal = [] (const SomeStruct &lhs, const SomeStruct &rhs) {
+      return lhs.values.empty()? rhs.values.empty() : !rhs.values.empty() && lhs.values[0] == rhs.values[0];
+    };
+    TestedMap<SomeStruct, int, decltype(custom_hash), decltype(first_equal)> first_map(64, custom_hash, first_equal);
+    SomeStruct z;
+    z.values.push_back(1);
+    first_map.Insert(x, 1);
+    first_map.Insert(z, 2);
+    assert(1 == first_map.Size());
+    assert(make_pair(true, 2) == first_map.Lookup(x));
     std::cout << "\t" << __func__ << " passed" << std::endl;
   }
 
@@ -258,6 +334,903 @@ class ConcurrentMapTest {
     std::cout << "\t" << __func__ << " passed" << std::endl;
   }
 
+  void SizeTest() {
+    Map map(16);
+    const int kNumThreads = 4;
+    const int kChunkSize = 20000;
+    std::atomic_bool is_writing(true);
+    auto writer = [&map, kChunkSize] (int start_value) {
+      for (int i = start_value; i < start_value + kChunkSize; i++)
+        map.Insert(i, i);
+      for (int i = start_value; i < start_value + kChunkSize; i += 2)
+        map.Remove(i);
+    };
+    auto reader = [&map, &is_writing, kNumThreads, kChunkSize] () {
+      while (is_writing) {
+        assert(map.SizeExact() <= uint64_t(kNumThreads * kChunkSize));
+        // a removal seen without its insertion must not wrap the estimate around
+        assert(map.Size() <= uint64_t(2 * kNumThreads * kChunkSize));
+        std::this_thread::yield();
+      }
+    };
+    std::thread size_reader(reader);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kNumThreads; i++)
+      threads.push_back(std::thread(writer, i * kChunkSize));
+    for (auto &thread : threads)
+      thread.join();
+    is_writing = false;
+    size_reader.join();
+
+    assert(kNumThreads * kChunkSize / 2 == (int)map.SizeExact());
+    assert(map.Size() == map.SizeExact());
+    map.Clear();
+    assert(0 == map.Size() && 0 == map.SizeExact());
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  /// @brief snapshot copy and Clear done by the maintenance threads vs by the calling thread
+  void ParallelMaintenanceTest() {
+    const int kDataSize = 200000;
+    const uint32_t kNumThreads = 4;
+    std::cout << "\t" << __func__ << ": threads / copy microseconds / clear microseconds:";
+    for (uint32_t num_threads : {1u, kNumThreads}) {
+      Map map(kDataSize);
+      map.SetMaintenanceThreads(num_threads);
+      for (int i = 0; i < kDataSize; i++)
+        map.Insert(i, i);
+
+      auto time_start = std::chrono::high_resolution_clock::now();
+      Map copied(map);
+      auto time_copied = std::chrono::high_resolution_clock::now();
+      assert(kDataSize == (int)copied.Size());
+      for (int i = 0; i < kDataSize; i++)
+        assert(make_pair(true, i) == copied.Lookup(i));
+      auto time_clear = std::chrono::high_resolution_clock::now();
+      copied.Clear();
+      auto time_cleared = std::chrono::high_resolution_clock::now();
+      assert(copied.Empty() && !copied.Lookup(1).first);
+      copied.Insert(1, 1);
+      assert(1 == copied.Size() && kDataSize == (int)map.Size());
+      std::cout << " " << num_threads
+          << " / " << std::chrono::duration_cast<std::chrono::microseconds>(time_copied - time_start).count()
+          << " / " << std::chrono::duration_cast<std::chrono::microseconds>(time_cleared - time_clear).count();
+    }
+    std::cout << std::endl;
+
+    // Clear meets the resizings of a concurrent writer
+    Map map(16);
+    map.SetMaintenanceThreads(kNumThreads);
+    std::thread writer([&map, kDataSize]() {
+      for (int i = 0; i < kDataSize; i++)
+        map.Insert(i, i);
+    });
+    for (int i = 0; i < 5; i++) {
+      map.Clear();
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    writer.join();
+    int num_found = 0;
+    for (int i = 0; i < kDataSize; i++)
+      num_found += map.Lookup(i).first? 1 : 0;
+    assert(num_found == (int)map.SizeExact());
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  /// @brief every element is visited once by the traversals, also when they meet the resizings of a writer
+  void ForEachTest() {
+    const int kDataSize = 50000;
+    Map map(16);
+    for (int i = 0; i < kDataSize; i++)
+      map.Insert(i, i * 10);
+
+    std::vector<std::atomic<int>> visits(kDataSize);
+    auto count_visit = [&visits](const int &key, const int &value) {
+      assert(key * 10 == value);
+      visits[key]++;
+    };
+    map.ForEach(count_visit);
+    map.ParallelForEach(count_visit, 4);
+    for (auto iter = map.Begin(); iter != map.End(); ++iter)
+      count_visit(iter->first, iter->second);
+    for (int i = 0; i < kDataSize; i++)
+      assert(3 == visits[i].load());
+
+    // the elements present during the whole traversal are visited once, the others at most once
+    std::thread writer([&map, kDataSize]() {
+      for (int i = kDataSize; i < 4 * kDataSize; i++)
+        map.Insert(i, i * 10);
+    });
+    for (int round = 0; round < 5; round++) {
+      std::vector<std::atomic<int>> round_visits(4 * kDataSize);
+      map.ParallelForEach([&round_visits](const int &key, const int &value) {
+        assert(key * 10 == value);
+        round_visits[key]++;
+      }, 4);
+      for (int i = 0; i < 4 * kDataSize; i++)
+        assert(round_visits[i].load() == (i < kDataSize? 1 : round_visits[i].load() > 0));
+    }
+    writer.join();
+
+    // an iterator kept alive does not hold the resizings back, it still visits the old elements once
+    const int kOldSize = 100;
+    Map growing(16);
+    for (int i = 0; i < kOldSize; i++)
+      growing.Insert(i, i * 10);
+    const uint64_t kBucketsBefore = growing.BucketCount();
+    std::vector<int> iterated(20 * kOldSize);
+    auto iter = growing.Begin();
+    iterated[iter->first]++;
+    for (int i = kOldSize; i < 20 * kOldSize; i++)
+      growing.Insert(i, i * 10);
+    assert(growing.BucketCount() > kBucketsBefore);
+    for (++iter; iter != growing.End(); ++iter) {
+      assert(iter->first * 10 == iter->second);
+      iterated[iter->first]++;
+    }
+    for (int i = 0; i < 20 * kOldSize; i++)
+      assert(iterated[i] == (i < kOldSize? 1 : iterated[i] > 0));
+
+    // the traversal drains the old buckets it passes and finds their elements in the new table
+    Map resizing(16);
+    resizing.StartBackgroundResizing(1, std::chrono::seconds(60));
+    for (int i = 0; i < kOldSize; i++)
+      resizing.Insert(i, i * 10);
+    std::vector<int> resizing_visits(kOldSize);
+    resizing.ForEach([&resizing_visits](const int &key, const int &) { resizing_visits[key]++; });
+    for (int i = 0; i < kOldSize; i++)
+      assert(1 == resizing_visits[i] && make_pair(true, i * 10) == resizing.Lookup(i));
+    resizing.StopBackgroundResizing();
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  /// @brief Reserve and the bulk load build the table without resizing, the bulk load vs one Insert per element
+  void BulkLoadTest() {
+    const int kDataSize = 200000;
+    const uint32_t kNumThreads = 4;
+    std::vector<std::pair<int, int>> elements;
+    for (int i = 0; i < kDataSize; i++)
+      elements.emplace_back(i, i);
+    // the later of duplicate keys wins
+    for (int i = 0; i < kDataSize; i += 3)
+      elements.emplace_back(i, -i);
+
+    auto time_start = std::chrono::high_resolution_clock::now();
+    Map inserted;
+    for (auto &element : elements)
+      inserted.Insert(element.first, element.second);
+    auto time_inserted = std::chrono::high_resolution_clock::now();
+    Map loaded(elements, kNumThreads);
+    auto time_loaded = std::chrono::high_resolution_clock::now();
+
+    assert(0 == loaded.LastResizeStats().num_resizes);
+    assert(kDataSize == (int)loaded.Size() && kDataSize == (int)loaded.SizeExact());
+    for (int i = 0; i < kDataSize; i++)
+      assert(make_pair(true, i % 3 == 0? -i : i) == loaded.Lookup(i));
+    loaded.Insert(kDataSize, kDataSize);
+    assert(make_pair(true, kDataSize) == loaded.Lookup(kDataSize));
+
+    // an input range which is not random access
+    std::map<int, int> ordered = {{1, 10}, {2, 20}, {3, 30}};
+    Map from_ordered(ordered.begin(), ordered.end());
+    assert(3 == from_ordered.Size() && make_pair(true, 20) == from_ordered.Lookup(2));
+    Map from_empty(elements.begin(), elements.begin());
+    assert(from_empty.Empty() && !from_empty.Lookup(1).first);
+
+    Map reserved;
+    reserved.Reserve(kDataSize);
+    const uint64_t kReservedBuckets = reserved.BucketCount();
+    const uint64_t kNumResizes = reserved.LastResizeStats().num_resizes;
+    reserved.Reserve(kDataSize / 2);
+    assert(kReservedBuckets == reserved.BucketCount());
+    for (int i = 0; i < kDataSize; i++)
+      reserved.Insert(i, i);
+    assert(kReservedBuckets == reserved.BucketCount() && kNumResizes == reserved.LastResizeStats().num_resizes);
+    // a filled map is grown by the caller
+    reserved.Reserve(2 * kDataSize);
+    assert(reserved.BucketCount() > kReservedBuckets && kDataSize == (int)reserved.Size());
+    for (int i = 0; i < kDataSize; i++)
+      assert(make_pair(true, i) == reserved.Lookup(i));
+
+    std::cout << "\t" << __func__ << " passed. Microseconds elapsed: Insert "
+        << std::chrono::duration_cast<std::chrono::microseconds>(time_inserted - time_start).count()
+        << ", bulk load with " << kNumThreads << " threads "
+        << std::chrono::duration_cast<std::chrono::microseconds>(time_loaded - time_inserted).count() << std::endl;
+  }
+
+  /// @brief the bounded sweeps remove every matching element once they went through the whole table
+  void RemoveIfTest() {
+    const int kDataSize = 20000;
+    Map map(16);
+    for (int i = 0; i < kDataSize; i++)
+      map.Insert(i, i);
+    auto is_odd = [](const int &key, const int &value) {
+      assert(key == value);
+      return key % 2 == 1;
+    };
+    const uint64_t kNumBuckets = map.BucketCount();
+    uint64_t num_removed = 0;
+    for (uint64_t swept = 0; swept < kNumBuckets; swept += 100)
+      num_removed += map.RemoveIf(is_odd, 100);
+    assert(kDataSize / 2 == (int)num_removed && kDataSize / 2 == (int)map.SizeExact());
+    for (int i = 0; i < kDataSize; i++)
+      assert(map.Lookup(i).first == (i % 2 == 0));
+    assert(0 == map.RemoveIf(is_odd, kNumBuckets));
+
+    // the sweeps meet the resizings of a concurrent writer
+    std::thread writer([&map, kDataSize]() {
+      for (int i = kDataSize; i < 4 * kDataSize; i++)
+        map.Insert(i, i);
+    });
+    while (map.Size() < 2 * kDataSize)
+      map.RemoveIf(is_odd, 64);
+    writer.join();
+    while (map.RemoveIf(is_odd, map.BucketCount()) > 0) { }
+    for (int i = 0; i < 4 * kDataSize; i++)
+      assert(map.Lookup(i).first == (i % 2 == 0));
+    assert(2 * kDataSize == (int)map.SizeExact());
+
+    // a shrink leaves old buckets above the new bucket count, one whole sweep reaches them too
+    Map shrinking(16);
+    for (int i = 0; i < kDataSize; i++)
+      shrinking.Insert(i, i);
+    const uint64_t kBucketsBeforeShrink = shrinking.BucketCount();
+    shrinking.StartBackgroundResizing(1, std::chrono::seconds(60));
+    shrinking.SetMinLoadFactor(0.2);
+    for (int i = kDataSize / 4; i < kDataSize; i++)
+      shrinking.Remove(i);
+    assert(shrinking.BucketCount() < kBucketsBeforeShrink);
+    assert(kDataSize / 8 == (int)shrinking.RemoveIf(is_odd, kBucketsBeforeShrink));
+    for (int i = 0; i < kDataSize / 4; i++)
+      assert(shrinking.Lookup(i).first == (i % 2 == 0));
+    shrinking.StopBackgroundResizing();
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  void ReadHeavyTest() {
+    Map map;
+    const int kDataSize = 100000;
+    for (int i = 0; i < kDataSize; i++)
+      map.Insert(i, i * 10);
+
+    auto reader = [&map, kDataSize] () {
+      uint64_t num_found = 0;
+      for (int round = 0; round < 10; round++)
+        for (int i = 0; i < 2 * kDataSize; i += 2)
+          num_found += map.Lookup(i).first? 1 : 0;
+      return num_found;
+    };
+
+    auto time_start = std::chrono::high_resolution_clock::now();
+    std::vector<std::future<uint64_t>> results;
+    for (uint32_t i = 0; i < std::max(2u, std::thread::hardware_concurrency()); i++)
+      results.push_back(std::async(std::launch::async, reader));
+    for (auto &result : results)
+      assert(10 * kDataSize / 2 == result.get());
+    auto time_stop = std::chrono::high_resolution_clock::now();
+    auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(time_stop - time_start).count();
+    std::cout << "\t" << __func__ << " passed. Microseconds elapsed: " << elapsed_us << std::endl;
+  }
+
+  void BackgroundResizeTest() {
+    Map map(16);
+    map.StartBackgroundResizing(64, std::chrono::microseconds(10));
+    const int kChunkSize = 5000;
+    auto writer = [&map, kChunkSize] (int start_value) {
+      for (int i = start_value; i < start_value + kChunkSize; i++) {
+        map.Insert(i, i * 10);
+        if (i % 3 == 0)
+          assert(map.Remove(i));
+      }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 3; i++)
+      threads.push_back(std::thread(writer, i * kChunkSize));
+    for (auto &thread : threads)
+      thread.join();
+
+    for (int i = 0; i < 3 * kChunkSize; i++)
+      assert(make_pair(i % 3 != 0, i % 3 != 0? i * 10 : 0) == map.Lookup(i));
+    assert(2 * kChunkSize == (int)map.Size());
+
+    // the callers finish the resizing when the resizer is gone
+    map.StopBackgroundResizing();
+    for (int i = 0; i < 3 * kChunkSize; i++)
+      map.Insert(i, i);
+    for (int i = 0; i < 3 * kChunkSize; i++)
+      assert(make_pair(true, i) == map.Lookup(i));
+    assert(3 * kChunkSize == (int)map.Size());
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  /// @brief the map takes over the resizing of the moved one: its own drained cursor would skip the old table
+  void MoveAssignWhileResizingTest() {
+    const int kDataSize = 100;
+    Map map(16);
+    for (int i = 0; i < 100 * kDataSize; i++)
+      map.Insert(-i - 1, i);
+
+    Map resizing(16);
+    // the resizer drains one range and sleeps, the writers leave the rest to it
+    resizing.StartBackgroundResizing(1, std::chrono::seconds(60));
+    for (int i = 0; i < kDataSize; i++)
+      resizing.Insert(i, i);
+    map = std::move(resizing);
+
+    int counter = 0;
+    map.ForEach([&counter](const int &key, const int &value) {
+      assert(key == value);
+      counter++;
+    });
+    assert(kDataSize == counter && kDataSize == (int)map.Size());
+    for (int i = 0; i < kDataSize; i++)
+      assert(make_pair(true, i) == map.Lookup(i));
+    map.Reserve(10 * kDataSize);
+    assert(kDataSize == (int)map.SizeExact());
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  void ResizeStatsTest() {
+    Map map(16);
+    assert(0 == map.LastResizeStats().num_resizes);
+    const int kDataSize = 1000;
+    for (int i = 0; i < kDataSize; i++)
+      map.Insert(i, i);
+
+    auto stats = map.LastResizeStats();
+    assert(stats.num_resizes > 0);
+    assert(IndexPolicy::BucketCount(2 * stats.old_num_buckets) == stats.new_num_buckets);
+    assert(stats.old_num_buckets == stats.buckets_moved); // every old bucket is drained exactly once
+    assert(stats.elements_moved > 0 && stats.elements_moved < kDataSize);
+    assert(stats.ranges_claimed > 0 && stats.ranges_claimed <= stats.buckets_moved);
+    assert(1 == stats.num_helpers);
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  /// @brief the histogram covers the table, a constant hasher shows up in the empty buckets. The lock waits are
+  ///        counted only in the statistics mode: a Clear waits there for a traversal which holds the state lock
+  void StatsTest() {
+    const int kDataSize = 5000;
+    Map map(16);
+    for (int i = 0; i < kDataSize; i++)
+      map.Insert(i, i);
+    auto stats = map.Stats();
+    assert(stats.num_buckets == map.BucketCount() && kDataSize == (int)stats.num_elements);
+    assert(stats.max_chain_length < Map::kStatsMaxChainLength);
+    assert(stats.max_chain_length + 1 == stats.chain_lengths.size());
+    uint64_t num_buckets = 0;
+    uint64_t num_elements = 0;
+    for (uint64_t length = 0; length < stats.chain_lengths.size(); length++) {
+      num_buckets += stats.chain_lengths[length];
+      num_elements += length * stats.chain_lengths[length];
+    }
+    assert(stats.num_buckets == num_buckets && kDataSize == (int)num_elements);
+    assert(stats.empty_bucket_fraction < stats.expected_empty_fraction + 0.05);
+    assert(stats.last_resize.num_resizes > 0 && stats.last_resize.start_time_us > 0);
+    assert(stats.last_resize.start_time_us <= stats.last_resize.finish_time_us);
+    assert(stats.is_detailed == !stats.moved_per_call.empty());
+
+    const int kCollisions = 500;
+    TestedMap<int, int, std::function<uint64_t(const int &)>> collided(16, [](const int &) { return uint64_t(7); });
+    for (int i = 0; i < kCollisions; i++)
+      collided.Insert(i, i);
+    auto collided_stats = collided.Stats();
+    assert(kCollisions == (int)collided_stats.max_chain_length && 1 == collided_stats.chain_lengths.back());
+    assert(Map::kStatsMaxChainLength + 1 == collided_stats.chain_lengths.size());
+    assert(collided_stats.num_buckets - 1 == collided_stats.chain_lengths[0]);
+    assert(collided_stats.empty_bucket_fraction > collided_stats.expected_empty_fraction + 0.2);
+
+    std::atomic<bool> is_visiting(false);
+    std::thread traversal([&map, &is_visiting]() {
+      map.ForEach([&is_visiting](const int &, const int &) {
+        if (!is_visiting.exchange(true))
+          std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      });
+    });
+    while (!is_visiting.load())
+      std::this_thread::yield();
+    map.Clear();
+    traversal.join();
+    auto cleared_stats = map.Stats();
+    assert(0 == cleared_stats.num_elements && 1 == cleared_stats.empty_bucket_fraction);
+    assert(cleared_stats.is_detailed == (cleared_stats.state_lock_waits.count > 0));
+    assert(cleared_stats.is_detailed
+           || (0 == cleared_stats.bucket_lock_waits.count && 0 == cleared_stats.state_lock_waits.wait_ns));
+
+    const std::string kText = map.DumpStats();
+    const std::string kJson = map.DumpStats(Map::StatsFormat::kJson);
+    assert(0 == kText.find("is_detailed: ") && std::string::npos != kText.find("\nmoved_per_call: "));
+    assert('{' == kJson.front() && '}' == kJson.back());
+    assert(std::string::npos != kJson.find(", \"empty_bucket_fraction\": 1, "));
+    assert(std::string::npos != kText.find("\nis_resizing: false\n"));
+
+    // a resizing in progress is reported, not finished: the resizer drains one range and sleeps
+    Map resizing(16);
+    resizing.StartBackgroundResizing(1, std::chrono::seconds(60));
+    int num_inserted = 0;
+    while (16 == resizing.BucketCount())
+      resizing.Insert(num_inserted++, 0);
+    auto resizing_stats = resizing.Stats();
+    assert(resizing_stats.is_resizing && 0 == resizing_stats.current_resize.num_resizes);
+    assert(resizing_stats.current_resize.new_num_buckets == resizing.BucketCount());
+    assert(16 == resizing_stats.num_buckets && 16 == resizing_stats.current_resize.old_num_buckets);
+    assert(num_inserted == (int)(resizing_stats.num_elements + resizing_stats.new_table_elements));
+    assert(resizing.Stats().is_resizing);
+    resizing.StopBackgroundResizing();
+    std::cout << "\t" << __func__ << " passed. Empty buckets: sequential keys " << stats.empty_bucket_fraction
+        << ", constant hash " << collided_stats.empty_bucket_fraction << " (uniform hash "
+        << collided_stats.expected_empty_fraction << ")" << std::endl;
+  }
+
+  void ShrinkTest() {
+    Map map(16);
+    map.SetMinLoadFactor(0.1);
+    const int kDataSize = 20000;
+    for (int i = 0; i < kDataSize; i++)
+      map.Insert(i, i);
+    const uint64_t kGrownBuckets = map.BucketCount();
+
+    const int kLeft = 100;
+    for (int i = kLeft; i < kDataSize; i++)
+      assert(map.Remove(i));
+    auto stats = map.LastResizeStats();
+    assert(stats.new_num_buckets < stats.old_num_buckets);
+    assert(map.BucketCount() < kGrownBuckets / 16);
+    assert(map.BucketCount() >= IndexPolicy::BucketCount(16)); // the initial size is the lower bound
+    assert(kLeft == (int)map.Size());
+    for (int i = 0; i < kDataSize; i++)
+      assert(make_pair(i < kLeft, i < kLeft? i : 0) == map.Lookup(i));
+
+    // grows again after shrinking
+    for (int i = 0; i < kDataSize; i++)
+      map.Insert(i, i * 10);
+    for (int i = 0; i < kDataSize; i++)
+      assert(make_pair(true, i * 10) == map.Lookup(i));
+    std::cout << "\t" << __func__ << ": buckets " << kGrownBuckets << " -> " << stats.new_num_buckets
+        << " passed" << std::endl;
+  }
+
+  void ShrinkToFitTest() {
+    Map map(16);
+    const int kDataSize = 20000;
+    for (int i = 0; i < kDataSize; i++)
+      map.Insert(i, i);
+    const int kLeft = 1000;
+    for (int i = kLeft; i < kDataSize; i++)
+      map.Remove(i);
+    const uint64_t kSparseBuckets = map.BucketCount(); // shrinking is disabled by default
+
+    map.ShrinkToFit();
+    const uint64_t kFitBuckets = map.BucketCount();
+    assert(kFitBuckets < kSparseBuckets);
+    for (int i = 0; i < kDataSize; i++)
+      assert(make_pair(i < kLeft, i < kLeft? i : 0) == map.Lookup(i));
+
+    map.ShrinkToFit(); // nothing to do
+    assert(kFitBuckets == map.BucketCount());
+    // the fitted table keeps room for growth
+    for (int i = kLeft; i < kLeft + kLeft / 2; i++)
+      map.Insert(i, i);
+    assert(kFitBuckets == map.BucketCount());
+    std::cout << "\t" << __func__ << ": buckets " << kSparseBuckets << " -> " << kFitBuckets << " passed"
+        << std::endl;
+  }
+
+  /// @brief the tables replaced while a lookup is pinned are kept for it, the first write after it left frees them
+  void RetiredTablesTest() {
+    auto token = std::make_shared<int>(0);
+    TestedMap<int, std::shared_ptr<int>> map(16);
+    const int kDataSize = 10000;
+    for (int i = 0; i < kDataSize; i++)
+      map.Insert(i, token);
+    {
+      EpochGuard guard;
+      map.Clear();
+      assert(map.Stats().retired_tables > 0);
+      assert(token.use_count() > 1);
+    }
+    map.Insert(0, nullptr);
+    assert(0 == map.Stats().retired_tables);
+    EpochDomain::Instance().Collect(); // the nodes the lock-free buckets have replaced while growing
+    assert(1 == token.use_count()); // the old elements are gone with their table
+
+    for (int i = 0; i < kDataSize; i++)
+      map.Insert(i, nullptr);
+    for (int i = kDataSize / 100; i < kDataSize; i++)
+      map.Remove(i);
+    const uint64_t kSparseBuckets = map.BucketCount();
+    {
+      EpochGuard guard;
+      map.ShrinkToFit();
+      assert(map.BucketCount() < kSparseBuckets);
+      assert(map.Stats().retired_tables > 0);
+    }
+    map.Remove(kDataSize);
+    assert(0 == map.Stats().retired_tables);
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  void BatchTest() {
+    Map map(16);
+    const int kDataSize = 10000;
+    const int kBatchSize = 64;
+    std::vector<int> keys(kDataSize);
+    std::vector<int> values(kDataSize);
+    for (int i = 0; i < kDataSize; i++) {
+      keys[i] = i;
+      values[i] = i * 10;
+    }
+    // small batches pass through the resizing state many times
+    for (int i = 0; i < kDataSize; i += kBatchSize)
+      map.InsertBatch(&keys[i], &values[i], std::min(kBatchSize, kDataSize - i));
+    assert(kDataSize == (int)map.Size());
+
+    std::vector<int> lookup_keys(2 * kBatchSize);
+    std::vector<std::pair<bool, int>> results(lookup_keys.size());
+    for (int i = 0; i < kDataSize; i += kBatchSize) {
+      for (uint64_t j = 0; j < lookup_keys.size(); j++)
+        lookup_keys[j] = i + j * 2; // every other key is missing near the end
+      map.LookupBatch(lookup_keys.data(), lookup_keys.size(), results.data());
+      for (uint64_t j = 0; j < lookup_keys.size(); j++) {
+        const int kKey = lookup_keys[j];
+        assert(make_pair(kKey < kDataSize, kKey < kDataSize? kKey * 10 : 0) == results[j]);
+      }
+    }
+
+    // the later of the duplicates wins
+    int dup_keys[] = {7, 7, 8, 7};
+    int dup_values[] = {1, 2, 3, 4};
+    map.InsertBatch(dup_keys, dup_values, 4);
+    assert(make_pair(true, 4) == map.Lookup(7));
+    assert(make_pair(true, 3) == map.Lookup(8));
+    assert(kDataSize == (int)map.Size());
+    map.InsertBatch(dup_keys, dup_values, 0);
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  void VisitUpsertTest() {
+    Map map(4);
+    const int kNumKeys = 2000;
+    const int kNumThreads = 4;
+    const int kRounds = 5;
+    // the counters grow while the map resizes, so the updates meet the elements in both tables
+    auto counter = [&map, kNumKeys, kRounds]() {
+      for (int round = 0; round < kRounds; round++)
+        for (int i = 0; i < kNumKeys; i++)
+          map.Upsert(i, [](int &value) { value++; }, []() { return 1; });
+    };
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kNumThreads; i++)
+      threads.push_back(std::thread(counter));
+    for (auto &thread : threads)
+      thread.join();
+
+    assert(kNumKeys == (int)map.Size());
+    for (int i = 0; i < kNumKeys; i++) {
+      int seen = 0;
+      assert(map.Visit(i, [&seen](const int &value) { seen = value; }));
+      assert(kNumThreads * kRounds == seen);
+    }
+    assert(!map.Visit(kNumKeys, [](const int &) { assert(false); }));
+
+    int num_created = 0;
+    assert(map.ComputeIfAbsent(kNumKeys, [&num_created]() { return ++num_created * 100; }));
+    assert(!map.ComputeIfAbsent(kNumKeys, [&num_created]() { return ++num_created * 100; }));
+    assert(1 == num_created);
+    assert(make_pair(true, 100) == map.Lookup(kNumKeys));
+    assert(!map.Upsert(kNumKeys, [](int &value) { value = -value; }, []() { return 0; }));
+    assert(make_pair(true, -100) == map.Lookup(kNumKeys));
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  void EmplaceTest() {
+    TestedMap<int, Tracked> tracked_map(64); // big enough to never resize, the buckets would copy the values
+    auto &constructions = Tracked::Constructions();
+    constructions = 0;
+    assert(tracked_map.TryEmplace(1, 2, 3));
+    assert(1 == constructions);
+    assert(!tracked_map.TryEmplace(1, 4, 5));
+    assert(1 == constructions); // nothing is built for an existing key
+    assert(tracked_map.Visit(1, [](const Tracked &value) { assert(5 == value.payload); }));
+    assert(tracked_map.Emplace(2, 10, 20));
+    assert(2 == constructions);
+    assert(!tracked_map.Emplace(2, 1, 1));
+    assert(tracked_map.Visit(2, [](const Tracked &value) { assert(2 == value.payload); }));
+
+    // moved buffers end up in the map as they are
+    TestedMap<std::string, std::vector<int>> map(4);
+    const int kDataSize = 1000;
+    for (int i = 0; i < kDataSize; i++) {
+      std::vector<int> value(3, i);
+      const int *kBuffer = value.data();
+      assert(map.InsertOrAssign(std::to_string(i), std::move(value)));
+      assert(map.Visit(std::to_string(i), [kBuffer](const std::vector<int> &stored) {
+        assert(kBuffer == stored.data());
+      }));
+    }
+    for (int i = 0; i < kDataSize; i += 2) {
+      std::vector<int> value(1, -i);
+      const int *kBuffer = value.data();
+      assert(!map.InsertOrAssign(std::to_string(i), std::move(value)));
+      assert(map.Visit(std::to_string(i), [kBuffer](const std::vector<int> &stored) {
+        assert(kBuffer == stored.data());
+      }));
+      std::string key = std::to_string(i + 1);
+      map.Insert(std::move(key), std::vector<int>(2, i));
+    }
+    assert(kDataSize == (int)map.Size());
+    assert(make_pair(true, std::vector<int>(1, -10)) == map.Lookup("10"));
+    assert(make_pair(true, std::vector<int>(2, 10)) == map.Lookup("11"));
+    assert(!map.TryEmplace(std::string("7"), 5, 5));
+    assert(make_pair(true, std::vector<int>(2, 6)) == map.Lookup("7"));
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  /// @brief keys long enough to never fit into the small string buffer, concatenated into one request buffer
+  /// @param slices receive the views of the keys within the buffer
+  static std::string KeysBuffer(int num_keys, std::vector<std::string_view> &slices) {
+    std::string buffer;
+    std::vector<uint64_t> offsets;
+    for (int i = 0; i < num_keys; i++) {
+      offsets.push_back(buffer.size());
+      buffer += "/request/path/segment/" + std::to_string(i);
+    }
+    offsets.push_back(buffer.size());
+    slices.clear();
+    for (int i = 0; i < num_keys; i++)
+      slices.emplace_back(buffer.data() + offsets[i], offsets[i + 1] - offsets[i]);
+    return buffer;
+  }
+
+  void HeterogeneousLookupTest() {
+    const int kDataSize = 1000;
+    std::vector<std::string_view> slices;
+    const std::string kBuffer = KeysBuffer(kDataSize, slices);
+    StringMap map(16);
+    for (int i = 0; i < kDataSize; i++)
+      map.Insert(std::string(slices[i]), i);
+    assert(make_pair(true, 7) == map.Lookup(std::string(slices[7])));
+    assert(make_pair(true, 8) == map.Lookup("/request/path/segment/8"));
+
+    map.Lookup(slices[0]); // the first call of the thread may set up its epoch record
+    const uint64_t kAllocationsBefore = tests::ThreadAllocations();
+    for (int i = 0; i < kDataSize; i++) {
+      assert(make_pair(true, i) == map.Lookup(slices[i]));
+      assert(map.Visit(slices[i], [i](const int &value) { assert(i == value); }));
+    }
+    assert(!map.Lookup(std::string_view("/request/path/segment/")).first);
+    assert(kAllocationsBefore == tests::ThreadAllocations());
+
+    for (int i = 0; i < kDataSize; i += 2)
+      assert(map.Remove(slices[i]));
+    assert(!map.Remove(slices[0]));
+    assert(kDataSize / 2 == (int)map.Size());
+    assert(!map.Lookup(slices[10]).first && map.Lookup(slices[11]).first);
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  /// @brief lookups by a temporary std::string vs by std::string_view of the request buffer
+  void HeterogeneousLookupBenchmark() {
+    const int kDataSize = 20000;
+    const int kRounds = 20;
+    std::vector<std::string_view> slices;
+    const std::string kBuffer = KeysBuffer(kDataSize, slices);
+    StringMap map(kDataSize);
+    for (int i = 0; i < kDataSize; i++)
+      map.Insert(std::string(slices[i]), i);
+    std::shuffle(slices.begin(), slices.end(), std::default_random_engine(1));
+
+    auto measure = [&map, &slices, kRounds](auto lookup, double &allocations) {
+      uint64_t found = 0;
+      const uint64_t kAllocationsBefore = tests::ThreadAllocations();
+      auto time_start = std::chrono::high_resolution_clock::now();
+      for (int round = 0; round < kRounds; round++)
+        for (auto slice : slices)
+          found += lookup(map, slice).first;
+      auto time_stop = std::chrono::high_resolution_clock::now();
+      assert(found == slices.size() * kRounds);
+      allocations = double(tests::ThreadAllocations() - kAllocationsBefore) / found;
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(time_stop - time_start).count() / found;
+    };
+    double string_allocations = 0;
+    double view_allocations = 0;
+    auto string_ns = measure([](StringMap &map, std::string_view key) { return map.Lookup(std::string(key)); },
+                             string_allocations);
+    auto view_ns = measure([](StringMap &map, std::string_view key) { return map.Lookup(key); }, view_allocations);
+    assert(0 == view_allocations);
+    std::cout << "\t" << __func__ << " passed. Nanoseconds / allocations per lookup: std::string " << string_ns
+        << " / " << string_allocations << ", std::string_view " << view_ns << " / " << view_allocations << std::endl;
+  }
+
+  /// @brief string keys with a long common prefix: the time of moving every element to a bigger table
+  ///        by Reserve, and the lookups of present and absent keys at the highest load factor
+  void StringKeysBenchmark() {
+    const int kDataSize = 100000;
+    const int kRounds = 10;
+    std::vector<std::string> keys;
+    for (int i = 0; i < 2 * kDataSize; i++)
+      keys.push_back("/request/path/segment/with/a/long/common/prefix/" + std::to_string(i));
+    std::shuffle(keys.begin(), keys.end(), std::default_random_engine(1));
+    StringMap map(16);
+    map.Reserve(kDataSize);
+    const uint64_t kNumResizes = map.LastResizeStats().num_resizes;
+    for (int i = 0; i < kDataSize; i++)
+      map.Insert(keys[i], i);
+    assert(kNumResizes == map.LastResizeStats().num_resizes);
+
+    auto lookups_ns = [&map, &keys, kRounds](int begin, int end, bool is_present) {
+      auto time_start = std::chrono::high_resolution_clock::now();
+      for (int round = 0; round < kRounds; round++)
+        for (int i = begin; i < end; i++)
+          assert(is_present == map.Lookup(keys[i]).first);
+      auto time_stop = std::chrono::high_resolution_clock::now();
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(time_stop - time_start).count()
+             / (kRounds * (end - begin));
+    };
+    auto hit_ns = lookups_ns(0, kDataSize, true);
+    auto miss_ns = lookups_ns(kDataSize, 2 * kDataSize, false);
+
+    auto time_start = std::chrono::high_resolution_clock::now();
+    map.Reserve(4 * kDataSize);
+    auto time_stop = std::chrono::high_resolution_clock::now();
+    assert(kNumResizes + 1 == map.LastResizeStats().num_resizes && kDataSize == (int)map.Size());
+    std::cout << "\t" << __func__ << " passed. Reserve microseconds "
+        << std::chrono::duration_cast<std::chrono::microseconds>(time_stop - time_start).count()
+        << ", nanoseconds per lookup: hit " << hit_ns << ", miss " << miss_ns << std::endl;
+  }
+
+  /// @brief heap bytes per element of a map without resizing: the table and the nodes, malloc overhead excluded
+  void MemoryPerEntryBenchmark() {
+    const int kNumBuckets = 1 << 20;
+    const double kLoads[] = {0.1, 0.5};
+    typedef BucketType<int, int, NodeAllocator, std::equal_to<int>> MapBucket;
+    std::cout << "\t" << __func__ << ": bucket is " << sizeof(MapBucket) << " bytes, load / bytes per entry:";
+    for (double load : kLoads) {
+      const int kDataSize = static_cast<int>(load * kNumBuckets * MapBucket::kSlotsPerBucket);
+      const uint64_t kBytesBefore = tests::ThreadAllocatedBytes();
+      {
+        Map map(kNumBuckets);
+        for (int i = 0; i < kDataSize; i++)
+          map.Insert(i, i);
+        assert(kDataSize == (int)map.Size());
+        std::cout << " " << load << " / " << double(tests::ThreadAllocatedBytes() - kBytesBefore) / kDataSize;
+      }
+    }
+    std::cout << std::endl << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  /// @brief operations per second of the batch calls vs the single key calls
+  void BatchBenchmark() {
+    const int kDataSize = 1 << 17;
+    std::vector<int> keys(kDataSize);
+    for (int i = 0; i < kDataSize; i++)
+      keys[i] = i;
+    std::shuffle(keys.begin(), keys.end(), std::default_random_engine(1));
+    std::vector<std::pair<bool, int>> results(kDataSize);
+
+    std::cout << "\t" << __func__ << ": operations per second, batch / insert / lookup" << std::endl;
+    for (int batch_size : {1, 16, 64, 256}) {
+      Map map(kDataSize); // no resizing, only the access path is measured
+      auto time_start = std::chrono::high_resolution_clock::now();
+      if (1 == batch_size) {
+        for (int i = 0; i < kDataSize; i++)
+          map.Insert(keys[i], keys[i]);
+      } else {
+        for (int i = 0; i < kDataSize; i += batch_size)
+          map.InsertBatch(&keys[i], &keys[i], batch_size);
+      }
+      auto time_middle = std::chrono::high_resolution_clock::now();
+      if (1 == batch_size) {
+        for (int i = 0; i < kDataSize; i++)
+          results[i] = map.Lookup(keys[i]);
+      } else {
+        for (int i = 0; i < kDataSize; i += batch_size)
+          map.LookupBatch(&keys[i], batch_size, &results[i]);
+      }
+      auto time_stop = std::chrono::high_resolution_clock::now();
+      for (int i = 0; i < kDataSize; i++)
+        assert(make_pair(true, keys[i]) == results[i]);
+
+      double insert_s = std::chrono::duration<double>(time_middle - time_start).count();
+      double lookup_s = std::chrono::duration<double>(time_stop - time_middle).count();
+      std::cout << "\t\t" << batch_size << " / " << static_cast<uint64_t>(kDataSize / insert_s)
+          << " / " << static_cast<uint64_t>(kDataSize / lookup_s) << std::endl;
+    }
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  /// @brief writers grow the map together, every one of them claims ranges of the old table
+  void CooperativeResizeBenchmark() {
+    const int kDataSize = 400000;
+    const uint32_t kMaxThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "\t" << __func__ << ": last resize, threads / buckets / helpers / ranges / microseconds"
+        << std::endl;
+    for (uint32_t num_threads = 1; num_threads <= kMaxThreads; num_threads *= 2) {
+      Map map(16);
+      auto writer = [&map, kDataSize, num_threads] (int thread_id) {
+        for (int i = thread_id; i < kDataSize; i += num_threads)
+          map.Insert(i, i);
+      };
+      std::vector<std::thread> threads;
+      for (uint32_t i = 0; i < num_threads; i++)
+        threads.push_back(std::thread(writer, i));
+      for (auto &thread : threads)
+        thread.join();
+      assert(kDataSize == (int)map.Size());
+
+      auto stats = map.LastResizeStats();
+      assert(stats.old_num_buckets == stats.buckets_moved);
+      std::cout << "\t\t" << num_threads << " / " << stats.old_num_buckets << " / " << stats.num_helpers
+          << " / " << stats.ranges_claimed << " / " << stats.duration_us << std::endl;
+    }
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  /// @return latencies of the inserts into a growing map, sorted
+  std::vector<uint64_t> GrowthLatencies(bool background_resizing) {
+    const int kDataSize = 200000;
+    Map map(16);
+    if (background_resizing)
+      map.StartBackgroundResizing();
+    std::vector<uint64_t> latencies_ns(kDataSize);
+    for (int i = 0; i < kDataSize; i++) {
+      auto time_start = std::chrono::high_resolution_clock::now();
+      map.Insert(i, i);
+      auto time_stop = std::chrono::high_resolution_clock::now();
+      latencies_ns[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(time_stop - time_start).count();
+    }
+    assert(kDataSize == (int)map.Size());
+    std::sort(latencies_ns.begin(), latencies_ns.end());
+    return latencies_ns;
+  }
+
+  /// @brief insert tail latency while the map grows: resizing work in the callers vs in the background thread
+  void GrowthLatencyBenchmark() {
+    std::cout << "\t" << __func__ << ": insert latency ns, mode / p50 / p99 / p999 / max" << std::endl;
+    for (bool background_resizing : {false, true}) {
+      auto latencies_ns = GrowthLatencies(background_resizing);
+      auto percentile = [&latencies_ns] (double p) {
+        return latencies_ns[static_cast<uint64_t>(p * (latencies_ns.size() - 1))];
+      };
+      std::cout << "\t\t" << (background_resizing? "background" : "caller") << " / " << percentile(0.5)
+          << " / " << percentile(0.99) << " / " << percentile(0.999) << " / " << latencies_ns.back() << std::endl;
+    }
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  template <typename HashmapType>
+  uint64_t InsertLookupNanoseconds(HashmapType &map, const std::vector<int> &data) {
+    auto time_start = std::chrono::high_resolution_clock::now();
+    for (int key : data)
+      map.Insert(key, key);
+    uint64_t num_found = 0;
+    for (int round = 0; round < 20; round++)
+      for (int key : data)
+        num_found += map.Lookup(key).first? 1 : 0;
+    auto time_stop = std::chrono::high_resolution_clock::now();
+    assert(20 * data.size() == num_found);
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time_stop - time_start).count() / (21 * data.size());
+  }
+
+  /// @brief per operation cost of type-erased hashing vs inlined hasher with modulo and power of two indexing
+  void HashingBenchmark() {
+    const int kDataSize = 20000; // fits in cache, so the hashing itself is visible
+    std::vector<int> data(kDataSize);
+    for (int i = 0; i < kDataSize; i++)
+      data[i] = i;
+    std::shuffle(data.begin(), data.end(), std::default_random_engine(1)); // no sequential bucket walks
+
+    TestedMap<int, int, std::function<uint64_t(const int &)>> erased_map(64, std::hash<int>());
+    ThreadsafeHashmap<int, int, std::hash<int>, std::equal_to<int>, BucketType, NodeAllocator, ModuloIndexing>
+        modulo_map;
+    ThreadsafeHashmap<int, int, std::hash<int>, std::equal_to<int>, BucketType, NodeAllocator, PowerOfTwoIndexing>
+        pow2_map;
+    std::cout << "\t" << __func__ << " passed. Nanoseconds per operation: std::function "
+        << InsertLookupNanoseconds(erased_map, data) << ", modulo "
+        << InsertLookupNanoseconds(modulo_map, data) << ", power of two "
+        << InsertLookupNanoseconds(pow2_map, data) << std::endl;
+  }
+
   void HighLoadTest() {
     const int kHwThreads = std::thread::hardware_concurrency();
     if (kHwThreads < 3)
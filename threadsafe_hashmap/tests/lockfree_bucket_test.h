@@ -0,0 +1,266 @@
+#ifndef THREADSAFE_HASHMAP_LOCKFREE_BUCKET_TEST_H
+#define THREADSAFE_HASHMAP_LOCKFREE_BUCKET_TEST_H
+
+#ifdef NDEBUG
+#undef NDEBUG
+  #define RESTORE_NDEBUG
+#endif
+
+#include <assert.h>
+
+#ifdef RESTORE_NDEBUG
+#undef RESTORE_NDEBUG
+  #define NDEBUG
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "../include/threadsafe_hashmap.h"
+#include "../src/bucket.h"
+#include "../src/epoch_reclamation.h"
+#include "../src/lockfree_read_bucket.h"
+
+using std::make_pair;
+
+using my_concurrency::ThreadsafeHashmap;
+using my_concurrency::internals::Bucket;
+using my_concurrency::internals::EpochDomain;
+using my_concurrency::internals::EpochGuard;
+using my_concurrency::internals::LockFreeReadBucket;
+
+namespace tests {
+
+class LockFreeBucketTest {
+ public:
+  void TestAll() {
+    SimpleTest();
+    ReclamationTest();
+    PinnedReaderTest();
+    MigrateTest();
+    ReadersWithWriterTest();
+    ReadScalingBenchmark();
+    MapReadScalingBenchmark();
+
+    std::cout << "Lock-free read bucket tests passed." << std::endl;
+  }
+
+ private:
+  typedef LockFreeReadBucket<int, int> LockFreeBucket;
+
+  struct Tracked {
+    static std::atomic<int> alive;
+    int value = 0;
+    Tracked() { alive++; }
+    Tracked(const Tracked &rhs) : value(rhs.value) { alive++; }
+    ~Tracked() { alive--; }
+    bool operator==(const Tracked &rhs) const { return value == rhs.value; }
+  };
+
+  void SimpleTest() {
+    LockFreeBucket bucket;
+    assert(bucket.Empty());
+    assert(bucket.Insert(1, 10));
+    assert(bucket.Insert(2, 20));
+    assert(!bucket.Insert(1, 11));
+    assert(2 == bucket.Size());
+    assert(make_pair(true, 11) == bucket.Lookup(1));
+    assert(make_pair(true, 20) == bucket.Lookup(2));
+    assert(make_pair(false, 0) == bucket.Lookup(3));
+
+    assert(bucket.Remove(1));
+    assert(!bucket.Remove(1));
+    assert(make_pair(false, 0) == bucket.Lookup(1));
+
+    LockFreeBucket copied = bucket;
+    bucket.Clear();
+    assert(bucket.Empty());
+    assert(make_pair(true, 20) == copied.Lookup(2));
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  void ReclamationTest() {
+    {
+      LockFreeReadBucket<int, Tracked> bucket;
+      Tracked value;
+      for (int i = 0; i < 100; i++)
+        bucket.Insert(i % 10, value);
+      for (int i = 0; i < 10; i++)
+        bucket.Remove(i);
+    }
+    EpochDomain::Instance().Collect();
+    assert(0 == EpochDomain::Instance().PendingCount());
+    assert(0 == Tracked::alive);
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  void PinnedReaderTest() {
+    LockFreeReadBucket<int, Tracked> bucket;
+    bucket.Insert(1, Tracked());
+
+    std::promise<void> pinned;
+    std::promise<void> release;
+    auto release_future = release.get_future();
+    std::thread reader([&]() {
+      EpochGuard guard;
+      pinned.set_value();
+      release_future.wait();
+    });
+    pinned.get_future().wait();
+
+    bucket.Remove(1);
+    EpochDomain::Instance().Collect();
+    assert(1 == Tracked::alive); // the reader is still pinned, the node can't be deleted
+
+    release.set_value();
+    reader.join();
+    EpochDomain::Instance().Collect();
+    assert(0 == Tracked::alive);
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  void MigrateTest() {
+    LockFreeBucket source;
+    for (int i = 0; i < 30; i++)
+      source.Insert(i, i * 10);
+
+    LockFreeBucket destinations[2];
+    auto hasher = [](const int &key) { return static_cast<uint64_t>(key); };
+    auto router = [&destinations](uint64_t hash) -> LockFreeBucket & { return destinations[hash % 2]; };
+    assert(30 == source.MigrateTo(hasher, router));
+    assert(source.Empty());
+    assert(15 == destinations[0].Size() && 15 == destinations[1].Size());
+    for (int i = 0; i < 30; i++)
+      assert(make_pair(true, i * 10) == destinations[i % 2].Lookup(i));
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  void ReadersWithWriterTest() {
+    LockFreeBucket bucket;
+    const int kNumKeys = 16;
+    for (int i = 0; i < kNumKeys; i++)
+      bucket.Insert(i, i);
+
+    std::atomic<bool> done(false);
+    auto reader = [&bucket, &done, kNumKeys]() {
+      uint64_t num_lookups = 0;
+      do { // at least one pass: the writer may finish before a reader gets scheduled
+        for (int i = 0; i < kNumKeys; i++) {
+          auto result = bucket.Lookup(i);
+          // even keys are never removed, only their values are replaced
+          if (i % 2 == 0)
+            assert(result.first && result.second % 1000 == i);
+          num_lookups++;
+        }
+      } while (!done.load());
+      return num_lookups;
+    };
+
+    std::vector<std::future<uint64_t>> readers;
+    for (int i = 0; i < 3; i++)
+      readers.push_back(std::async(std::launch::async, reader));
+
+    for (int round = 0; round < 2000; round++) {
+      for (int i = 0; i < kNumKeys; i++) {
+        if (i % 2 == 0)
+          bucket.Insert(i, (round % 7) * 1000 + i);
+        else if (round % 2 == 0)
+          bucket.Remove(i);
+        else
+          bucket.Insert(i, i);
+      }
+    }
+    done = true;
+    for (auto &result : readers)
+      assert(result.get() > 0);
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  /// @brief many readers over a small hot set of buckets: the shared mutex path vs the lock-free path
+  template <typename BucketType>
+  double ReadThroughput(uint32_t num_threads) {
+    const int kNumBuckets = 64;
+    const int kLookupsPerThread = 200000;
+    std::vector<BucketType> buckets(kNumBuckets);
+    for (int i = 0; i < 4 * kNumBuckets; i++)
+      buckets[i % kNumBuckets].Insert(i, i);
+
+    auto reader = [&buckets, kNumBuckets, kLookupsPerThread]() {
+      uint64_t num_found = 0;
+      for (int i = 0; i < kLookupsPerThread; i++)
+        num_found += buckets[i % kNumBuckets].Lookup(i % (4 * kNumBuckets)).first? 1 : 0;
+      return num_found;
+    };
+
+    auto time_start = std::chrono::high_resolution_clock::now();
+    std::vector<std::future<uint64_t>> results;
+    for (uint32_t i = 0; i < num_threads; i++)
+      results.push_back(std::async(std::launch::async, reader));
+    for (auto &result : results)
+      assert(kLookupsPerThread == (int)result.get());
+    auto time_stop = std::chrono::high_resolution_clock::now();
+    double elapsed_s = std::chrono::duration<double>(time_stop - time_start).count();
+    return num_threads * kLookupsPerThread / elapsed_s;
+  }
+
+  void ReadScalingBenchmark() {
+    const uint32_t kMaxThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "\t" << __func__ << ": lookups per second, threads / locked / lock-free" << std::endl;
+    for (uint32_t num_threads = 1; num_threads <= kMaxThreads; num_threads *= 2) {
+      std::cout << "\t\t" << num_threads
+          << " / " << static_cast<uint64_t>(ReadThroughput<Bucket<int, int>>(num_threads))
+          << " / " << static_cast<uint64_t>(ReadThroughput<LockFreeBucket>(num_threads)) << std::endl;
+    }
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  /// @brief the same over whole maps: the lookups of the map pin an epoch instead of taking the table state lock,
+  ///        so the buckets are the only shared memory they may write to
+  template <template <typename...> class BucketType>
+  double MapReadThroughput(uint32_t num_threads) {
+    typedef ThreadsafeHashmap<int, int, std::hash<int>, std::equal_to<int>, BucketType> Map;
+    const int kNumKeys = 4096;
+    const int kLookupsPerThread = 200000;
+    Map map(kNumKeys / 4);
+    for (int i = 0; i < kNumKeys; i++)
+      map.Insert(i, i);
+
+    auto reader = [&map, kNumKeys, kLookupsPerThread]() {
+      uint64_t num_found = 0;
+      for (int i = 0; i < kLookupsPerThread; i++)
+        num_found += map.Lookup(i % kNumKeys).first? 1 : 0;
+      return num_found;
+    };
+
+    auto time_start = std::chrono::high_resolution_clock::now();
+    std::vector<std::future<uint64_t>> results;
+    for (uint32_t i = 0; i < num_threads; i++)
+      results.push_back(std::async(std::launch::async, reader));
+    for (auto &result : results)
+      assert(kLookupsPerThread == (int)result.get());
+    auto time_stop = std::chrono::high_resolution_clock::now();
+    double elapsed_s = std::chrono::duration<double>(time_stop - time_start).count();
+    return num_threads * kLookupsPerThread / elapsed_s;
+  }
+
+  void MapReadScalingBenchmark() {
+    const uint32_t kMaxThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "\t" << __func__ << ": map lookups per second, threads / locked / lock-free" << std::endl;
+    for (uint32_t num_threads = 1; num_threads <= kMaxThreads; num_threads *= 2) {
+      std::cout << "\t\t" << num_threads
+          << " / " << static_cast<uint64_t>(MapReadThroughput<Bucket>(num_threads))
+          << " / " << static_cast<uint64_t>(MapReadThroughput<LockFreeReadBucket>(num_threads)) << std::endl;
+    }
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+};
+
+std::atomic<int> LockFreeBucketTest::Tracked::alive(0);
+
+} // namespace tests
+
+#endif //THREADSAFE_HASHMAP_LOCKFREE_BUCKET_TEST_H
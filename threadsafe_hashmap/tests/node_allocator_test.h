@@ -0,0 +1,185 @@
+#ifndef THREADSAFE_HASHMAP_NODE_ALLOCATOR_TEST_H
+#define THREADSAFE_HASHMAP_NODE_ALLOCATOR_TEST_H
+
+#ifdef NDEBUG
+#undef NDEBUG
+  #define RESTORE_NDEBUG
+#endif
+
+#include <assert.h>
+
+#ifdef RESTORE_NDEBUG
+#undef RESTORE_NDEBUG
+  #define NDEBUG
+#endif
+
+#include <chrono>
+#include <iostream>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "../include/threadsafe_hashmap.h"
+#include "../src/bucket.h"
+#include "../src/node_allocator.h"
+
+using std::make_pair;
+
+using my_concurrency::ThreadsafeHashmap;
+using my_concurrency::internals::Bucket;
+using my_concurrency::internals::HeapNodeAllocator;
+using my_concurrency::internals::SlabArena;
+using my_concurrency::internals::SlabNodeAllocator;
+
+namespace tests {
+
+class NodeAllocatorTest {
+ public:
+  void TestAll() {
+    ArenaTest();
+    ArenaConcurrentTest();
+    BucketTest();
+    MapStatsTest();
+    InsertBenchmark();
+
+    std::cout << "Node allocator tests passed." << std::endl;
+  }
+
+ private:
+  struct Node {
+    uint64_t payload[3];
+  };
+
+  void ArenaTest() {
+    SlabArena arena(4);
+    std::set<void *> nodes;
+    for (int i = 0; i < 10; i++)
+      assert(nodes.insert(arena.Allocate(sizeof(Node))).second);
+
+    auto stats = arena.GetStats();
+    assert(3 == stats.slabs_in_use);
+    assert(10 == stats.nodes_in_use);
+    assert(0 == stats.free_list_length);
+
+    for (auto node : nodes)
+      arena.Deallocate(node);
+    stats = arena.GetStats();
+    assert(0 == stats.nodes_in_use);
+    assert(10 == stats.free_list_length);
+
+    // released nodes are reused before new slabs are taken
+    for (int i = 0; i < 10; i++)
+      assert(nodes.count(arena.Allocate(sizeof(Node))));
+    assert(3 == arena.GetStats().slabs_in_use);
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  void ArenaConcurrentTest() {
+    SlabArena arena(64);
+    const int kNumThreads = 4;
+    const int kNumNodes = 10000;
+    auto worker = [&arena, kNumNodes]() {
+      std::vector<void *> nodes;
+      for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < kNumNodes; i++) {
+          auto node = static_cast<Node *>(arena.Allocate(sizeof(Node)));
+          node->payload[0] = i;
+          nodes.push_back(node);
+        }
+        for (int i = 0; i < kNumNodes; i++)
+          assert(static_cast<Node *>(nodes[i])->payload[0] == (uint64_t)i);
+        for (auto node : nodes)
+          arena.Deallocate(node);
+        nodes.clear();
+      }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kNumThreads; i++)
+      threads.push_back(std::thread(worker));
+    for (auto &thread : threads)
+      thread.join();
+
+    auto stats = arena.GetStats();
+    assert(0 == stats.nodes_in_use);
+    assert(stats.free_list_length >= (uint64_t)kNumThreads * kNumNodes);
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  void BucketTest() {
+    SlabNodeAllocator allocator(8);
+    Bucket<int, int, SlabNodeAllocator> bucket(allocator);
+    for (int i = 0; i < 20; i++)
+      bucket.Insert(i, i * 10);
+    bucket.Insert(5, 55); // the new node is released at once
+    assert(20 == allocator.Stats().nodes_in_use);
+
+    for (int i = 0; i < 10; i++)
+      assert(bucket.Remove(i));
+    assert(10 == allocator.Stats().nodes_in_use);
+    assert(make_pair(true, 190) == bucket.Lookup(19));
+
+    auto copied = bucket;
+    assert(20 == allocator.Stats().nodes_in_use);
+    bucket.Clear();
+    copied.Clear();
+    assert(0 == allocator.Stats().nodes_in_use);
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  void MapStatsTest() {
+    typedef ThreadsafeHashmap<int, int, std::hash<int>, std::equal_to<int>, Bucket, SlabNodeAllocator> Map;
+    Map map(16);
+    const int kDataSize = 5000;
+    for (int i = 0; i < kDataSize; i++)
+      map.Insert(i, i);
+
+    // resizing relinks the nodes, so no node is allocated twice
+    auto stats = map.GetAllocator().Stats();
+    assert(kDataSize == (int)stats.nodes_in_use);
+    assert(0 == stats.free_list_length);
+
+    for (int i = 0; i < kDataSize; i += 2)
+      map.Remove(i);
+    stats = map.GetAllocator().Stats();
+    assert(kDataSize / 2 == (int)stats.nodes_in_use);
+    assert(kDataSize / 2 == (int)stats.free_list_length);
+    std::cout << "\t" << __func__ << ": slabs " << stats.slabs_in_use << ", free list "
+        << stats.free_list_length << " passed" << std::endl;
+  }
+
+  template <typename NodeAllocator>
+  uint64_t InsertRemoveMicroseconds() {
+    ThreadsafeHashmap<int, int, std::hash<int>, std::equal_to<int>, Bucket, NodeAllocator> map(1 << 16);
+    const int kDataSize = 40000;
+    const int kNumThreads = 4;
+    auto writer = [&map, kDataSize](int start_value) {
+      for (int round = 0; round < 5; round++) {
+        for (int i = start_value; i < start_value + kDataSize; i++)
+          map.Insert(i, i);
+        for (int i = start_value; i < start_value + kDataSize; i++)
+          map.Remove(i);
+      }
+    };
+
+    auto time_start = std::chrono::high_resolution_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kNumThreads; i++)
+      threads.push_back(std::thread(writer, i * kDataSize));
+    for (auto &thread : threads)
+      thread.join();
+    auto time_stop = std::chrono::high_resolution_clock::now();
+    assert(map.Empty());
+    return std::chrono::duration_cast<std::chrono::microseconds>(time_stop - time_start).count();
+  }
+
+  void InsertBenchmark() {
+    std::cout << "\t" << __func__ << " passed. Microseconds elapsed: heap "
+        << InsertRemoveMicroseconds<HeapNodeAllocator>() << ", slab "
+        << InsertRemoveMicroseconds<SlabNodeAllocator>() << std::endl;
+  }
+};
+
+} // namespace tests
+
+#endif //THREADSAFE_HASHMAP_NODE_ALLOCATOR_TEST_H
@@ -0,0 +1,222 @@
+#ifndef THREADSAFE_HASHMAP_SEQLOCK_BUCKET_TEST_H
+#define THREADSAFE_HASHMAP_SEQLOCK_BUCKET_TEST_H
+
+#ifdef NDEBUG
+#undef NDEBUG
+  #define RESTORE_NDEBUG
+#endif
+
+#include <assert.h>
+
+#ifdef RESTORE_NDEBUG
+#undef RESTORE_NDEBUG
+  #define NDEBUG
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "../include/threadsafe_hashmap.h"
+#include "../src/bucket.h"
+#include "../src/seqlock_bucket.h"
+
+using std::make_pair;
+
+using my_concurrency::ThreadsafeHashmap;
+using my_concurrency::internals::Bucket;
+using my_concurrency::internals::OptimisticReadBucket;
+using my_concurrency::internals::SeqLockBucket;
+
+namespace tests {
+
+class SeqLockBucketTest {
+ public:
+  void TestAll() {
+    SimpleTest();
+    OverflowTest();
+    MigrateTest();
+    SelectionTest();
+    TornReadTest();
+    ReadWriteMixBenchmark();
+
+    std::cout << "Seqlock bucket tests passed." << std::endl;
+  }
+
+ private:
+  typedef SeqLockBucket<int, int> IntBucket;
+
+  /// @brief both halves are always written equal, a torn read gets them different
+  struct Twin {
+    uint64_t first = 0;
+    uint64_t second = 0;
+  };
+
+  void SimpleTest() {
+    IntBucket bucket;
+    assert(bucket.Empty());
+    assert(bucket.Insert(0, 1, 10));
+    assert(bucket.Insert(0, 2, 20));
+    assert(!bucket.Insert(0, 1, 11));
+    assert(2 == bucket.Size());
+    assert(make_pair(true, 11) == bucket.Lookup(0, 1));
+    assert(make_pair(false, 0) == bucket.Lookup(0, 3));
+    assert(bucket.Visit(0, 2, [](const int &value) { assert(20 == value); }));
+
+    assert(!bucket.Upsert(0, 2, [](int &value) { value++; }, []() { return 0; }));
+    assert(bucket.EmplaceOrUpdate(0, 3, [](int &) { assert(false); }, 30));
+    assert(make_pair(true, 21) == bucket.Lookup(0, 2));
+
+    assert(bucket.Remove(0, 1));
+    assert(!bucket.Remove(0, 1));
+    assert(make_pair(false, 0) == bucket.Lookup(0, 1));
+
+    IntBucket copied = bucket;
+    bucket.Clear();
+    assert(bucket.Empty());
+    assert(2 == copied.Size() && make_pair(true, 30) == copied.Lookup(0, 3));
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  void OverflowTest() {
+    const int kDataSize = 5 * IntBucket::kGroupSize + 3;
+    IntBucket bucket;
+    for (int i = 0; i < kDataSize; i++)
+      assert(bucket.Insert(0, i, i * 10));
+    for (int i = 0; i < kDataSize; i += 2)
+      assert(bucket.Remove(0, i));
+    for (int i = 0; i < kDataSize; i++)
+      assert(make_pair(i % 2 == 1, i % 2 == 1? i * 10 : 0) == bucket.Lookup(0, i));
+
+    // the freed slots of all groups are reused
+    for (int i = kDataSize; i < kDataSize + kDataSize / 2; i++)
+      assert(bucket.Insert(0, i, i));
+    assert(uint64_t(kDataSize / 2 + kDataSize / 2) == bucket.Size());
+    assert(make_pair(true, kDataSize) == bucket.Lookup(0, kDataSize));
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  void MigrateTest() {
+    IntBucket source;
+    for (int i = 0; i < 30; i++)
+      source.Insert(0, i, i * 10);
+
+    IntBucket destinations[2];
+    auto hasher = [](const int &key) { return static_cast<uint64_t>(key); };
+    auto router = [&destinations](uint64_t hash) -> IntBucket & { return destinations[hash % 2]; };
+    assert(30 == source.MigrateTo(hasher, router));
+    assert(source.Empty());
+    assert(15 == destinations[0].Size() && 15 == destinations[1].Size());
+    for (int i = 0; i < 30; i++)
+      assert(make_pair(true, i * 10) == destinations[i % 2].Lookup(0, i));
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  void SelectionTest() {
+    static_assert(std::is_same<OptimisticReadBucket<uint64_t, Twin>, SeqLockBucket<uint64_t, Twin>>::value,
+                  "trivially copyable elements are read optimistically");
+    static_assert(std::is_same<OptimisticReadBucket<std::string, int>, Bucket<std::string, int>>::value,
+                  "the rest keeps the shared mutex");
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  void TornReadTest() {
+    SeqLockBucket<uint64_t, Twin> bucket;
+    const uint64_t kNumKeys = 3 * SeqLockBucket<uint64_t, Twin>::kGroupSize;
+    for (uint64_t i = 0; i < kNumKeys; i++)
+      bucket.Insert(0, i, Twin{i, i});
+
+    std::atomic<bool> done(false);
+    auto reader = [&bucket, &done, kNumKeys]() {
+      uint64_t num_found = 0;
+      do {
+        for (uint64_t i = 0; i < kNumKeys; i++) {
+          auto result = bucket.Lookup(0, i);
+          assert(result.second.first == result.second.second);
+          // even keys are never removed, only their values are replaced
+          assert(result.first || i % 2 == 1);
+          num_found += result.first? 1 : 0;
+        }
+      } while (!done.load());
+      return num_found;
+    };
+
+    std::vector<std::future<uint64_t>> readers;
+    for (int i = 0; i < 3; i++)
+      readers.push_back(std::async(std::launch::async, reader));
+    for (uint64_t round = 0; round < 2000; round++) {
+      for (uint64_t i = 0; i < kNumKeys; i++) {
+        if (i % 2 == 0)
+          bucket.Insert(0, i, Twin{round * i, round * i});
+        else if (round % 2 == 0)
+          bucket.Remove(0, i);
+        else
+          bucket.Insert(0, i, Twin{round, round});
+      }
+    }
+    done = true;
+    for (auto &result : readers)
+      assert(result.get() > 0);
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  /// @return operations per second of the threads doing lookups and overwrites of random keys. The lookups of the map
+  ///        pin an epoch instead of taking the table state lock, so with the optimistic buckets they write nothing
+  ///        to the shared memory
+  template <template <typename...> class BucketType>
+  double MixThroughput(uint32_t num_threads, uint32_t writes_per_hundred) {
+    typedef ThreadsafeHashmap<uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>, BucketType> Map;
+    const uint64_t kNumKeys = 1 << 14;
+    const int kOperationsPerThread = 400000;
+    Map map(kNumKeys);
+    for (uint64_t i = 0; i < kNumKeys; i++)
+      map.Insert(i, i);
+
+    auto worker = [&map, kNumKeys, kOperationsPerThread, writes_per_hundred](uint32_t seed) {
+      std::minstd_rand random(seed);
+      uint64_t num_found = 0;
+      for (int i = 0; i < kOperationsPerThread; i++) {
+        const uint64_t kKey = random() % kNumKeys;
+        if (random() % 100 < writes_per_hundred)
+          map.Insert(kKey, kKey + i);
+        else
+          num_found += map.Lookup(kKey).first? 1 : 0;
+      }
+      return num_found;
+    };
+
+    auto time_start = std::chrono::high_resolution_clock::now();
+    std::vector<std::future<uint64_t>> results;
+    for (uint32_t i = 0; i < num_threads; i++)
+      results.push_back(std::async(std::launch::async, worker, i + 1));
+    for (auto &result : results)
+      assert(result.get() > 0);
+    auto time_stop = std::chrono::high_resolution_clock::now();
+    assert(kNumKeys == map.Size());
+    double elapsed_s = std::chrono::duration<double>(time_stop - time_start).count();
+    return num_threads * kOperationsPerThread / elapsed_s;
+  }
+
+  void ReadWriteMixBenchmark() {
+    const uint32_t kNumThreads = std::max(2u, std::thread::hardware_concurrency());
+    const uint32_t kWritesPerHundred[] = {5, 1};
+    std::cout << "\t" << __func__ << ": " << kNumThreads
+        << " threads, map operations per second, reads/writes / shared mutex / seqlock" << std::endl;
+    for (uint32_t writes : kWritesPerHundred) {
+      std::cout << "\t\t" << 100 - writes << "/" << writes
+          << " / " << static_cast<uint64_t>(MixThroughput<Bucket>(kNumThreads, writes))
+          << " / " << static_cast<uint64_t>(MixThroughput<OptimisticReadBucket>(kNumThreads, writes)) << std::endl;
+    }
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+};
+
+} // namespace tests
+
+#endif //THREADSAFE_HASHMAP_SEQLOCK_BUCKET_TEST_H
@@ -0,0 +1,275 @@
+#ifndef THREADSAFE_HASHMAP_SNAPSHOT_TEST_H
+#define THREADSAFE_HASHMAP_SNAPSHOT_TEST_H
+
+#ifdef NDEBUG
+#undef NDEBUG
+  #define RESTORE_NDEBUG
+#endif
+
+#include <assert.h>
+
+#ifdef RESTORE_NDEBUG
+#undef RESTORE_NDEBUG
+  #define NDEBUG
+#endif
+
+#include <chrono>
+#include <cstddef> // offsetof
+#include <cstdio> // remove, fopen
+#include <cstring> // memcpy
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../include/snapshot_view.h"
+#include "../include/threadsafe_hashmap.h"
+
+using std::make_pair;
+
+using my_concurrency::SnapshotView;
+using my_concurrency::ThreadsafeHashmap;
+
+namespace tests {
+
+class SnapshotTest {
+ public:
+  void TestAll() {
+    RoundTripTest();
+    StringTest();
+    ResizingSaveTest();
+    RehashTest();
+    OverloadedLayoutTest();
+    ViewTest();
+    CorruptedTest();
+    WarmStartBenchmark();
+
+    std::remove(kPath);
+    std::cout << "Snapshot tests passed." << std::endl;
+  }
+
+ private:
+  typedef ThreadsafeHashmap<int, int> IntMap;
+  typedef ThreadsafeHashmap<std::string, std::string> StringMap;
+  typedef ThreadsafeHashmap<int, int, std::hash<int>, std::equal_to<int>, my_concurrency::internals::Bucket,
+                            my_concurrency::internals::HeapNodeAllocator, my_concurrency::PowerOfTwoIndexing> Pow2Map;
+
+  static constexpr const char *kPath = "threadsafe_hashmap_snapshot_test.bin";
+
+  void RoundTripTest() {
+    const int kDataSize = 10000;
+    IntMap map;
+    for (int i = 0; i < kDataSize; i++)
+      map.Insert(i, i * 10);
+    assert(map.SaveSnapshot(kPath));
+
+    IntMap loaded;
+    loaded.Insert(-1, -1); // replaced by the snapshot
+    assert(loaded.LoadSnapshot(kPath));
+    assert(kDataSize == (int)loaded.Size() && kDataSize == (int)loaded.SizeExact());
+    // the stored buckets are taken as is
+    assert(map.BucketCount() == loaded.BucketCount() && 0 == loaded.LastResizeStats().num_resizes);
+    assert(!loaded.Lookup(-1).first);
+    for (int i = 0; i < kDataSize; i++)
+      assert(make_pair(true, i * 10) == loaded.Lookup(i));
+    loaded.Insert(kDataSize, 1);
+    assert(make_pair(true, 1) == loaded.Lookup(kDataSize));
+
+    IntMap empty;
+    assert(empty.SaveSnapshot(kPath));
+    assert(loaded.LoadSnapshot(kPath));
+    assert(loaded.Empty() && !loaded.Lookup(1).first);
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  void StringTest() {
+    const int kDataSize = 2000;
+    StringMap map;
+    for (int i = 0; i < kDataSize; i++)
+      map.Insert("key " + std::to_string(i), std::string(i % 50, 'v'));
+    assert(map.SaveSnapshot(kPath));
+
+    StringMap loaded;
+    assert(loaded.LoadSnapshot(kPath));
+    assert(kDataSize == (int)loaded.Size());
+    for (int i = 0; i < kDataSize; i++)
+      assert(make_pair(true, std::string(i % 50, 'v')) == loaded.Lookup("key " + std::to_string(i)));
+
+    // a snapshot of other types is refused and the map stays as it was
+    IntMap int_map;
+    int_map.Insert(1, 1);
+    assert(!int_map.LoadSnapshot(kPath));
+    assert(!int_map.LoadSnapshot(std::string(kPath) + ".missing"));
+    assert(1 == int_map.Size() && make_pair(true, 1) == int_map.Lookup(1));
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  /// @brief the elements of both tables are saved by the buckets of the new one
+  void ResizingSaveTest() {
+    const int kDataSize = 20000;
+    IntMap map(16);
+    map.StartBackgroundResizing(16, std::chrono::microseconds(100));
+    for (int i = 0; i < kDataSize; i++)
+      map.Insert(i, i);
+    assert(map.SaveSnapshot(kPath));
+    map.StopBackgroundResizing();
+
+    IntMap loaded;
+    assert(loaded.LoadSnapshot(kPath));
+    assert(kDataSize == (int)loaded.Size());
+    for (int i = 0; i < kDataSize; i++)
+      assert(make_pair(true, i) == loaded.Lookup(i));
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  /// @brief another index policy mixes the hashes differently, so the loader rehashes the elements
+  void RehashTest() {
+    const int kDataSize = 10000;
+    IntMap map;
+    for (int i = 0; i < kDataSize; i++)
+      map.Insert(i, i + 1);
+    assert(map.SaveSnapshot(kPath));
+
+    Pow2Map loaded;
+    assert(loaded.LoadSnapshot(kPath));
+    assert(kDataSize == (int)loaded.Size());
+    for (int i = 0; i < kDataSize; i++)
+      assert(make_pair(true, i + 1) == loaded.Lookup(i));
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  /// @brief buckets loaded above the max load factor are rehashed, the loaded size is the floor of the shrinking
+  void OverloadedLayoutTest() {
+    namespace internals = my_concurrency::internals;
+    const int kDataSize = 1000;
+    // the elements of a valid snapshot packed into one bucket
+    internals::SnapshotHeader header = {};
+    std::memcpy(header.magic, internals::kSnapshotMagic, sizeof(header.magic));
+    header.version = internals::kSnapshotVersion;
+    header.key_format = header.value_format = internals::SnapshotCodec<int>::kFormat;
+    header.key_size = header.value_size = sizeof(int);
+    header.hash_seed = std::hash<int>()(0);
+    header.num_buckets = 1;
+    header.num_elements = kDataSize;
+    std::vector<uint64_t> hashes;
+    std::vector<int> keys;
+    for (int i = 0; i < kDataSize; i++) {
+      hashes.push_back(std::hash<int>()(i));
+      keys.push_back(i);
+    }
+    assert(internals::WriteSnapshot(kPath, header, std::vector<uint64_t>{0, kDataSize}, hashes, keys, keys, ""));
+
+    IntMap loaded;
+    assert(loaded.LoadSnapshot(kPath));
+    assert(loaded.BucketCount() * IntMap::kMaxLoadFactor >= kDataSize);
+    for (int i = 0; i < kDataSize; i++)
+      assert(make_pair(true, i) == loaded.Lookup(i));
+
+    const int kBigSize = 20000;
+    IntMap map;
+    for (int i = 0; i < kBigSize; i++)
+      map.Insert(i, i);
+    assert(map.SaveSnapshot(kPath));
+    IntMap shrinking(16);
+    shrinking.SetMinLoadFactor(0.1);
+    assert(shrinking.LoadSnapshot(kPath) && map.BucketCount() == shrinking.BucketCount());
+    for (int i = 0; i < kBigSize; i++)
+      assert(shrinking.Remove(i));
+    assert(map.BucketCount() == shrinking.BucketCount());
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  void ViewTest() {
+    const int kDataSize = 3000;
+    StringMap map;
+    for (int i = 0; i < kDataSize; i++)
+      map.Insert(std::to_string(i), std::to_string(i * 2));
+    assert(map.SaveSnapshot(kPath));
+
+    SnapshotView<std::string, std::string> view;
+    assert(make_pair(false, std::string()) == view.Lookup("1"));
+    assert(view.Open(kPath));
+    assert(kDataSize == (int)view.Size() && map.BucketCount() == view.BucketCount());
+    for (int i = 0; i < kDataSize; i++)
+      assert(make_pair(true, std::to_string(i * 2)) == view.Lookup(std::to_string(i)));
+    assert(!view.Lookup("-1").first);
+
+    SnapshotView<int, int> int_view;
+    assert(!int_view.Open(kPath));
+    assert(!int_view.Open(std::string(kPath) + ".missing"));
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  /// @brief a broken header, bucket offsets or string reference are refused before anything is read through them
+  void CorruptedTest() {
+    typedef my_concurrency::internals::SnapshotHeader Header;
+    const int kDataSize = 1000;
+    StringMap map;
+    for (int i = 0; i < kDataSize; i++)
+      map.Insert(std::to_string(i), std::to_string(i));
+    auto corrupted = [&map](uint64_t offset, uint64_t value) {
+      assert(map.SaveSnapshot(kPath));
+      Patch(offset, value);
+      StringMap loaded;
+      loaded.Insert("1", "1");
+      SnapshotView<std::string, std::string> view;
+      const bool kIsRefused = !loaded.LoadSnapshot(kPath) && !view.Open(kPath);
+      return kIsRefused && make_pair(true, std::string("1")) == loaded.Lookup("1");
+    };
+    Header header = {};
+    header.key_size = header.value_size = sizeof(my_concurrency::internals::StringRef);
+    header.num_buckets = map.BucketCount();
+    header.num_elements = kDataSize;
+    const my_concurrency::internals::SnapshotLayout kLayout(header);
+    // the layout of these counts overflows
+    assert(corrupted(offsetof(Header, num_buckets), 1ull << 61));
+    assert(corrupted(offsetof(Header, num_elements), 1ull << 60));
+    assert(corrupted(offsetof(Header, blob_size), ~0ull));
+    assert(corrupted(kLayout.bucket_offsets + sizeof(uint64_t), kDataSize + 1));
+    assert(corrupted(kLayout.keys, 1ull << 40)); // offset of the first key string
+    assert(corrupted(kLayout.values + sizeof(uint64_t), ~0ull)); // length of the first value string
+    std::cout << "\t" << __func__ << " passed" << std::endl;
+  }
+
+  /// @brief overwrites a word of the snapshot file
+  static void Patch(uint64_t offset, uint64_t value) {
+    std::FILE *file = std::fopen(kPath, "r+b");
+    assert(nullptr != file);
+    assert(0 == std::fseek(file, static_cast<long>(offset), SEEK_SET));
+    assert(1 == std::fwrite(&value, sizeof(value), 1, file));
+    assert(0 == std::fclose(file));
+  }
+
+  /// @brief time to get a usable map: Insert of every element, LoadSnapshot, opening of a SnapshotView
+  void WarmStartBenchmark() {
+    const int kDataSize = 1000000;
+    auto time_start = std::chrono::high_resolution_clock::now();
+    IntMap map;
+    for (int i = 0; i < kDataSize; i++)
+      map.Insert(i, i);
+    auto time_inserted = std::chrono::high_resolution_clock::now();
+    assert(map.SaveSnapshot(kPath));
+
+    auto time_load = std::chrono::high_resolution_clock::now();
+    IntMap loaded;
+    loaded.SetMaintenanceThreads(4);
+    assert(loaded.LoadSnapshot(kPath));
+    auto time_loaded = std::chrono::high_resolution_clock::now();
+    SnapshotView<int, int> view;
+    assert(view.Open(kPath));
+    auto time_opened = std::chrono::high_resolution_clock::now();
+
+    assert(kDataSize == (int)loaded.Size() && kDataSize == (int)view.Size());
+    assert(make_pair(true, kDataSize - 1) == loaded.Lookup(kDataSize - 1));
+    assert(make_pair(true, kDataSize - 1) == view.Lookup(kDataSize - 1));
+    std::cout << "\t" << __func__ << " passed. Microseconds elapsed: Insert "
+        << std::chrono::duration_cast<std::chrono::microseconds>(time_inserted - time_start).count()
+        << ", LoadSnapshot "
+        << std::chrono::duration_cast<std::chrono::microseconds>(time_loaded - time_load).count()
+        << ", SnapshotView::Open "
+        << std::chrono::duration_cast<std::chrono::microseconds>(time_opened - time_loaded).count() << std::endl;
+  }
+};
+
+} // namespace tests
+
+#endif //THREADSAFE_HASHMAP_SNAPSHOT_TEST_H